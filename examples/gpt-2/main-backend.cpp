@@ -297,7 +297,10 @@ bool gpt2_model_load(const std::string & fname, gpt2_model & model, gpt_vocab &
     }
 
     // allocate the model tensors in a backend buffer
-    model.buffer_w = ggml_backend_alloc_ctx_tensors(ctx, model.backend);
+    // on the CPU, in a weight buffer that places the matrices on the NUMA nodes that use them
+    model.buffer_w = ggml_backend_is_cpu(model.backend)
+        ? ggml_backend_alloc_ctx_tensors_from_buft(ctx, ggml_backend_cpu_weight_buffer_type())
+        : ggml_backend_alloc_ctx_tensors(ctx, model.backend);
 
     printf("%s: ggml tensor size    = %d bytes\n", __func__, (int) sizeof(ggml_tensor));
     printf("%s: backend buffer size = %6.2f MB\n", __func__, ggml_backend_buffer_get_size(model.buffer_w)/(1024.0*1024.0));
@@ -318,7 +318,10 @@ bool gpt2_model_load(const std::string & fname, gpt2_model & model, gpt_vocab &
     }
 
     // allocate weights buffer
-    model.buffer_w = ggml_backend_alloc_buffer(model.backend, buffer_size);
+    // on the CPU, in a weight buffer that places the matrices on the NUMA nodes that use them
+    model.buffer_w = ggml_backend_is_cpu(model.backend)
+        ? ggml_backend_buft_alloc_buffer(ggml_backend_cpu_weight_buffer_type(), buffer_size)
+        : ggml_backend_alloc_buffer(model.backend, buffer_size);
 
     // prepare memory for the weights
     {
@@ -681,15 +684,6 @@ struct ggml_cgraph * gpt2_graph(
                 ggml_build_forward_expand(gf, ggml_cpy(ctx0, Vcur, v));
             }
 
-            // Q = Qcur.contiguous().view(n_embd/n_head, n_head, N).permute(0, 2, 1, 3)
-            // [64, N, 12]
-            struct ggml_tensor * Q =
-                ggml_permute(ctx0,
-                        ggml_cpy(ctx0,
-                            Qcur,
-                            ggml_new_tensor_3d(ctx0, GGML_TYPE_F32, n_embd/n_head, n_head, n_tokens)),
-                        0, 2, 1, 3);
-
             // K = Kmem.view(n_embd/n_head, n_head, n_kv).permute(0, 2, 1, 3)
             // [64, n_kv, 12]
             struct ggml_tensor * K =
@@ -699,61 +693,96 @@ struct ggml_cgraph * gpt2_graph(
                             n_embd/n_head, n_head, n_kv),
                         0, 2, 1, 3);
 
-            // GG: flash attention
-            //struct ggml_tensor * V =
-            //    ggml_cpy(ctx0,
-            //            ggml_permute(ctx0,
-            //                ggml_reshape_3d(ctx0,
-            //                    ggml_view_1d(ctx0, model.kv_cache.v, n_kv*n_embd, il*n_ctx*ggml_element_size(model.kv_cache.v)*n_embd),
-            //                    n_embd/n_head, n_head, n_kv),
-            //                1, 2, 0, 3),
-            //            ggml_new_tensor_3d(ctx0, GGML_TYPE_F32, n_kv, n_embd/n_head, n_head));
-
-            //struct ggml_tensor * KQV = ggml_flash_attn(ctx0, Q, K, V, true);
-
-            // K * Q
-            // [n_kv, n_tokens, 12]
-            struct ggml_tensor * KQ = ggml_mul_mat(ctx0, K, Q);
-
-            // KQ_scaled = KQ / sqrt(n_embd/n_head)
-            // [n_kv, n_tokens, 12]
-            struct ggml_tensor * KQ_scaled =
-                ggml_scale(ctx0,
-                        KQ,
-                        KQ_scale);
-
-            // KQ_masked = mask_past(KQ_scaled)
-            // [n_kv, n_tokens, 12]
-            struct ggml_tensor * KQ_masked = ggml_add(ctx0, KQ_scaled, KQ_mask);
-
-            // KQ = soft_max(KQ_masked)
-            // [n_kv, N, 12]
-            struct ggml_tensor * KQ_soft_max = ggml_soft_max(ctx0, KQ_masked);
-
-            // V_trans = Vmem.view(n_embd/n_head, n_head, n_kv).permute(1, 2, 0, 3).contiguous()
-            // [n_kv, 64, 12]
-            struct ggml_tensor * V_trans =
-                ggml_cpy(ctx0,
-                        ggml_permute(ctx0,
+            if (ggml_backend_is_cpu(model.backend)) {
+                // single pass attention on the KV cache views, the KQ scores are not materialized
+
+                // Q = Qcur.view(n_embd/n_head, n_head, N).permute(0, 2, 1, 3)
+                // [64, N, 12]
+                struct ggml_tensor * Q =
+                    ggml_permute(ctx0,
+                            ggml_view_3d(ctx0, cur, n_embd/n_head, n_head, n_tokens, ggml_element_size(cur)*n_embd/n_head, cur->nb[1], 0),
+                            0, 2, 1, 3);
+
+                // V = Vmem.view(n_embd/n_head, n_head, n_kv).permute(0, 2, 1, 3)
+                // [64, n_kv, 12]
+                struct ggml_tensor * V =
+                    ggml_permute(ctx0,
                             ggml_reshape_3d(ctx0,
                                 ggml_view_1d(ctx0, model.kv_cache.v, n_kv*n_embd, il*n_ctx*ggml_element_size(model.kv_cache.v)*n_embd),
                                 n_embd/n_head, n_head, n_kv),
-                            1, 2, 0, 3),
-                        ggml_new_tensor_3d(ctx0, model.kv_cache.v->type, n_kv, n_embd/n_head, n_head));
-
-            // KQV = transpose(V) * KQ_soft_max
-            // [64, n_tokens, 12]
-            struct ggml_tensor * KQV = ggml_mul_mat(ctx0, V_trans, KQ_soft_max);
-
-            // KQV_merged = KQV.permute(0, 2, 1, 3)
-            // [64, 12, n_tokens]
-            struct ggml_tensor * KQV_merged = ggml_permute(ctx0, KQV, 0, 2, 1, 3);
-
-            // cur = KQV_merged.contiguous().view(n_embd, N)
-            // [768, n_tokens]
-            cur = ggml_cpy(ctx0,
-                    KQV_merged,
-                    ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_embd, n_tokens));
+                            0, 2, 1, 3);
+
+                // [64, 12, n_tokens]
+                struct ggml_tensor * KQV = ggml_flash_attn_ext(ctx0, Q, K, V, KQ_mask, 1.0f/sqrtf(float(n_embd)/n_head), 0.0f);
+
+                // [768, n_tokens]
+                cur = ggml_reshape_2d(ctx0, KQV, n_embd, n_tokens);
+            } else {
+                // Q = Qcur.contiguous().view(n_embd/n_head, n_head, N).permute(0, 2, 1, 3)
+                // [64, N, 12]
+                struct ggml_tensor * Q =
+                    ggml_permute(ctx0,
+                            ggml_cpy(ctx0,
+                                Qcur,
+                                ggml_new_tensor_3d(ctx0, GGML_TYPE_F32, n_embd/n_head, n_head, n_tokens)),
+                            0, 2, 1, 3);
+
+                // GG: flash attention
+                //struct ggml_tensor * V =
+                //    ggml_cpy(ctx0,
+                //            ggml_permute(ctx0,
+                //                ggml_reshape_3d(ctx0,
+                //                    ggml_view_1d(ctx0, model.kv_cache.v, n_kv*n_embd, il*n_ctx*ggml_element_size(model.kv_cache.v)*n_embd),
+                //                    n_embd/n_head, n_head, n_kv),
+                //                1, 2, 0, 3),
+                //            ggml_new_tensor_3d(ctx0, GGML_TYPE_F32, n_kv, n_embd/n_head, n_head));
+
+                //struct ggml_tensor * KQV = ggml_flash_attn(ctx0, Q, K, V, true);
+
+                // K * Q
+                // [n_kv, n_tokens, 12]
+                struct ggml_tensor * KQ = ggml_mul_mat(ctx0, K, Q);
+
+                // KQ_scaled = KQ / sqrt(n_embd/n_head)
+                // [n_kv, n_tokens, 12]
+                struct ggml_tensor * KQ_scaled =
+                    ggml_scale(ctx0,
+                            KQ,
+                            KQ_scale);
+
+                // KQ_masked = mask_past(KQ_scaled)
+                // [n_kv, n_tokens, 12]
+                struct ggml_tensor * KQ_masked = ggml_add(ctx0, KQ_scaled, KQ_mask);
+
+                // KQ = soft_max(KQ_masked)
+                // [n_kv, N, 12]
+                struct ggml_tensor * KQ_soft_max = ggml_soft_max(ctx0, KQ_masked);
+
+                // V_trans = Vmem.view(n_embd/n_head, n_head, n_kv).permute(1, 2, 0, 3).contiguous()
+                // [n_kv, 64, 12]
+                struct ggml_tensor * V_trans =
+                    ggml_cpy(ctx0,
+                            ggml_permute(ctx0,
+                                ggml_reshape_3d(ctx0,
+                                    ggml_view_1d(ctx0, model.kv_cache.v, n_kv*n_embd, il*n_ctx*ggml_element_size(model.kv_cache.v)*n_embd),
+                                    n_embd/n_head, n_head, n_kv),
+                                1, 2, 0, 3),
+                            ggml_new_tensor_3d(ctx0, model.kv_cache.v->type, n_kv, n_embd/n_head, n_head));
+
+                // KQV = transpose(V) * KQ_soft_max
+                // [64, n_tokens, 12]
+                struct ggml_tensor * KQV = ggml_mul_mat(ctx0, V_trans, KQ_soft_max);
+
+                // KQV_merged = KQV.permute(0, 2, 1, 3)
+                // [64, 12, n_tokens]
+                struct ggml_tensor * KQV_merged = ggml_permute(ctx0, KQV, 0, 2, 1, 3);
+
+                // cur = KQV_merged.contiguous().view(n_embd, N)
+                // [768, n_tokens]
+                cur = ggml_cpy(ctx0,
+                        KQV_merged,
+                        ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_embd, n_tokens));
+            }
         }
 
         // projection
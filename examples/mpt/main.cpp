@@ -506,6 +506,15 @@ bool mpt_eval(const mpt_model & model, const int n_threads, const int n_past,
 
     struct ggml_tensor * inpL = ggml_get_rows(ctx0, model.wte_weight, embd);
 
+    // causal mask for 1 head, broadcast to all heads by ggml_soft_max_ext
+    // [n_past + N, N]
+    struct ggml_tensor * KQ_mask = ggml_new_tensor_2d(ctx0, GGML_TYPE_F32, n_past + N, N);
+    for (int j = 0; j < N; ++j) {
+        for (int i = 0; i < n_past + N; ++i) {
+            ((float *) KQ_mask->data)[j*(n_past + N) + i] = i > n_past + j ? -INFINITY : 0.0f;
+        }
+    }
+
     for (int il = 0; il < n_layer; ++il) {
 
         struct ggml_tensor * cur;
@@ -566,18 +575,9 @@ bool mpt_eval(const mpt_model & model, const int n_threads, const int n_past,
             // K * Q
             struct ggml_tensor * KQ = ggml_mul_mat(ctx0, K, Q);
 
-            // KQ_scaled = KQ / sqrt(n_embd/n_head)
-            struct ggml_tensor * KQ_scaled =
-                ggml_scale(ctx0, KQ, ggml_new_f32(ctx0, 1.0f / sqrt(float(n_embd) / n_head)));
-
-            struct ggml_tensor * KQ_scaled_alibi =
-                ggml_alibi(ctx0, KQ_scaled, n_past, n_head, model.hparams.alibi_bias_max);
-
-            // KQ_masked = mask_past(KQ_scaled)
-            struct ggml_tensor * KQ_masked = ggml_diag_mask_inf(ctx0, KQ_scaled_alibi, n_past);
-
-            // KQ = soft_max(KQ_masked)
-            struct ggml_tensor * KQ_soft_max = ggml_soft_max(ctx0, KQ_masked);
+            // KQ = soft_max(mask_past(alibi(KQ / sqrt(n_embd/n_head)))) in one pass
+            struct ggml_tensor * KQ_soft_max =
+                ggml_soft_max_ext(ctx0, KQ, KQ_mask, 1.0f / sqrt(float(n_embd) / n_head), model.hparams.alibi_bias_max);
 
             // V_trans = Vmem.view(n_embd/n_head, n_head, n_past + N).permute(1,
             // 2, 0, 3).contiguous() [n_past + N, 64, 12]
@@ -56,6 +56,8 @@ extern "C" {
     GGML_API void ggml_backend_graph_plan_free   (ggml_backend_t backend, ggml_backend_graph_plan_t plan);
     GGML_API void ggml_backend_graph_plan_compute(ggml_backend_t backend, ggml_backend_graph_plan_t plan);
     GGML_API void ggml_backend_graph_compute     (ggml_backend_t backend, struct ggml_cgraph * cgraph);
+    // may return before the graph is computed, ggml_backend_synchronize waits for it
+    GGML_API void ggml_backend_graph_compute_async(ggml_backend_t backend, struct ggml_cgraph * cgraph);
     GGML_API bool ggml_backend_supports_op       (ggml_backend_t backend, const struct ggml_tensor * op);
 
     // tensor copy between different backends
@@ -70,11 +72,24 @@ extern "C" {
 
     GGML_API bool ggml_backend_is_cpu(ggml_backend_t backend);
     GGML_API void ggml_backend_cpu_set_n_threads(ggml_backend_t backend_cpu, int n_threads);
+    // compute on a pool shared with other backends instead of a pool owned by the backend, NULL to go back to it
+    // the pool must outlive its use by the backend
+    GGML_API void ggml_backend_cpu_set_threadpool(ggml_backend_t backend_cpu, struct ggml_threadpool * threadpool);
 
     // Create a backend buffer from an existing pointer
     GGML_API ggml_backend_buffer_t ggml_backend_cpu_buffer_from_ptr(void * ptr, size_t size);
 
     GGML_API ggml_backend_buffer_type_t ggml_backend_cpu_buffer_type(void);
+    // CPU buffer for the weights of a model: on NUMA systems the rows of each matrix are placed on the nodes whose
+    // threads read them in ggml_mul_mat (see ggml_numa_distribute_tensor) when the tensor is allocated in the buffer,
+    // the other tensors are interleaved over the nodes; same as ggml_backend_cpu_buffer_type on other systems
+    GGML_API ggml_backend_buffer_type_t ggml_backend_cpu_weight_buffer_type(void);
+    // CPU buffer for the weights of ggml_mul_mat: the tensors that can be are repacked (see ggml_repack) when
+    // they are written whole with ggml_backend_tensor_set, and unpacked when read back
+    // placed on the NUMA nodes like ggml_backend_cpu_weight_buffer_type
+    // use it with ggml_backend_alloc_ctx_tensors_from_buft for a context of matrix weights only
+    // the layout speeds up matrix-vector products (single token decode), not products with many src1 rows
+    GGML_API ggml_backend_buffer_type_t ggml_backend_cpu_repack_buffer_type(void);
 
     //
     // Backend registry
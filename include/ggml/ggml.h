@@ -425,6 +425,7 @@ extern "C" {
         GGML_OP_POOL_2D,
         GGML_OP_UPSCALE, // nearest interpolate
         GGML_OP_ARGSORT,
+        GGML_OP_TOP_K,
 
         GGML_OP_FLASH_ATTN,
         GGML_OP_FLASH_FF,
@@ -451,6 +452,10 @@ extern "C" {
         GGML_OP_CROSS_ENTROPY_LOSS_BACK,
 
         GGML_OP_PAD_CIRCULAR,
+        GGML_OP_PAD_CIRCULAR_BACK,
+        GGML_OP_RFFT_2D,
+        GGML_OP_CONV_2D_CIRCULAR,
+        GGML_OP_FLASH_ATTN_EXT,
 
         GGML_OP_COUNT,
     };
@@ -477,6 +482,14 @@ extern "C" {
         GGML_OBJECT_WORK_BUFFER
     };
 
+    enum ggml_tensor_flag {
+        GGML_TENSOR_FLAG_REPACKED = 1, // rows interleaved in groups of GGML_REPACK_ROWS, see ggml_repack
+        GGML_TENSOR_FLAG_WRAPPED  = 2, // padded shape over the data of its view_src, see ggml_pad_circular_view
+    };
+
+    // number of rows whose blocks are interleaved in a repacked tensor
+    #define GGML_REPACK_ROWS 4
+
     enum ggml_log_level {
         GGML_LOG_LEVEL_ERROR = 2,
         GGML_LOG_LEVEL_WARN = 3,
@@ -536,11 +549,32 @@ extern "C" {
 
         void * extra; // extra things e.g. for ggml-cuda.cu
 
-        char padding[12];
+        int32_t flags; // enum ggml_tensor_flag
+
+        char padding[8];
     };
 
     static const size_t GGML_TENSOR_SIZE = sizeof(struct ggml_tensor);
 
+    // persistent worker threads for ggml_graph_compute, see ggml_threadpool_new
+    struct ggml_threadpool;
+
+    // per-node plan kept between graphs with the same topology, see ggml_graph_plan_cached
+    struct ggml_cplan_cache;
+
+    // a graph being computed in the background, see ggml_graph_compute_async
+    struct ggml_compute_future;
+
+    // how the compute threads wait for each other between the nodes of a graph
+    enum ggml_wait_policy {
+        GGML_WAIT_POLICY_DEFAULT, // spin, yield only in builds with Accelerate or OpenBLAS
+        GGML_WAIT_POLICY_SPIN,    // spin, lowest latency but a waiting thread keeps its core busy
+        GGML_WAIT_POLICY_YIELD,   // spin wait_spin_count times, then sched_yield between checks
+        GGML_WAIT_POLICY_SLEEP,   // spin wait_spin_count times, then sleep until the next node is ready
+    };
+
+    #define GGML_WAIT_SPIN_COUNT_DEFAULT 4096
+
     // the compute plan that needs to be prepared for ggml_graph_compute()
     // since https://github.com/ggerganov/ggml/issues/287
     struct ggml_cplan {
@@ -549,6 +583,29 @@ extern "C" {
 
         int n_threads;
 
+        // optional: run on the workers of this pool instead of creating n_threads - 1 threads per call
+        // the pool must have at least n_threads threads
+        struct ggml_threadpool * threadpool;
+        int weight; // share of the pool relative to the other graphs computed on it, 0 for 1
+
+        // set by ggml_graph_plan_cached: the number of tasks of every node, valid until the cache plans another graph,
+        // and the dependencies of the nodes for dag, kept in the cache between computes of the same graph
+        // a cache must not be used by two graphs computed at the same time
+        // NULL: the threads compute it for every node
+        struct ggml_cplan_cache * cache;
+
+        enum ggml_wait_policy wait_policy;
+        int wait_spin_count; // spin budget of the YIELD and SLEEP policies, 0 for GGML_WAIT_SPIN_COUNT_DEFAULT
+
+        // compute independent nodes concurrently: each node waits only for the nodes it depends on
+        // and gets a team of threads sized by its cost, instead of all threads computing every node in order
+        bool dag;
+
+        // set by ggml_graph_compute: time the threads spent waiting for each other, summed over
+        // all threads, and the number of times a thread went to sleep
+        int64_t wait_time_us;
+        int64_t wait_n_sleeps;
+
         // abort ggml_graph_compute when true
         bool (*abort_callback)(void * data);
         void * abort_callback_data;
@@ -634,6 +691,23 @@ extern "C" {
     GGML_API void    ggml_numa_init(void); // call once for better performance on NUMA systems
     GGML_API bool    ggml_is_numa(void); // true if init detected that system has >1 NUMA node
 
+    // memory placement on NUMA systems, no-ops on other systems
+    // interleave the pages of a buffer over the nodes, e.g. for buffers used by the threads of all nodes
+    GGML_API void    ggml_numa_interleave(void * data, size_t size);
+    // place the rows of a weight on the nodes whose threads read them in ggml_mul_mat, call after allocation
+    // the rows are split in one block per node, the pages already in memory are moved
+    // done by ggml_backend_cpu_weight_buffer_type for the tensors allocated in its buffers
+    GGML_API void    ggml_numa_distribute_tensor(const struct ggml_tensor * tensor);
+
+    // interleaved weight layout: the blocks of GGML_REPACK_ROWS consecutive rows are stored in turn, so that
+    // the kernels of ggml_mul_mat read the blocks of several rows from one stream of memory
+    // only ggml_mul_mat and ggml_mul_mat_id accept a repacked tensor, as src0, the other ops and ggml_get_* do not
+    GGML_API bool    ggml_can_repack(const struct ggml_tensor * tensor);
+    // store data (in the usual layout, ggml_nbytes(tensor) bytes) in the tensor interleaved and set GGML_TENSOR_FLAG_REPACKED
+    GGML_API void    ggml_repack    (struct ggml_tensor * tensor, const void * data);
+    // read a repacked tensor back in the usual layout
+    GGML_API void    ggml_unpack    (const struct ggml_tensor * tensor, void * data);
+
     GGML_API void    ggml_print_object (const struct ggml_object * obj);
     GGML_API void    ggml_print_objects(const struct ggml_context * ctx);
 
@@ -1314,6 +1388,16 @@ extern "C" {
             struct ggml_context * ctx,
             struct ggml_tensor  * a);
 
+    // fused soft_max(a*scale + mask + alibi) in one pass per row
+    // mask: [ne0, ne1 or more] F32 added to every matrix of a, -INFINITY masks, optional
+    // max_bias > 0 adds the ALiBi bias of ggml_alibi, with the heads along dim 2 of a
+    GGML_API struct ggml_tensor * ggml_soft_max_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * mask,
+            float                 scale,
+            float                 max_bias);
+
     GGML_API struct ggml_tensor * ggml_soft_max_back(
             struct ggml_context * ctx,
             struct ggml_tensor  * a,
@@ -1429,6 +1513,11 @@ extern "C" {
             float                 min,
             float                 max);
 
+    enum ggml_pad_mode {
+        GGML_PAD_MODE_ZERO,
+        GGML_PAD_MODE_CIRCULAR, // out-of-bounds reads wrap around, same as ggml_pad_circular
+    };
+
     GGML_API struct ggml_tensor * ggml_im2col(
             struct ggml_context * ctx,
             struct ggml_tensor  * a,
@@ -1441,6 +1530,20 @@ extern "C" {
             int                  d1,
             bool                 is_2D);
 
+    // im2col that fills the padding according to pad_mode instead of with zeros
+    GGML_API struct ggml_tensor * ggml_im2col_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * b,
+            int                  s0,
+            int                  s1,
+            int                  p0,
+            int                  p1,
+            int                  d0,
+            int                  d1,
+            bool                 is_2D,
+            enum ggml_pad_mode   pad_mode);
+
     GGML_API struct ggml_tensor * ggml_conv_1d(
             struct ggml_context * ctx,
             struct ggml_tensor  * a,
@@ -1449,6 +1552,15 @@ extern "C" {
             int                   p0,  // padding
             int                   d0); // dilation
 
+    GGML_API struct ggml_tensor * ggml_conv_1d_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * b,
+            int                   s0,  // stride
+            int                   p0,  // padding
+            int                   d0,  // dilation
+            enum ggml_pad_mode    pad_mode);
+
     // conv_1d with padding = half
     // alias for ggml_conv_1d(a, b, s, a->ne[0]/2, d)
     GGML_API struct ggml_tensor* ggml_conv_1d_ph(
@@ -1477,6 +1589,38 @@ extern "C" {
             int                   d0,
             int                   d1);
 
+    // with GGML_PAD_MODE_CIRCULAR this is equivalent to ggml_pad_circular_ext followed by
+    // ggml_conv_2d with p0 = p1 = 0, without materializing the padded input
+    GGML_API struct ggml_tensor * ggml_conv_2d_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * b,
+            int                   s0,
+            int                   s1,
+            int                   p0,
+            int                   p1,
+            int                   d0,
+            int                   d1,
+            enum ggml_pad_mode    pad_mode);
+
+
+    // circular 2D convolution with stride 1 and dilation 1, same result as
+    // ggml_conv_2d_ext(ctx, a, b, 1, 1, p0, p1, 1, 1, GGML_PAD_MODE_CIRCULAR)
+    // kernels of 49 taps or more are computed in the frequency domain; this keeps the spectra of all
+    // OC*IC kernels in memory, IH*(IW/2 + 1) complex values each. smaller ones go through im2col
+    // a: [OC, IC, KH, KW]
+    // b: [N, IC, IH, IW]
+    // result: [N, OC, OH, OW]
+    GGML_API struct ggml_tensor * ggml_conv_2d_circular(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * b,
+            int                   p0,
+            int                   p1);
+
+    // frees the FFT plans cached by ggml_conv_2d_circular, they are otherwise kept until the process exits
+    // must not be called while a graph is computed
+    GGML_API void ggml_fft_plans_free(void);
 
     // kernel size is a->ne[0] x a->ne[1]
     // stride is equal to kernel size
@@ -1544,7 +1688,7 @@ extern "C" {
             struct ggml_tensor  * a,
             int                   scale_factor);
 
-    // sort rows
+    // sort rows, equal values keep the order of their indices
     enum ggml_sort_order {
         GGML_SORT_ASC,
         GGML_SORT_DESC,
@@ -1555,7 +1699,8 @@ extern "C" {
             struct ggml_tensor  * a,
             enum ggml_sort_order  order);
 
-    // top k elements per row
+    // indices of the k largest elements of each row, largest first, the lower index first among equal values
+    // result is a contiguous I32 tensor [k, ne1, ne2, ne3]
     GGML_API struct ggml_tensor * ggml_top_k(
             struct ggml_context * ctx,
             struct ggml_tensor  * a,
@@ -1568,6 +1713,22 @@ extern "C" {
             struct ggml_tensor  * v,
             bool                  masked);
 
+    // single pass attention softmax(scale*q*k^T + mask + alibi)*v, with the softmax computed online
+    // q:    [n_embd_k, n_tokens, n_head,    ne3] F32
+    // k:    [n_embd_k, n_kv,     n_head_kv, ne3] F32 or F16, can be a strided view of a KV cache
+    // v:    [n_embd_v, n_kv,     n_head_kv, ne3] F32 or F16, idem (not transposed)
+    // mask: [n_kv,     n_tokens_pad, 1, 1] F32 added to the scores, -INFINITY masks, optional
+    // n_head % n_head_kv == 0, max_bias > 0 adds the ALiBi bias of ggml_alibi
+    // res:  [n_embd_v, n_head,   n_tokens,  ne3] F32 (permuted, so that the heads of a token are contiguous)
+    GGML_API struct ggml_tensor * ggml_flash_attn_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * q,
+            struct ggml_tensor  * k,
+            struct ggml_tensor  * v,
+            struct ggml_tensor  * mask,
+            float                 scale,
+            float                 max_bias);
+
     GGML_API struct ggml_tensor * ggml_flash_attn_back(
            struct ggml_context * ctx,
            struct ggml_tensor  * q,
@@ -1782,11 +1943,61 @@ extern "C" {
 
     // Circular Padding
 
+    // pads dims 0 and 1 with `padding` elements on both sides, wrapping around periodically
     GGML_API struct ggml_tensor * ggml_pad_circular(
             struct ggml_context * ctx,
             struct ggml_tensor  * a,
             int                   padding);
 
+    // per-axis circular padding: lpN/rpN elements are prepended/appended to dim N
+    // quantized tensors are padded in their own type; lp0 and rp0 must be multiples of the block size
+    GGML_API struct ggml_tensor * ggml_pad_circular_ext(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            int                   lp0,
+            int                   rp0,
+            int                   lp1,
+            int                   rp1,
+            int                   lp2,
+            int                   rp2,
+            int                   lp3,
+            int                   rp3);
+
+    // lazy variant of ggml_pad_circular_ext: the result is a view of a with the padded shape that is
+    // never materialized, consumers resolve the wrapped indices when they read it
+    // only im2col (as the image), pool_2d, upscale and unary ops can consume it, which is checked
+    // by ggml_graph_plan; it cannot be viewed, copied or used as an output
+    // its ggml_nbytes is the size of a, ggml_get_*_1d/nd resolve the wrapped indices, while
+    // ggml_set_* and the ggml_backend_tensor_get/set/copy functions reject it
+    GGML_API struct ggml_tensor * ggml_pad_circular_view(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            int                   lp0,
+            int                   rp0,
+            int                   lp1,
+            int                   rp1,
+            int                   lp2,
+            int                   rp2,
+            int                   lp3,
+            int                   rp3);
+
+    // true if t was created by ggml_pad_circular_view
+    GGML_API bool ggml_is_wrapped_view(const struct ggml_tensor * t);
+
+    // folds the gradient of a circularly padded tensor back onto the source: every element of a
+    // is accumulated into the element of b it was wrapped from
+    // a: [ne0 + lp0 + rp0, ne1 + lp1 + rp1, ...]
+    // b: [ne0, ne1, ne2, ne3] (only the shape is used)
+    // result: same shape as b
+    GGML_API struct ggml_tensor * ggml_pad_circular_back(
+            struct ggml_context * ctx,
+            struct ggml_tensor  * a,
+            struct ggml_tensor  * b,
+            int                   lp0,
+            int                   lp1,
+            int                   lp2,
+            int                   lp3);
+
     //
     // automatic differentiation
     //
@@ -1816,6 +2027,28 @@ extern "C" {
     GGML_API struct ggml_cplan ggml_graph_plan   (struct ggml_cgraph * cgraph, int n_threads /*= GGML_DEFAULT_N_THREADS*/);
     GGML_API int               ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan);
 
+    // same as ggml_graph_plan() but the per-node plan is stored in cache and reused as long as the graph
+    // has the same nodes, with the same ops, types, shapes and op params, e.g. every decode step of a model
+    GGML_API struct ggml_cplan_cache * ggml_cplan_cache_new (void);
+    GGML_API void                      ggml_cplan_cache_free(struct ggml_cplan_cache * cache);
+    GGML_API struct ggml_cplan         ggml_graph_plan_cached(struct ggml_cgraph * cgraph, int n_threads, struct ggml_cplan_cache * cache);
+
+    // a pool of n_threads - 1 worker threads (the calling thread is the first one) that is kept
+    // alive between ggml_graph_compute calls, the workers sleep while no graph is being computed
+    // graphs computed concurrently from several threads share the pool: together they never use more than
+    // n_threads threads, callers included, and each one gets a share of the pool by ggml_cplan.weight
+    GGML_API struct ggml_threadpool * ggml_threadpool_new          (int n_threads);
+    GGML_API void                     ggml_threadpool_free         (struct ggml_threadpool * threadpool);
+    GGML_API int                      ggml_threadpool_get_n_threads(const struct ggml_threadpool * threadpool);
+
+    // same as ggml_graph_compute() but returns immediately, the graph is computed on the threads of
+    // cplan->threadpool, with an extra pool thread in place of the caller, or on threads created for the call
+    // the graph, the work data and the pool must stay valid until ggml_compute_future_wait
+    GGML_API struct ggml_compute_future * ggml_graph_compute_async(struct ggml_cgraph * cgraph, const struct ggml_cplan * cplan);
+    GGML_API bool                         ggml_compute_future_is_done(struct ggml_compute_future * future);
+    // waits for the graph, frees the future and returns the result of ggml_graph_compute()
+    GGML_API int                          ggml_compute_future_wait   (struct ggml_compute_future * future);
+
     // same as ggml_graph_compute() but the work data is allocated as a part of the context
     // note: the drawback of this API is that you must have ensured that the context has enough memory for the work data
     GGML_API void ggml_graph_compute_with_ctx(struct ggml_context * ctx, struct ggml_cgraph * cgraph, int n_threads);
@@ -2195,6 +2428,12 @@ extern "C" {
     typedef void (*ggml_from_float_t)(const float * GGML_RESTRICT x, void  * GGML_RESTRICT y, int k);
     typedef void (*ggml_vec_dot_t)   (const int n, float * GGML_RESTRICT s, const void * GGML_RESTRICT x, const void * GGML_RESTRICT y);
 
+    // number of rows of y in one call of a ggml_vec_dot_nc_t
+    #define GGML_VEC_DOT_NC 4
+
+    // dot products of one row of x with GGML_VEC_DOT_NC rows of y, by bytes apart, stored to s[j*bs]
+    typedef void (*ggml_vec_dot_nc_t)(const int n, float * GGML_RESTRICT s, size_t bs, const void * GGML_RESTRICT x, const void * GGML_RESTRICT y, size_t by);
+
     typedef struct {
         const char      * type_name;
         int               blck_size;
@@ -2205,6 +2444,8 @@ extern "C" {
         ggml_from_float_t from_float_reference;
         ggml_vec_dot_t    vec_dot;
         enum ggml_type    vec_dot_type;
+        ggml_vec_dot_nc_t vec_dot_nc; // optional
+        ggml_vec_dot_t    vec_dot_x4; // optional, GGML_REPACK_ROWS interleaved rows of x (see ggml_repack) with one row of y
     } ggml_type_traits_t;
 
     GGML_API ggml_type_traits_t ggml_internal_get_type_traits(enum ggml_type type);
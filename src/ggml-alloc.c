@@ -75,6 +75,8 @@ static bool ggml_tallocr_is_own(ggml_tallocr_t alloc, const struct ggml_tensor *
     return tensor->buffer == alloc->buffer;
 }
 
+// this includes the wrapped views of ggml_pad_circular_view: they get the data pointer of their view_src
+// (at offset 0) and are never allocated, their padded shape is resolved by the ops that read them
 static bool ggml_is_view(struct ggml_tensor * t) {
     return t->view_src != NULL;
 }
@@ -477,6 +479,12 @@ static void allocate_node(ggml_gallocr_t galloc, struct ggml_tensor * node) {
                         break;
                     }
 
+                    // the elements of a wrapped view are read at wrapped indices of its view_src,
+                    // a result written over them would overwrite elements that are still to be read
+                    if (ggml_is_wrapped_view(parent)) {
+                        continue;
+                    }
+
                     // if the node's data is external, then we cannot re-use it
                     if (ggml_tallocr_is_own(alloc, parent) == false) {
                         AT_PRINTF("not reusing parent %s for %s as %p is external\n", parent->name, node->name, parent->data);
@@ -530,6 +538,8 @@ static void ggml_tallocr_alloc_graph_impl(ggml_gallocr_t galloc, struct ggml_cgr
         struct ggml_tensor * node = gf->nodes[i];
 
         if (ggml_is_view(node)) {
+            // a wrapped view keeps its view_src alive until all the consumers of the padded shape have run
+            GGML_ASSERT(!ggml_is_wrapped_view(node) || node->view_offs == 0);
             struct ggml_tensor * view_src = node->view_src;
             hash_get(galloc, view_src)->n_views += 1;
             if (node->buffer == NULL && node->data != NULL) {
@@ -129,6 +129,7 @@ size_t ggml_backend_get_alignment(ggml_backend_t backend) {
 
 void ggml_backend_tensor_set_async(ggml_backend_t backend, struct ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
     GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view has no data of its own");
     GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor write out of bounds");
 
     backend->iface.set_tensor_async(backend, tensor, data, offset, size);
@@ -136,6 +137,7 @@ void ggml_backend_tensor_set_async(ggml_backend_t backend, struct ggml_tensor *
 
 void ggml_backend_tensor_get_async(ggml_backend_t backend, const struct ggml_tensor * tensor, void * data, size_t offset, size_t size) {
     GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view has no data of its own");
     GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor read out of bounds");
 
     backend->iface.get_tensor_async(backend, tensor, data, offset, size);
@@ -144,6 +146,7 @@ void ggml_backend_tensor_get_async(ggml_backend_t backend, const struct ggml_ten
 void ggml_backend_tensor_set(struct ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
     GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
     GGML_ASSERT(tensor->buffer != NULL && "tensor buffer not set");
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view has no data of its own");
     GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor write out of bounds");
 
     tensor->buffer->iface.set_tensor(tensor->buffer, tensor, data, offset, size);
@@ -152,6 +155,7 @@ void ggml_backend_tensor_set(struct ggml_tensor * tensor, const void * data, siz
 void ggml_backend_tensor_get(const struct ggml_tensor * tensor, void * data, size_t offset, size_t size) {
     GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
     GGML_ASSERT(tensor->buffer != NULL && "tensor buffer not set");
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view has no data of its own");
     GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor read out of bounds");
 
     tensor->buffer->iface.get_tensor(tensor->buffer, tensor, data, offset, size);
@@ -187,7 +191,23 @@ void ggml_backend_graph_compute(ggml_backend_t backend, struct ggml_cgraph * cgr
     ggml_backend_synchronize(backend);
 }
 
+void ggml_backend_graph_compute_async(ggml_backend_t backend, struct ggml_cgraph * cgraph) {
+    backend->iface.graph_compute(backend, cgraph);
+}
+
 bool ggml_backend_supports_op(ggml_backend_t backend, const struct ggml_tensor * op) {
+    // wrapped views are resolved by the CPU kernels only
+    if (!ggml_backend_is_cpu(backend)) {
+        if (ggml_is_wrapped_view(op)) {
+            return false;
+        }
+        for (int i = 0; i < GGML_MAX_SRC; i++) {
+            if (op->src[i] != NULL && ggml_is_wrapped_view(op->src[i])) {
+                return false;
+            }
+        }
+    }
+
     return backend->iface.supports_op(backend, op);
 }
 
@@ -212,6 +232,7 @@ void ggml_backend_tensor_copy(struct ggml_tensor * src, struct ggml_tensor * dst
     //printf("src: %s ne: [%d %d %d %d] nb: [%d %d %d %d]\n", src->name, (int)src->ne[0], (int)src->ne[1], (int)src->ne[2], (int)src->ne[3], (int)src->nb[0], (int)src->nb[1], (int)src->nb[2], (int)src->nb[3]);
     //printf("dst: %s ne: [%d %d %d %d] nb: [%d %d %d %d]\n", dst->name, (int)dst->ne[0], (int)dst->ne[1], (int)dst->ne[2], (int)dst->ne[3], (int)dst->nb[0], (int)dst->nb[1], (int)dst->nb[2], (int)dst->nb[3]);
     GGML_ASSERT(ggml_are_same_layout(src, dst) && "cannot copy tensors with different layouts");
+    GGML_ASSERT(!ggml_is_wrapped_view(src) && !ggml_is_wrapped_view(dst) && "cannot copy a wrapped view");
 
     // fprintf(stderr, "cpy tensor %s from %s to %s (%lu bytes)\n", src->name, ggml_backend_name(src->backend), ggml_backend_name(dst->backend), ggml_nbytes(src));
 
@@ -430,20 +451,186 @@ ggml_backend_buffer_type_t ggml_backend_cpu_buffer_type(void) {
     return &ggml_backend_buffer_type_cpu;
 }
 
+// CPU buffer for weights, placed on the NUMA nodes whose threads read them
+// the buffer is interleaved over the nodes and the rows of every matrix are moved to the nodes that
+// compute them in ggml_mul_mat when the tensor is allocated, before the weights are read into it
+// the activations and the KV cache stay in the default CPU buffers, on the node of the thread that first writes them
+
+static void ggml_backend_cpu_weight_buffer_init_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor) {
+    if (tensor->view_src == NULL) {
+        ggml_numa_distribute_tensor(tensor);
+    }
+
+    GGML_UNUSED(buffer);
+}
+
+static struct ggml_backend_buffer_i cpu_weight_backend_buffer_i = {
+    /* .free_buffer     = */ ggml_backend_cpu_buffer_free_buffer,
+    /* .get_base        = */ ggml_backend_cpu_buffer_get_base,
+    /* .init_tensor     = */ ggml_backend_cpu_weight_buffer_init_tensor,
+    /* .set_tensor      = */ ggml_backend_cpu_buffer_set_tensor,
+    /* .get_tensor      = */ ggml_backend_cpu_buffer_get_tensor,
+    /* .cpy_tensor_from = */ ggml_backend_cpu_buffer_cpy_tensor_from,
+    /* .cpy_tensor_to   = */ ggml_backend_cpu_buffer_cpy_tensor_to,
+};
+
+static ggml_backend_buffer_t ggml_backend_cpu_weight_buffer_type_alloc_buffer(ggml_backend_buffer_type_t buft, size_t size) {
+    ggml_backend_buffer_t buffer = ggml_backend_cpu_buffer_type_alloc_buffer(buft, size);
+    buffer->iface = cpu_weight_backend_buffer_i;
+
+    // the tensors that are not matrices are read by the threads of all nodes
+    ggml_numa_interleave(buffer->context, buffer->size);
+
+    return buffer;
+}
+
+ggml_backend_buffer_type_t ggml_backend_cpu_weight_buffer_type(void) {
+    static struct ggml_backend_buffer_type ggml_backend_buffer_type_cpu_weight = {
+        /* .iface = */ {
+            /* .alloc_buffer     = */ ggml_backend_cpu_weight_buffer_type_alloc_buffer,
+            /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+            /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes
+            /* .supports_backend = */ ggml_backend_cpu_buffer_type_supports_backend,
+        },
+        /* .context = */ NULL,
+    };
+
+    return &ggml_backend_buffer_type_cpu_weight;
+}
+
+// CPU buffer that stores the matrices written to it in the interleaved layout of ggml_repack
+// a weight buffer too: the repacked row blocks are placed on their NUMA nodes once written
+
+static void ggml_backend_cpu_repack_buffer_set_tensor(ggml_backend_buffer_t buffer, struct ggml_tensor * tensor, const void * data, size_t offset, size_t size) {
+    GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor write out of bounds");
+    GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
+
+    // only whole tensors are repacked, the others are stored as in a CPU buffer
+    if (offset == 0 && size == ggml_nbytes(tensor) && ggml_can_repack(tensor)) {
+        ggml_repack(tensor, data);
+
+        // the row blocks of a repacked matrix start at a group of interleaved rows
+        ggml_numa_distribute_tensor(tensor);
+    } else {
+        GGML_ASSERT(!(tensor->flags & GGML_TENSOR_FLAG_REPACKED) && "partial write to a repacked tensor");
+
+        memcpy((char *)tensor->data + offset, data, size);
+    }
+
+    GGML_UNUSED(buffer);
+}
+
+static void ggml_backend_cpu_repack_buffer_get_tensor(ggml_backend_buffer_t buffer, const struct ggml_tensor * tensor, void * data, size_t offset, size_t size) {
+    GGML_ASSERT(offset + size <= ggml_nbytes(tensor) && "tensor read out of bounds");
+    GGML_ASSERT(tensor->data != NULL && "tensor not allocated");
+
+    if (tensor->flags & GGML_TENSOR_FLAG_REPACKED) {
+        GGML_ASSERT(offset == 0 && size == ggml_nbytes(tensor) && "partial read of a repacked tensor");
+
+        ggml_unpack(tensor, data);
+    } else {
+        memcpy(data, (const char *)tensor->data + offset, size);
+    }
+
+    GGML_UNUSED(buffer);
+}
+
+static void ggml_backend_cpu_repack_buffer_cpy_tensor_from(ggml_backend_buffer_t buffer, struct ggml_tensor * src, struct ggml_tensor * dst) {
+    const size_t nbytes = ggml_nbytes(src);
+
+    void * data = malloc(nbytes);
+    ggml_backend_tensor_get(src, data, 0, nbytes);
+    ggml_backend_cpu_repack_buffer_set_tensor(buffer, dst, data, 0, nbytes);
+    free(data);
+}
+
+static void ggml_backend_cpu_repack_buffer_cpy_tensor_to(ggml_backend_buffer_t buffer, struct ggml_tensor * src, struct ggml_tensor * dst) {
+    const size_t nbytes = ggml_nbytes(src);
+
+    void * data = malloc(nbytes);
+    ggml_backend_cpu_repack_buffer_get_tensor(buffer, src, data, 0, nbytes);
+    ggml_backend_tensor_set(dst, data, 0, nbytes);
+    free(data);
+}
+
+static struct ggml_backend_buffer_i cpu_repack_backend_buffer_i = {
+    /* .free_buffer     = */ ggml_backend_cpu_buffer_free_buffer,
+    /* .get_base        = */ ggml_backend_cpu_buffer_get_base,
+    /* .init_tensor     = */ ggml_backend_cpu_weight_buffer_init_tensor,
+    /* .set_tensor      = */ ggml_backend_cpu_repack_buffer_set_tensor,
+    /* .get_tensor      = */ ggml_backend_cpu_repack_buffer_get_tensor,
+    /* .cpy_tensor_from = */ ggml_backend_cpu_repack_buffer_cpy_tensor_from,
+    /* .cpy_tensor_to   = */ ggml_backend_cpu_repack_buffer_cpy_tensor_to,
+};
+
+static ggml_backend_buffer_t ggml_backend_cpu_repack_buffer_type_alloc_buffer(ggml_backend_buffer_type_t buft, size_t size) {
+    ggml_backend_buffer_t buffer = ggml_backend_cpu_weight_buffer_type_alloc_buffer(buft, size);
+    buffer->iface = cpu_repack_backend_buffer_i;
+
+    return buffer;
+}
+
+ggml_backend_buffer_type_t ggml_backend_cpu_repack_buffer_type(void) {
+    static struct ggml_backend_buffer_type ggml_backend_buffer_type_cpu_repack = {
+        /* .iface = */ {
+            /* .alloc_buffer     = */ ggml_backend_cpu_repack_buffer_type_alloc_buffer,
+            /* .get_alignment    = */ ggml_backend_cpu_buffer_type_get_alignment,
+            /* .get_alloc_size   = */ NULL, // defaults to ggml_nbytes, the layout does not change the size
+            /* .supports_backend = */ ggml_backend_cpu_buffer_type_supports_backend,
+        },
+        /* .context = */ NULL,
+    };
+
+    return &ggml_backend_buffer_type_cpu_repack;
+}
+
 struct ggml_backend_cpu_context {
     int n_threads;
     void * work_data;
     size_t work_size;
+
+    // created on first use, so that the workers persist across graphs
+    struct ggml_threadpool * threadpool;
+    bool                     threadpool_owned; // false for a pool set by ggml_backend_cpu_set_threadpool
+
+    // the plan of the last graph, reused while the graphs keep the same topology
+    struct ggml_cplan_cache * plan_cache;
+
+    // the graph submitted by graph_compute, NULL once ggml_backend_synchronize waited for it
+    struct ggml_compute_future * future;
 };
 
+static struct ggml_threadpool * ggml_backend_cpu_get_threadpool(struct ggml_backend_cpu_context * cpu_ctx) {
+    if (cpu_ctx->threadpool == NULL) {
+        cpu_ctx->threadpool       = ggml_threadpool_new(cpu_ctx->n_threads);
+        cpu_ctx->threadpool_owned = true;
+    }
+
+    return cpu_ctx->threadpool;
+}
+
 static const char * ggml_backend_cpu_name(ggml_backend_t backend) {
     return "CPU";
 
     GGML_UNUSED(backend);
 }
 
+static void ggml_backend_cpu_synchronize(ggml_backend_t backend) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+
+    if (cpu_ctx->future != NULL) {
+        ggml_compute_future_wait(cpu_ctx->future);
+        cpu_ctx->future = NULL;
+    }
+}
+
 static void ggml_backend_cpu_free(ggml_backend_t backend) {
     struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
+    ggml_backend_cpu_synchronize(backend);
+    if (cpu_ctx->threadpool_owned) {
+        ggml_threadpool_free(cpu_ctx->threadpool);
+    }
+    ggml_cplan_cache_free(cpu_ctx->plan_cache);
     free(cpu_ctx->work_data);
     free(cpu_ctx);
     free(backend);
@@ -485,17 +672,30 @@ static void ggml_backend_cpu_graph_plan_free(ggml_backend_t backend, ggml_backen
 }
 
 static void ggml_backend_cpu_graph_plan_compute(ggml_backend_t backend, ggml_backend_graph_plan_t plan) {
+    struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
     struct ggml_backend_plan_cpu * cpu_plan = (struct ggml_backend_plan_cpu *)plan;
 
-    ggml_graph_compute(&cpu_plan->cgraph, &cpu_plan->cplan);
+    ggml_backend_cpu_synchronize(backend);
 
-    GGML_UNUSED(backend);
+    // the pool is looked up on every call since ggml_backend_cpu_set_n_threads may have replaced it
+    struct ggml_threadpool * threadpool = ggml_backend_cpu_get_threadpool(cpu_ctx);
+    if (ggml_threadpool_get_n_threads(threadpool) >= cpu_plan->cplan.n_threads) {
+        cpu_plan->cplan.threadpool = threadpool;
+    } else {
+        cpu_plan->cplan.threadpool = NULL;
+    }
+
+    ggml_graph_compute(&cpu_plan->cgraph, &cpu_plan->cplan);
 }
 
+// returns as soon as the graph is submitted to the thread pool, ggml_backend_synchronize waits for it
 static void ggml_backend_cpu_graph_compute(ggml_backend_t backend, struct ggml_cgraph * cgraph) {
     struct ggml_backend_cpu_context * cpu_ctx = (struct ggml_backend_cpu_context *)backend->context;
 
-    struct ggml_cplan cplan = ggml_graph_plan(cgraph, cpu_ctx->n_threads);
+    // the previous graph still uses the work buffer, the plan cache and the pool
+    ggml_backend_cpu_synchronize(backend);
+
+    struct ggml_cplan cplan = ggml_graph_plan_cached(cgraph, cpu_ctx->n_threads, cpu_ctx->plan_cache);
 
     if (cpu_ctx->work_size < cplan.work_size) {
         // TODO: may be faster to free and use malloc to avoid the copy
@@ -503,9 +703,14 @@ static void ggml_backend_cpu_graph_compute(ggml_backend_t backend, struct ggml_c
         cpu_ctx->work_size = cplan.work_size;
     }
 
-    cplan.work_data = cpu_ctx->work_data;
+    cplan.work_data  = cpu_ctx->work_data;
+
+    struct ggml_threadpool * threadpool = ggml_backend_cpu_get_threadpool(cpu_ctx);
+    if (ggml_threadpool_get_n_threads(threadpool) >= cplan.n_threads) {
+        cplan.threadpool = threadpool;
+    }
 
-    ggml_graph_compute(cgraph, &cplan);
+    cpu_ctx->future = ggml_graph_compute_async(cgraph, &cplan);
 }
 
 static bool ggml_backend_cpu_supports_op(ggml_backend_t backend, const struct ggml_tensor * op) {
@@ -523,7 +728,7 @@ static struct ggml_backend_i cpu_backend_i = {
     /* .get_tensor_async        = */ NULL,
     /* .cpy_tensor_from_async   = */ NULL,
     /* .cpy_tensor_to_async     = */ NULL,
-    /* .synchronize             = */ NULL,
+    /* .synchronize             = */ ggml_backend_cpu_synchronize,
     /* .graph_plan_create       = */ ggml_backend_cpu_graph_plan_create,
     /* .graph_plan_free         = */ ggml_backend_cpu_graph_plan_free,
     /* .graph_plan_compute      = */ ggml_backend_cpu_graph_plan_compute,
@@ -537,6 +742,10 @@ ggml_backend_t ggml_backend_cpu_init(void) {
     ctx->n_threads = GGML_DEFAULT_N_THREADS;
     ctx->work_data = NULL;
     ctx->work_size = 0;
+    ctx->threadpool = NULL;
+    ctx->threadpool_owned = false;
+    ctx->plan_cache = ggml_cplan_cache_new();
+    ctx->future     = NULL;
 
     ggml_backend_t cpu_backend = malloc(sizeof(struct ggml_backend));
 
@@ -555,9 +764,32 @@ void ggml_backend_cpu_set_n_threads(ggml_backend_t backend_cpu, int n_threads) {
     GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
 
     struct ggml_backend_cpu_context * ctx = (struct ggml_backend_cpu_context *)backend_cpu->context;
+    if (ctx->n_threads != n_threads && ctx->threadpool_owned) {
+        ggml_backend_cpu_synchronize(backend_cpu);
+
+        // the pool is recreated with the new size on the next compute
+        ggml_threadpool_free(ctx->threadpool);
+        ctx->threadpool = NULL;
+    }
     ctx->n_threads = n_threads;
 }
 
+void ggml_backend_cpu_set_threadpool(ggml_backend_t backend_cpu, struct ggml_threadpool * threadpool) {
+    GGML_ASSERT(ggml_backend_is_cpu(backend_cpu));
+
+    struct ggml_backend_cpu_context * ctx = (struct ggml_backend_cpu_context *)backend_cpu->context;
+
+    ggml_backend_cpu_synchronize(backend_cpu);
+
+    if (ctx->threadpool_owned) {
+        ggml_threadpool_free(ctx->threadpool);
+    }
+
+    // with NULL, a pool owned by the backend is created on the next compute
+    ctx->threadpool       = threadpool;
+    ctx->threadpool_owned = false;
+}
+
 ggml_backend_buffer_t ggml_backend_cpu_buffer_from_ptr(void * ptr, size_t size) {
     return ggml_backend_buffer_init(ggml_backend_cpu_buffer_type(), cpu_backend_buffer_i_from_ptr, ptr, size);
 }
@@ -1183,6 +1415,7 @@ static struct ggml_tensor * graph_dup_tensor(struct ggml_hash_set hash_set, stru
         dst->view_offs = src->view_offs;
     }
     dst->op = src->op;
+    dst->flags = src->flags;
     memcpy(dst->op_params, src->op_params, sizeof(dst->op_params));
     ggml_set_name(dst, src->name);
 
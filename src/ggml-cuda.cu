@@ -6825,6 +6825,8 @@ inline void ggml_cuda_op_im2col(
 
     const bool is_2D = ((const int32_t*)(dst->op_params))[6] == 1;
 
+    GGML_ASSERT(((const int32_t*)(dst->op_params))[7] == GGML_PAD_MODE_ZERO && "circular padding not implemented");
+
     const int64_t N  = src1->ne[is_2D ? 3 : 2];
     const int64_t IC = src1->ne[is_2D ? 2 : 1];
     const int64_t IH = is_2D ? src1->ne[1] : 1;
@@ -8875,13 +8877,16 @@ static bool ggml_backend_cuda_supports_op(ggml_backend_t backend, const ggml_ten
         case GGML_OP_CPY:
         case GGML_OP_CONT:
         case GGML_OP_DIAG_MASK_INF:
-        case GGML_OP_SOFT_MAX:
         case GGML_OP_ROPE:
         case GGML_OP_ALIBI:
-        case GGML_OP_IM2COL:
         case GGML_OP_SUM_ROWS:
         case GGML_OP_ARGSORT:
             return true;
+        case GGML_OP_SOFT_MAX:
+            // no mask, scale or ALiBi bias of ggml_soft_max_ext
+            return tensor->src[1] == NULL && ((const float *) tensor->op_params)[0] == 1.0f && ((const float *) tensor->op_params)[1] == 0.0f;
+        case GGML_OP_IM2COL:
+            return ((const int32_t *) tensor->op_params)[7] == GGML_PAD_MODE_ZERO;
         default:
             return false;
     }
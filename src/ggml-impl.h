@@ -205,7 +205,7 @@ static inline ggml_fp16_t ggml_compute_fp32_to_fp16(float f) {
 #endif // __ARM_NEON
 
 // precomputed f32 table for f16 (256 KB)
-// defined in ggml.c, initialized in ggml_init()
+// defined in ggml.c, initialized in ggml_init() when GGML_FP16_TO_FP32_TABLE is defined
 extern float ggml_table_f32_f16[1 << 16];
 
 // On ARM NEON, it's quicker to directly convert x -> x instead of calling into ggml_lookup_fp16_to_fp32,
@@ -222,6 +222,8 @@ inline static float ggml_lookup_fp16_to_fp32(ggml_fp16_t f) {
 #define GGML_FP16_TO_FP32(x) ggml_lookup_fp16_to_fp32(x)
 #define GGML_FP32_TO_FP16(x) GGML_COMPUTE_FP32_TO_FP16(x)
 
+#define GGML_FP16_TO_FP32_TABLE
+
 #endif
 
 #define GGML_HASHTABLE_FULL ((size_t)-1)
@@ -795,12 +795,10 @@ static bool ggml_metal_supports_op(const struct ggml_tensor * op) {
         case GGML_OP_SCALE:
         case GGML_OP_SQR:
         case GGML_OP_SUM_ROWS:
-        case GGML_OP_SOFT_MAX:
         case GGML_OP_RMS_NORM:
         case GGML_OP_NORM:
         case GGML_OP_ALIBI:
         case GGML_OP_ROPE:
-        case GGML_OP_IM2COL:
         case GGML_OP_ARGSORT:
         case GGML_OP_DUP:
         case GGML_OP_CPY:
@@ -811,6 +809,15 @@ static bool ggml_metal_supports_op(const struct ggml_tensor * op) {
             {
                 return op->ne[0] % 4 == 0;
             } break;
+        case GGML_OP_SOFT_MAX:
+            {
+                // no mask, scale or ALiBi bias of ggml_soft_max_ext
+                return op->src[1] == NULL && ((const float *) op->op_params)[0] == 1.0f && ((const float *) op->op_params)[1] == 0.0f;
+            } break;
+        case GGML_OP_IM2COL:
+            {
+                return ((const int32_t *) op->op_params)[7] == GGML_PAD_MODE_ZERO;
+            } break;
         case GGML_OP_MUL_MAT:
         case GGML_OP_MUL_MAT_ID:
             {
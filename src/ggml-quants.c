@@ -1,3 +1,68 @@
+// with GGML_CPU_DISPATCH this file is compiled once more per ISA level (see src/CMakeLists.txt)
+// GGML_QUANTS_VARIANT is the level and every exported symbol of the variant gets it as a suffix
+#ifdef GGML_QUANTS_VARIANT
+#define GGML_QUANTS_CONCAT_(a, b) a ## _ ## b
+#define GGML_QUANTS_CONCAT(a, b)  GGML_QUANTS_CONCAT_(a, b)
+#define GGML_QUANTS_NAME(name)    GGML_QUANTS_CONCAT(name, GGML_QUANTS_VARIANT)
+
+#define quantize_row_q4_0_reference GGML_QUANTS_NAME(quantize_row_q4_0_reference)
+#define quantize_row_q4_1_reference GGML_QUANTS_NAME(quantize_row_q4_1_reference)
+#define quantize_row_q5_0_reference GGML_QUANTS_NAME(quantize_row_q5_0_reference)
+#define quantize_row_q5_1_reference GGML_QUANTS_NAME(quantize_row_q5_1_reference)
+#define quantize_row_q8_0_reference GGML_QUANTS_NAME(quantize_row_q8_0_reference)
+#define quantize_row_q8_1_reference GGML_QUANTS_NAME(quantize_row_q8_1_reference)
+#define quantize_row_q2_K_reference GGML_QUANTS_NAME(quantize_row_q2_K_reference)
+#define quantize_row_q3_K_reference GGML_QUANTS_NAME(quantize_row_q3_K_reference)
+#define quantize_row_q4_K_reference GGML_QUANTS_NAME(quantize_row_q4_K_reference)
+#define quantize_row_q5_K_reference GGML_QUANTS_NAME(quantize_row_q5_K_reference)
+#define quantize_row_q6_K_reference GGML_QUANTS_NAME(quantize_row_q6_K_reference)
+#define quantize_row_q8_K_reference GGML_QUANTS_NAME(quantize_row_q8_K_reference)
+#define quantize_row_q4_0           GGML_QUANTS_NAME(quantize_row_q4_0)
+#define quantize_row_q4_1           GGML_QUANTS_NAME(quantize_row_q4_1)
+#define quantize_row_q5_0           GGML_QUANTS_NAME(quantize_row_q5_0)
+#define quantize_row_q5_1           GGML_QUANTS_NAME(quantize_row_q5_1)
+#define quantize_row_q8_0           GGML_QUANTS_NAME(quantize_row_q8_0)
+#define quantize_row_q8_1           GGML_QUANTS_NAME(quantize_row_q8_1)
+#define quantize_row_q2_K           GGML_QUANTS_NAME(quantize_row_q2_K)
+#define quantize_row_q3_K           GGML_QUANTS_NAME(quantize_row_q3_K)
+#define quantize_row_q4_K           GGML_QUANTS_NAME(quantize_row_q4_K)
+#define quantize_row_q5_K           GGML_QUANTS_NAME(quantize_row_q5_K)
+#define quantize_row_q6_K           GGML_QUANTS_NAME(quantize_row_q6_K)
+#define quantize_row_q8_K           GGML_QUANTS_NAME(quantize_row_q8_K)
+#define dequantize_row_q4_0         GGML_QUANTS_NAME(dequantize_row_q4_0)
+#define dequantize_row_q4_1         GGML_QUANTS_NAME(dequantize_row_q4_1)
+#define dequantize_row_q5_0         GGML_QUANTS_NAME(dequantize_row_q5_0)
+#define dequantize_row_q5_1         GGML_QUANTS_NAME(dequantize_row_q5_1)
+#define dequantize_row_q8_0         GGML_QUANTS_NAME(dequantize_row_q8_0)
+#define dequantize_row_q2_K         GGML_QUANTS_NAME(dequantize_row_q2_K)
+#define dequantize_row_q3_K         GGML_QUANTS_NAME(dequantize_row_q3_K)
+#define dequantize_row_q4_K         GGML_QUANTS_NAME(dequantize_row_q4_K)
+#define dequantize_row_q5_K         GGML_QUANTS_NAME(dequantize_row_q5_K)
+#define dequantize_row_q6_K         GGML_QUANTS_NAME(dequantize_row_q6_K)
+#define dequantize_row_q8_K         GGML_QUANTS_NAME(dequantize_row_q8_K)
+#define ggml_vec_dot_q4_0_q8_0      GGML_QUANTS_NAME(ggml_vec_dot_q4_0_q8_0)
+#define ggml_vec_dot_q4_1_q8_1      GGML_QUANTS_NAME(ggml_vec_dot_q4_1_q8_1)
+#define ggml_vec_dot_q5_0_q8_0      GGML_QUANTS_NAME(ggml_vec_dot_q5_0_q8_0)
+#define ggml_vec_dot_q5_1_q8_1      GGML_QUANTS_NAME(ggml_vec_dot_q5_1_q8_1)
+#define ggml_vec_dot_q8_0_q8_0      GGML_QUANTS_NAME(ggml_vec_dot_q8_0_q8_0)
+#define ggml_vec_dot_q2_K_q8_K      GGML_QUANTS_NAME(ggml_vec_dot_q2_K_q8_K)
+#define ggml_vec_dot_q3_K_q8_K      GGML_QUANTS_NAME(ggml_vec_dot_q3_K_q8_K)
+#define ggml_vec_dot_q4_K_q8_K      GGML_QUANTS_NAME(ggml_vec_dot_q4_K_q8_K)
+#define ggml_vec_dot_q5_K_q8_K      GGML_QUANTS_NAME(ggml_vec_dot_q5_K_q8_K)
+#define ggml_vec_dot_q6_K_q8_K      GGML_QUANTS_NAME(ggml_vec_dot_q6_K_q8_K)
+#define ggml_vec_dot_q4_0_q8_0_nc   GGML_QUANTS_NAME(ggml_vec_dot_q4_0_q8_0_nc)
+#define ggml_vec_dot_q8_0_q8_0_nc   GGML_QUANTS_NAME(ggml_vec_dot_q8_0_q8_0_nc)
+#define ggml_vec_dot_q4_K_q8_K_nc   GGML_QUANTS_NAME(ggml_vec_dot_q4_K_q8_K_nc)
+#define ggml_vec_dot_q4_0x4_q8_0    GGML_QUANTS_NAME(ggml_vec_dot_q4_0x4_q8_0)
+#define ggml_vec_dot_q8_0x4_q8_0    GGML_QUANTS_NAME(ggml_vec_dot_q8_0x4_q8_0)
+#define ggml_quantize_q2_K          GGML_QUANTS_NAME(ggml_quantize_q2_K)
+#define ggml_quantize_q3_K          GGML_QUANTS_NAME(ggml_quantize_q3_K)
+#define ggml_quantize_q4_K          GGML_QUANTS_NAME(ggml_quantize_q4_K)
+#define ggml_quantize_q5_K          GGML_QUANTS_NAME(ggml_quantize_q5_K)
+#define ggml_quantize_q6_K          GGML_QUANTS_NAME(ggml_quantize_q6_K)
+#define ggml_quants_set_traits      GGML_QUANTS_NAME(ggml_quants_set_traits)
+#endif
+
 #include "ggml-quants.h"
 #include "ggml-impl.h"
 
@@ -2733,6 +2798,118 @@ void ggml_vec_dot_q4_0_q8_0(int n, float * restrict s, const void * restrict vx,
 #endif
 }
 
+// a row of x against GGML_VEC_DOT_NC rows of y, by bytes apart: the unpacked x block, its absolute
+// values and its scale are shared by all rows of y
+void ggml_vec_dot_q4_0_q8_0_nc(const int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+
+#if defined(__AVX2__)
+    const block_q4_0 * restrict x = vx;
+    const block_q8_0 * restrict y[GGML_VEC_DOT_NC];
+
+    __m256 acc[GGML_VEC_DOT_NC];
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        y[j]   = (const block_q8_0 *) ((const char *) vy + j*by);
+        acc[j] = _mm256_setzero_ps();
+    }
+
+    const __m256i off = _mm256_set1_epi8( 8 );
+
+    for (int i = 0; i < nb; ++i) {
+        const float dx = GGML_FP16_TO_FP32(x[i].d);
+
+        const __m256i bx = _mm256_sub_epi8(bytes_from_nibbles_32(x[i].qs), off);
+        const __m256i ax = _mm256_sign_epi8(bx, bx);
+
+        for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+            const __m256i qy = _mm256_loadu_si256((const __m256i *)y[j][i].qs);
+            const __m256  q  = mul_sum_us8_pairs_float(ax, _mm256_sign_epi8(qy, bx));
+
+            acc[j] = _mm256_fmadd_ps(_mm256_set1_ps(dx * GGML_FP16_TO_FP32(y[j][i].d)), q, acc[j]);
+        }
+    }
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        s[j*bs] = hsum_float_8(acc[j]);
+    }
+#else
+    GGML_UNUSED(nb);
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        ggml_vec_dot_q4_0_q8_0(n, s + j*bs, vx, (const char *) vy + j*by);
+    }
+#endif
+}
+
+// GGML_REPACK_ROWS rows of x interleaved block by block (see ggml_repack) against one row of y:
+// each block of y is loaded once for the blocks of all rows of x, which are adjacent in memory
+void ggml_vec_dot_q4_0x4_q8_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+
+    const block_q4_0 * restrict x = vx;
+    const block_q8_0 * restrict y = vy;
+
+#if defined(__AVX2__)
+    __m256 acc[GGML_REPACK_ROWS];
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        acc[r] = _mm256_setzero_ps();
+    }
+
+    const __m256i off = _mm256_set1_epi8( 8 );
+
+    for (int i = 0; i < nb; ++i) {
+        const float dy = GGML_FP16_TO_FP32(y[i].d);
+
+        const __m256i by = _mm256_loadu_si256((const __m256i *)y[i].qs);
+
+        for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+            const block_q4_0 * restrict xr = &x[i*GGML_REPACK_ROWS + r];
+
+            const __m256i bx = _mm256_sub_epi8(bytes_from_nibbles_32(xr->qs), off);
+            const __m256  q  = mul_sum_i8_pairs_float(bx, by);
+
+            acc[r] = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(xr->d) * dy), q, acc[r]);
+        }
+    }
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        s[r] = hsum_float_8(acc[r]);
+    }
+#else
+    // scalar
+    float sumf[GGML_REPACK_ROWS] = { 0.0f };
+
+    for (int i = 0; i < nb; ++i) {
+        for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+            const block_q4_0 * restrict xr = &x[i*GGML_REPACK_ROWS + r];
+
+            int sumi = 0;
+
+            for (int j = 0; j < qk/2; ++j) {
+                const int v0 = (xr->qs[j] & 0x0F) - 8;
+                const int v1 = (xr->qs[j] >>   4) - 8;
+
+                sumi += (v0 * y[i].qs[j]) + (v1 * y[i].qs[j + qk/2]);
+            }
+
+            sumf[r] += sumi*GGML_FP16_TO_FP32(xr->d)*GGML_FP16_TO_FP32(y[i].d);
+        }
+    }
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        s[r] = sumf[r];
+    }
+#endif
+}
+
 void ggml_vec_dot_q4_1_q8_1(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
     const int qk = QK8_1;
     const int nb = n / qk;
@@ -3641,6 +3818,107 @@ void ggml_vec_dot_q8_0_q8_0(const int n, float * restrict s, const void * restri
 #endif
 }
 
+void ggml_vec_dot_q8_0_q8_0_nc(const int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+
+#if defined(__AVX2__)
+    const block_q8_0 * restrict x = vx;
+    const block_q8_0 * restrict y[GGML_VEC_DOT_NC];
+
+    __m256 acc[GGML_VEC_DOT_NC];
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        y[j]   = (const block_q8_0 *) ((const char *) vy + j*by);
+        acc[j] = _mm256_setzero_ps();
+    }
+
+    for (int i = 0; i < nb; ++i) {
+        const float dx = GGML_FP16_TO_FP32(x[i].d);
+
+        const __m256i bx = _mm256_loadu_si256((const __m256i *)x[i].qs);
+        const __m256i ax = _mm256_sign_epi8(bx, bx);
+
+        for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+            const __m256i qy = _mm256_loadu_si256((const __m256i *)y[j][i].qs);
+            const __m256  q  = mul_sum_us8_pairs_float(ax, _mm256_sign_epi8(qy, bx));
+
+            acc[j] = _mm256_fmadd_ps(_mm256_set1_ps(dx * GGML_FP16_TO_FP32(y[j][i].d)), q, acc[j]);
+        }
+    }
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        s[j*bs] = hsum_float_8(acc[j]);
+    }
+#else
+    GGML_UNUSED(nb);
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        ggml_vec_dot_q8_0_q8_0(n, s + j*bs, vx, (const char *) vy + j*by);
+    }
+#endif
+}
+
+void ggml_vec_dot_q8_0x4_q8_0(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
+    const int qk = QK8_0;
+    const int nb = n / qk;
+
+    assert(n % qk == 0);
+
+    const block_q8_0 * restrict x = vx;
+    const block_q8_0 * restrict y = vy;
+
+#if defined(__AVX2__)
+    __m256 acc[GGML_REPACK_ROWS];
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        acc[r] = _mm256_setzero_ps();
+    }
+
+    for (int i = 0; i < nb; ++i) {
+        const float dy = GGML_FP16_TO_FP32(y[i].d);
+
+        const __m256i by = _mm256_loadu_si256((const __m256i *)y[i].qs);
+
+        for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+            const block_q8_0 * restrict xr = &x[i*GGML_REPACK_ROWS + r];
+
+            const __m256i bx = _mm256_loadu_si256((const __m256i *)xr->qs);
+            const __m256  q  = mul_sum_i8_pairs_float(bx, by);
+
+            acc[r] = _mm256_fmadd_ps(_mm256_set1_ps(GGML_FP16_TO_FP32(xr->d) * dy), q, acc[r]);
+        }
+    }
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        s[r] = hsum_float_8(acc[r]);
+    }
+#else
+    // scalar
+    float sumf[GGML_REPACK_ROWS] = { 0.0f };
+
+    for (int i = 0; i < nb; ++i) {
+        for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+            const block_q8_0 * restrict xr = &x[i*GGML_REPACK_ROWS + r];
+
+            int sumi = 0;
+
+            for (int j = 0; j < qk; j++) {
+                sumi += xr->qs[j]*y[i].qs[j];
+            }
+
+            sumf[r] += sumi*(GGML_FP16_TO_FP32(xr->d)*GGML_FP16_TO_FP32(y[i].d));
+        }
+    }
+
+    for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+        s[r] = sumf[r];
+    }
+#endif
+}
+
 #if QK_K == 256
 void ggml_vec_dot_q2_K_q8_K(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
 
@@ -5860,6 +6138,104 @@ void ggml_vec_dot_q4_K_q8_K(const int n, float * restrict s, const void * restri
 }
 #endif
 
+// the scales, mins and unpacked quants of a q4_K super-block are shared by all rows of y
+void ggml_vec_dot_q4_K_q8_K_nc(const int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by) {
+    assert(n % QK_K == 0);
+
+    const int nb = n / QK_K;
+
+#if defined(__AVX2__) && QK_K == 256
+    const block_q4_K * restrict x = vx;
+    const block_q8_K * restrict y[GGML_VEC_DOT_NC];
+
+    static const uint32_t kmask1 = 0x3f3f3f3f;
+    static const uint32_t kmask2 = 0x0f0f0f0f;
+    static const uint32_t kmask3 = 0x03030303;
+
+    uint32_t utmp[4];
+
+    const __m256i m4 = _mm256_set1_epi8(0xF);
+
+    __m256 acc  [GGML_VEC_DOT_NC];
+    __m128 acc_m[GGML_VEC_DOT_NC];
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        y[j]     = (const block_q8_K *) ((const char *) vy + j*by);
+        acc[j]   = _mm256_setzero_ps();
+        acc_m[j] = _mm_setzero_ps();
+    }
+
+    for (int i = 0; i < nb; ++i) {
+        const float d    =  GGML_FP16_TO_FP32(x[i].d);
+        const float dmin = -GGML_FP16_TO_FP32(x[i].dmin);
+
+        memcpy(utmp, x[i].scales, 12);
+        utmp[3] = ((utmp[2] >> 4) & kmask2) | (((utmp[1] >> 6) & kmask3) << 4);
+        const uint32_t uaux = utmp[1] & kmask1;
+        utmp[1] = (utmp[2] & kmask2) | (((utmp[0] >> 6) & kmask3) << 4);
+        utmp[2] = uaux;
+        utmp[0] &= kmask1;
+
+        const __m256i mins_and_scales = _mm256_cvtepu8_epi16(_mm_set_epi32(utmp[3], utmp[2], utmp[1], utmp[0]));
+        const __m128i mins = _mm256_extracti128_si256(mins_and_scales, 1);
+
+        const __m128i sc128  = _mm256_extracti128_si256(mins_and_scales, 0);
+        const __m256i scales = MM256_SET_M128I(sc128, sc128);
+
+        __m256i sumi[GGML_VEC_DOT_NC];
+
+        for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+            const __m256i q8sums = _mm256_loadu_si256((const __m256i*)y[j][i].bsums);
+            const __m128i q8s = _mm_hadd_epi16(_mm256_extracti128_si256(q8sums, 0), _mm256_extracti128_si256(q8sums, 1));
+            const __m128i prod = _mm_madd_epi16(mins, q8s);
+            acc_m[j] = _mm_fmadd_ps(_mm_set1_ps(dmin * y[j][i].d), _mm_cvtepi32_ps(prod), acc_m[j]);
+
+            sumi[j] = _mm256_setzero_si256();
+        }
+
+        const uint8_t * restrict q4 = x[i].qs;
+
+        for (int k = 0; k < QK_K/64; ++k) {
+            const __m256i scale_l = _mm256_shuffle_epi8(scales, get_scale_shuffle_k4(2*k+0));
+            const __m256i scale_h = _mm256_shuffle_epi8(scales, get_scale_shuffle_k4(2*k+1));
+
+            const __m256i q4bits = _mm256_loadu_si256((const __m256i*)q4); q4 += 32;
+            const __m256i q4l = _mm256_and_si256(q4bits, m4);
+            const __m256i q4h = _mm256_and_si256(_mm256_srli_epi16(q4bits, 4), m4);
+
+            for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+                const int8_t * restrict q8 = y[j][i].qs + 64*k;
+
+                const __m256i q8l = _mm256_loadu_si256((const __m256i*)(q8 +  0));
+                const __m256i q8h = _mm256_loadu_si256((const __m256i*)(q8 + 32));
+
+                const __m256i p16l = _mm256_madd_epi16(scale_l, _mm256_maddubs_epi16(q4l, q8l));
+                const __m256i p16h = _mm256_madd_epi16(scale_h, _mm256_maddubs_epi16(q4h, q8h));
+
+                sumi[j] = _mm256_add_epi32(sumi[j], _mm256_add_epi32(p16l, p16h));
+            }
+        }
+
+        for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+            acc[j] = _mm256_fmadd_ps(_mm256_set1_ps(d * y[j][i].d), _mm256_cvtepi32_ps(sumi[j]), acc[j]);
+        }
+    }
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        __m128 m = _mm_add_ps(acc_m[j], _mm_movehl_ps(acc_m[j], acc_m[j]));
+        m = _mm_add_ss(m, _mm_movehdup_ps(m));
+
+        s[j*bs] = hsum_float_8(acc[j]) + _mm_cvtss_f32(m);
+    }
+#else
+    GGML_UNUSED(nb);
+
+    for (int j = 0; j < GGML_VEC_DOT_NC; ++j) {
+        ggml_vec_dot_q4_K_q8_K(n, s + j*bs, vx, (const char *) vy + j*by);
+    }
+#endif
+}
+
 #if QK_K == 256
 void ggml_vec_dot_q5_K_q8_K(const int n, float * restrict s, const void * restrict vx, const void * restrict vy) {
     assert(n % QK_K == 0);
@@ -7380,3 +7756,57 @@ void ggml_vec_dot_q6_K_q8_K(const int n, float * restrict s, const void * restri
 }
 
 #endif
+
+#ifdef GGML_QUANTS_VARIANT
+// point the type traits at the kernels of this ISA level
+void ggml_quants_set_traits(ggml_type_traits_t * traits) {
+    traits[GGML_TYPE_Q4_0].to_float   = (ggml_to_float_t) dequantize_row_q4_0;
+    traits[GGML_TYPE_Q4_0].from_float = quantize_row_q4_0;
+    traits[GGML_TYPE_Q4_0].vec_dot    = ggml_vec_dot_q4_0_q8_0;
+    traits[GGML_TYPE_Q4_0].vec_dot_nc = ggml_vec_dot_q4_0_q8_0_nc;
+    traits[GGML_TYPE_Q4_0].vec_dot_x4 = ggml_vec_dot_q4_0x4_q8_0;
+
+    traits[GGML_TYPE_Q4_1].to_float   = (ggml_to_float_t) dequantize_row_q4_1;
+    traits[GGML_TYPE_Q4_1].from_float = quantize_row_q4_1;
+    traits[GGML_TYPE_Q4_1].vec_dot    = ggml_vec_dot_q4_1_q8_1;
+
+    traits[GGML_TYPE_Q5_0].to_float   = (ggml_to_float_t) dequantize_row_q5_0;
+    traits[GGML_TYPE_Q5_0].from_float = quantize_row_q5_0;
+    traits[GGML_TYPE_Q5_0].vec_dot    = ggml_vec_dot_q5_0_q8_0;
+
+    traits[GGML_TYPE_Q5_1].to_float   = (ggml_to_float_t) dequantize_row_q5_1;
+    traits[GGML_TYPE_Q5_1].from_float = quantize_row_q5_1;
+    traits[GGML_TYPE_Q5_1].vec_dot    = ggml_vec_dot_q5_1_q8_1;
+
+    traits[GGML_TYPE_Q8_0].to_float   = (ggml_to_float_t) dequantize_row_q8_0;
+    traits[GGML_TYPE_Q8_0].from_float = quantize_row_q8_0;
+    traits[GGML_TYPE_Q8_0].vec_dot    = ggml_vec_dot_q8_0_q8_0;
+    traits[GGML_TYPE_Q8_0].vec_dot_nc = ggml_vec_dot_q8_0_q8_0_nc;
+    traits[GGML_TYPE_Q8_0].vec_dot_x4 = ggml_vec_dot_q8_0x4_q8_0;
+
+    traits[GGML_TYPE_Q8_1].from_float = quantize_row_q8_1;
+
+    traits[GGML_TYPE_Q2_K].to_float   = (ggml_to_float_t) dequantize_row_q2_K;
+    traits[GGML_TYPE_Q2_K].from_float = quantize_row_q2_K;
+    traits[GGML_TYPE_Q2_K].vec_dot    = ggml_vec_dot_q2_K_q8_K;
+
+    traits[GGML_TYPE_Q3_K].to_float   = (ggml_to_float_t) dequantize_row_q3_K;
+    traits[GGML_TYPE_Q3_K].from_float = quantize_row_q3_K;
+    traits[GGML_TYPE_Q3_K].vec_dot    = ggml_vec_dot_q3_K_q8_K;
+
+    traits[GGML_TYPE_Q4_K].to_float   = (ggml_to_float_t) dequantize_row_q4_K;
+    traits[GGML_TYPE_Q4_K].from_float = quantize_row_q4_K;
+    traits[GGML_TYPE_Q4_K].vec_dot    = ggml_vec_dot_q4_K_q8_K;
+    traits[GGML_TYPE_Q4_K].vec_dot_nc = ggml_vec_dot_q4_K_q8_K_nc;
+
+    traits[GGML_TYPE_Q5_K].to_float   = (ggml_to_float_t) dequantize_row_q5_K;
+    traits[GGML_TYPE_Q5_K].from_float = quantize_row_q5_K;
+    traits[GGML_TYPE_Q5_K].vec_dot    = ggml_vec_dot_q5_K_q8_K;
+
+    traits[GGML_TYPE_Q6_K].to_float   = (ggml_to_float_t) dequantize_row_q6_K;
+    traits[GGML_TYPE_Q6_K].from_float = quantize_row_q6_K;
+    traits[GGML_TYPE_Q6_K].vec_dot    = ggml_vec_dot_q6_K_q8_K;
+
+    traits[GGML_TYPE_Q8_K].from_float = quantize_row_q8_K;
+}
+#endif
@@ -222,3 +222,19 @@ void ggml_vec_dot_q3_K_q8_K(int n, float * restrict s, const void * restrict vx,
 void ggml_vec_dot_q4_K_q8_K(int n, float * restrict s, const void * restrict vx, const void * restrict vy);
 void ggml_vec_dot_q5_K_q8_K(int n, float * restrict s, const void * restrict vx, const void * restrict vy);
 void ggml_vec_dot_q6_K_q8_K(int n, float * restrict s, const void * restrict vx, const void * restrict vy);
+
+// Dot product of one row of x with GGML_VEC_DOT_NC rows of y
+void ggml_vec_dot_q4_0_q8_0_nc(int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by);
+void ggml_vec_dot_q8_0_q8_0_nc(int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by);
+void ggml_vec_dot_q4_K_q8_K_nc(int n, float * restrict s, size_t bs, const void * restrict vx, const void * restrict vy, size_t by);
+
+// Dot products of GGML_REPACK_ROWS interleaved rows of x with one row of y
+void ggml_vec_dot_q4_0x4_q8_0(int n, float * restrict s, const void * restrict vx, const void * restrict vy);
+void ggml_vec_dot_q8_0x4_q8_0(int n, float * restrict s, const void * restrict vx, const void * restrict vy);
+
+#ifdef GGML_CPU_DISPATCH
+// ggml-quants.c compiled per ISA level, each variant points the type traits at its own kernels
+void ggml_quants_set_traits_avx   (ggml_type_traits_t * traits);
+void ggml_quants_set_traits_avx2  (ggml_type_traits_t * traits);
+void ggml_quants_set_traits_avx512(ggml_type_traits_t * traits);
+#endif
@@ -84,18 +84,46 @@ static int sched_yield (void) {
     Sleep (0);
     return 0;
 }
+
+typedef SRWLOCK            ggml_mutex_t;
+typedef CONDITION_VARIABLE ggml_cond_t;
+
+#define ggml_mutex_init(m)     InitializeSRWLock(m)
+#define ggml_mutex_destroy(m)  UNUSED(m)
+#define ggml_mutex_lock(m)     AcquireSRWLockExclusive(m)
+#define ggml_mutex_unlock(m)   ReleaseSRWLockExclusive(m)
+#define ggml_cond_init(c)      InitializeConditionVariable(c)
+#define ggml_cond_destroy(c)   UNUSED(c)
+#define ggml_cond_wait(c, m)   SleepConditionVariableSRW(c, m, INFINITE, 0)
+#define ggml_cond_broadcast(c) WakeAllConditionVariable(c)
 #else
 #include <pthread.h>
 #include <stdatomic.h>
 
 typedef void * thread_ret_t;
 
+typedef pthread_mutex_t ggml_mutex_t;
+typedef pthread_cond_t  ggml_cond_t;
+
+#define ggml_mutex_init(m)     pthread_mutex_init(m, NULL)
+#define ggml_mutex_destroy(m)  pthread_mutex_destroy(m)
+#define ggml_mutex_lock(m)     pthread_mutex_lock(m)
+#define ggml_mutex_unlock(m)   pthread_mutex_unlock(m)
+#define ggml_cond_init(c)      pthread_cond_init(c, NULL)
+#define ggml_cond_destroy(c)   pthread_cond_destroy(c)
+#define ggml_cond_wait(c, m)   pthread_cond_wait(c, m)
+#define ggml_cond_broadcast(c) pthread_cond_broadcast(c)
+
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
 #endif
 
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
 #ifdef GGML_USE_CPU_HBM
 #include <hbwmalloc.h>
 #endif
@@ -145,9 +173,9 @@ void ggml_print_backtrace(void) {
 
 /*#define GGML_PERF*/
 #define GGML_DEBUG 0
-#define GGML_GELU_FP16
-#define GGML_GELU_QUICK_FP16
-#define GGML_SILU_FP16
+// #define GGML_GELU_FP16
+// #define GGML_GELU_QUICK_FP16
+// #define GGML_SILU_FP16
 // #define GGML_CROSS_ENTROPY_EXP_FP16
 // #define GGML_FLASH_ATTN_EXP_FP16
 
@@ -155,6 +183,17 @@ void ggml_print_backtrace(void) {
 #define GGML_VEC_DOT_UNROLL  2
 #define GGML_VEC_MAD_UNROLL  32
 
+#define GGML_CHUNKS_PER_THREAD 4    // work items per thread of the row-parallel ops, see ggml_chunk_next
+#define GGML_MUL_MAT_CHUNK     16   // rows of src0 and src1 per mul_mat chunk
+#define GGML_GEMM_MR           4    // src0 rows of the register tile of the mul_mat GEMM kernel
+#define GGML_GEMM_NR           3    // src1 rows of the register tile of the mul_mat GEMM kernel
+#define GGML_GEMM_KC           1024 // values along ne00 per pass of the GEMM kernel
+#define GGML_GEMM_MIN_NE11     16   // src1 rows from which F32 and F16 mul_mat use the GEMM kernel
+#define GGML_FLASH_ATTN_TILE   8    // rows of q of ggml_flash_attn_ext that share each row of k and v
+#define GGML_SORT_RADIX_BITS   8    // bits of the key per pass of the argsort radix sort, 4 passes for 32 bit keys
+#define GGML_SORT_INSERTION    32   // rows up to this length are sorted with an insertion sort
+#define GGML_SORT_SPLIT        8192 // rows from this length are shared by the threads when there are fewer rows than threads
+
 //
 // logging
 //
@@ -263,17 +302,19 @@ typedef double ggml_float;
 // global data
 //
 
-// precomputed gelu table for f16 (128 KB)
-static ggml_fp16_t ggml_table_gelu_f16[1 << 16];
+// precomputed gelu, quick gelu, silu and exp tables for f16 (128 KB each)
+// only the FP16 paths use them, so each one is built on first use (ggml_table_f16_get)
+enum ggml_table_f16 {
+    GGML_TABLE_GELU,
+    GGML_TABLE_GELU_QUICK,
+    GGML_TABLE_SILU,
+    GGML_TABLE_EXP,
 
-// precomputed quick gelu table for f16 (128 KB)
-static ggml_fp16_t ggml_table_gelu_quick_f16[1 << 16];
-
-// precomputed silu table for f16 (128 KB)
-static ggml_fp16_t ggml_table_silu_f16[1 << 16];
+    GGML_TABLE_F16_COUNT,
+};
 
-// precomputed exp table for f16 (128 KB)
-static ggml_fp16_t ggml_table_exp_f16[1 << 16];
+static ggml_fp16_t ggml_table_f16[GGML_TABLE_F16_COUNT][1 << 16];
+static atomic_int  ggml_table_f16_ready[GGML_TABLE_F16_COUNT];
 
 // precomputed f32 table for f16 (256 KB) (ggml-impl.h)
 float ggml_table_f32_f16[1 << 16];
@@ -289,7 +330,14 @@ ggml_fp16_t ggml_fp32_to_fp16(float x) {
 }
 
 void ggml_fp16_to_fp32_row(const ggml_fp16_t * x, float * y, int n) {
-    for (int i = 0; i < n; i++) {
+    int i = 0;
+#if defined(__F16C__)
+    for (; i + 7 < n; i += 8) {
+        __m128i x_vec = _mm_loadu_si128((const __m128i *)(x + i));
+        _mm256_storeu_ps(y + i, _mm256_cvtph_ps(x_vec));
+    }
+#endif
+    for (; i < n; i++) {
         y[i] = GGML_FP16_TO_FP32(x[i]);
     }
 }
@@ -394,7 +442,8 @@ static const size_t CACHE_LINE_SIZE_F32 = CACHE_LINE_SIZE/sizeof(float);
 static void ggml_vec_dot_f32(const int n, float * restrict s, const float * restrict x, const float * restrict y);
 static void ggml_vec_dot_f16(const int n, float * restrict s, ggml_fp16_t * restrict x, ggml_fp16_t * restrict y);
 
-static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
+// the quantized kernels are replaced by the best ISA level of the host in ggml_init with GGML_CPU_DISPATCH
+static ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
     [GGML_TYPE_I8] = {
         .type_name                = "i8",
         .blck_size                = 1,
@@ -442,6 +491,8 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_reference     = (ggml_from_float_t) quantize_row_q4_0_reference,
         .vec_dot                  = ggml_vec_dot_q4_0_q8_0,
         .vec_dot_type             = GGML_TYPE_Q8_0,
+        .vec_dot_nc               = ggml_vec_dot_q4_0_q8_0_nc,
+        .vec_dot_x4               = ggml_vec_dot_q4_0x4_q8_0,
     },
     [GGML_TYPE_Q4_1] = {
         .type_name                = "q4_1",
@@ -508,6 +559,8 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_reference     = (ggml_from_float_t) quantize_row_q8_0_reference,
         .vec_dot                  = ggml_vec_dot_q8_0_q8_0,
         .vec_dot_type             = GGML_TYPE_Q8_0,
+        .vec_dot_nc               = ggml_vec_dot_q8_0_q8_0_nc,
+        .vec_dot_x4               = ggml_vec_dot_q8_0x4_q8_0,
     },
     [GGML_TYPE_Q8_1] = {
         .type_name                = "q8_1",
@@ -550,6 +603,7 @@ static const ggml_type_traits_t type_traits[GGML_TYPE_COUNT] = {
         .from_float_reference     = (ggml_from_float_t) quantize_row_q4_K_reference,
         .vec_dot                  = ggml_vec_dot_q4_K_q8_K,
         .vec_dot_type             = GGML_TYPE_Q8_K,
+        .vec_dot_nc               = ggml_vec_dot_q4_K_q8_K_nc,
     },
     [GGML_TYPE_Q5_K] = {
         .type_name                = "q5_K",
@@ -588,6 +642,49 @@ ggml_type_traits_t ggml_internal_get_type_traits(enum ggml_type type) {
     return type_traits[type];
 }
 
+//
+// runtime CPU feature dispatch
+//
+
+#if defined(GGML_CPU_DISPATCH)
+enum ggml_cpu_level {
+    GGML_CPU_LEVEL_BASE,
+    GGML_CPU_LEVEL_AVX,    // AVX
+    GGML_CPU_LEVEL_AVX2,   // AVX2, FMA, F16C
+    GGML_CPU_LEVEL_AVX512, // AVX512 F, BW, DQ, VL on top of AVX2
+};
+
+static enum ggml_cpu_level g_cpu_level = GGML_CPU_LEVEL_BASE;
+#endif
+
+static void ggml_cpu_dispatch_init(void) {
+#if defined(GGML_CPU_DISPATCH)
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx")) {
+        g_cpu_level = GGML_CPU_LEVEL_AVX;
+    }
+    if (g_cpu_level == GGML_CPU_LEVEL_AVX &&
+        __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && __builtin_cpu_supports("f16c")) {
+        g_cpu_level = GGML_CPU_LEVEL_AVX2;
+    }
+    if (g_cpu_level == GGML_CPU_LEVEL_AVX2 &&
+        __builtin_cpu_supports("avx512f")  && __builtin_cpu_supports("avx512bw") &&
+        __builtin_cpu_supports("avx512dq") && __builtin_cpu_supports("avx512vl")) {
+        g_cpu_level = GGML_CPU_LEVEL_AVX512;
+    }
+
+    switch (g_cpu_level) {
+        case GGML_CPU_LEVEL_BASE:                                                  break;
+        case GGML_CPU_LEVEL_AVX:    ggml_quants_set_traits_avx   (type_traits); break;
+        case GGML_CPU_LEVEL_AVX2:   ggml_quants_set_traits_avx2  (type_traits); break;
+        case GGML_CPU_LEVEL_AVX512: ggml_quants_set_traits_avx512(type_traits); break;
+    }
+
+    GGML_PRINT_DEBUG("%s: cpu level %d\n", __func__, (int) g_cpu_level);
+#endif
+}
+
 //
 // simd mappings
 //
@@ -1401,88 +1498,315 @@ static const float GELU_COEF_A     = 0.044715f;
 static const float GELU_QUICK_COEF = -1.702f;
 static const float SQRT_2_OVER_PI  = 0.79788456080286535587989211986876f;
 
+#if (defined(__ARM_NEON) && defined(__aarch64__)) || \
+    (defined(__AVX512F__) && defined(__AVX512DQ__)) || \
+    (defined(__AVX2__) && defined(__FMA__))
+#define GGML_SIMD_EXPF
+#endif
+
+#ifdef GGML_SIMD_EXPF
+
+// exp(x) = 2^n * exp(b) with n = round(x/ln2) and b = x - n*ln2 (ln2 split in two parts), exp(b) by a
+// degree 5 polynomial, max relative error ~1.5 ulp
+// for |n| > 126 the scale 2^n is applied as two factors, so that large x saturate to inf and small x
+// (and -inf) flush to 0
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+
+inline static float32x4_t ggml_v_expf(float32x4_t x) {
+    const float32x4_t r = vdupq_n_f32(0x1.8p23f);
+    const float32x4_t z = vfmaq_f32(r, x, vdupq_n_f32(0x1.715476p+0f));
+    const float32x4_t n = vsubq_f32(z, r);
+    const float32x4_t b = vfmsq_f32(vfmsq_f32(x, n, vdupq_n_f32(0x1.62e4p-1f)), n, vdupq_n_f32(0x1.7f7d1cp-20f));
+    const uint32x4_t  e = vshlq_n_u32(vreinterpretq_u32_f32(z), 23);
+    const float32x4_t k = vreinterpretq_f32_u32(vaddq_u32(e, vreinterpretq_u32_f32(vdupq_n_f32(1))));
+    const uint32x4_t  c = vcagtq_f32(n, vdupq_n_f32(126));
+    const float32x4_t u = vmulq_f32(b, b);
+    const float32x4_t j = vfmaq_f32(
+        vmulq_f32(vdupq_n_f32(0x1.ffffecp-1f), b),
+        vfmaq_f32(vfmaq_f32(vdupq_n_f32(0x1.fffdb6p-2f), vdupq_n_f32(0x1.555e66p-3f), b),
+                  vfmaq_f32(vdupq_n_f32(0x1.573e2ep-5f), vdupq_n_f32(0x1.0e4020p-7f), b), u), u);
+    if (!vpaddd_u64(vreinterpretq_u64_u32(c))) {
+        return vfmaq_f32(k, j, k);
+    }
+    const uint32x4_t  d  = vandq_u32(vclezq_f32(n), vdupq_n_u32(0x82000000));
+    const float32x4_t s1 = vreinterpretq_f32_u32(vaddq_u32(d, vdupq_n_u32(0x7f000000)));
+    const float32x4_t s2 = vreinterpretq_f32_u32(vsubq_u32(e, d));
+    return vbslq_f32(vcagtq_f32(n, vdupq_n_f32(192)), vmulq_f32(s1, s1),
+                     vbslq_f32(c, vmulq_f32(vfmaq_f32(s2, s2, j), s1), vfmaq_f32(k, k, j)));
+}
+
+// x*sigmoid(t)
+inline static float32x4_t ggml_v_sigmoid_mul(float32x4_t x, float32x4_t t) {
+    return vdivq_f32(x, vaddq_f32(vdupq_n_f32(1.0f), ggml_v_expf(vnegq_f32(t))));
+}
+
+#elif defined(__AVX512F__) && defined(__AVX512DQ__)
+
+inline static __m512 ggml_v_expf(__m512 x) {
+    const __m512  r = _mm512_set1_ps(0x1.8p23f);
+    const __m512  z = _mm512_fmadd_ps(x, _mm512_set1_ps(0x1.715476p+0f), r);
+    const __m512  n = _mm512_sub_ps(z, r);
+    const __m512  b = _mm512_fnmadd_ps(n, _mm512_set1_ps(0x1.7f7d1cp-20f),
+                      _mm512_fnmadd_ps(n, _mm512_set1_ps(0x1.62e4p-1f), x));
+    const __m512i e = _mm512_slli_epi32(_mm512_castps_si512(z), 23);
+    const __m512  k = _mm512_castsi512_ps(_mm512_add_epi32(e, _mm512_castps_si512(_mm512_set1_ps(1))));
+    const __mmask16 c = _mm512_cmp_ps_mask(_mm512_abs_ps(n), _mm512_set1_ps(126), _CMP_GT_OQ);
+    const __m512  u = _mm512_mul_ps(b, b);
+    const __m512  j = _mm512_fmadd_ps(
+        _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_set1_ps(0x1.0e4020p-7f), b, _mm512_set1_ps(0x1.573e2ep-5f)), u,
+                        _mm512_fmadd_ps(_mm512_set1_ps(0x1.555e66p-3f), b, _mm512_set1_ps(0x1.fffdb6p-2f))),
+        u, _mm512_mul_ps(_mm512_set1_ps(0x1.ffffecp-1f), b));
+    if (_mm512_kortestz(c, c)) {
+        return _mm512_fmadd_ps(j, k, k);
+    }
+    const __m512i g = _mm512_and_si512(
+        _mm512_movm_epi32(_mm512_cmp_ps_mask(n, _mm512_setzero_ps(), _CMP_LE_OQ)),
+        _mm512_set1_epi32(0x82000000u));
+    const __m512  s1 = _mm512_castsi512_ps(_mm512_add_epi32(g, _mm512_set1_epi32(0x7f000000u)));
+    const __m512  s2 = _mm512_castsi512_ps(_mm512_sub_epi32(e, g));
+    const __mmask16 d = _mm512_cmp_ps_mask(_mm512_abs_ps(n), _mm512_set1_ps(192), _CMP_GT_OQ);
+    return _mm512_mask_blend_ps(d,
+        _mm512_mask_blend_ps(c, _mm512_fmadd_ps(k, j, k), _mm512_mul_ps(_mm512_fmadd_ps(s2, j, s2), s1)),
+        _mm512_mul_ps(s1, s1));
+}
+
+// x*sigmoid(t)
+inline static __m512 ggml_v_sigmoid_mul(__m512 x, __m512 t) {
+    return _mm512_div_ps(x, _mm512_add_ps(_mm512_set1_ps(1.0f), ggml_v_expf(_mm512_sub_ps(_mm512_setzero_ps(), t))));
+}
+
+#elif defined(__AVX2__) && defined(__FMA__)
+
+inline static __m256 ggml_v_expf(__m256 x) {
+    const __m256  r = _mm256_set1_ps(0x1.8p23f);
+    const __m256  z = _mm256_fmadd_ps(x, _mm256_set1_ps(0x1.715476p+0f), r);
+    const __m256  n = _mm256_sub_ps(z, r);
+    const __m256  b = _mm256_fnmadd_ps(n, _mm256_set1_ps(0x1.7f7d1cp-20f),
+                      _mm256_fnmadd_ps(n, _mm256_set1_ps(0x1.62e4p-1f), x));
+    const __m256i e = _mm256_slli_epi32(_mm256_castps_si256(z), 23);
+    const __m256  k = _mm256_castsi256_ps(_mm256_add_epi32(e, _mm256_castps_si256(_mm256_set1_ps(1))));
+    const __m256  c = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.f), n), _mm256_set1_ps(126), _CMP_GT_OQ);
+    const __m256  u = _mm256_mul_ps(b, b);
+    const __m256  j = _mm256_fmadd_ps(
+        _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_set1_ps(0x1.0e4020p-7f), b, _mm256_set1_ps(0x1.573e2ep-5f)), u,
+                        _mm256_fmadd_ps(_mm256_set1_ps(0x1.555e66p-3f), b, _mm256_set1_ps(0x1.fffdb6p-2f))),
+        u, _mm256_mul_ps(_mm256_set1_ps(0x1.ffffecp-1f), b));
+    if (!_mm256_movemask_ps(c)) {
+        return _mm256_fmadd_ps(j, k, k);
+    }
+    const __m256i g = _mm256_and_si256(
+        _mm256_castps_si256(_mm256_cmp_ps(n, _mm256_setzero_ps(), _CMP_LE_OQ)),
+        _mm256_set1_epi32(0x82000000u));
+    const __m256  s1 = _mm256_castsi256_ps(_mm256_add_epi32(g, _mm256_set1_epi32(0x7f000000u)));
+    const __m256  s2 = _mm256_castsi256_ps(_mm256_sub_epi32(e, g));
+    const __m256  d  = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.f), n), _mm256_set1_ps(192), _CMP_GT_OQ);
+    return _mm256_blendv_ps(
+        _mm256_blendv_ps(_mm256_fmadd_ps(k, j, k), _mm256_mul_ps(_mm256_fmadd_ps(s2, j, s2), s1), c),
+        _mm256_mul_ps(s1, s1), d);
+}
+
+// x*sigmoid(t)
+inline static __m256 ggml_v_sigmoid_mul(__m256 x, __m256 t) {
+    return _mm256_div_ps(x, _mm256_add_ps(_mm256_set1_ps(1.0f), ggml_v_expf(_mm256_sub_ps(_mm256_setzero_ps(), t))));
+}
+
+#endif
+
+#endif // GGML_SIMD_EXPF
+
+// y = x*sigmoid(x*(a + b*x^2)), this is SiLU for a = 1, b = 0, Quick GELU for a = 1.702, b = 0 and
+// tanh GELU for a = 2*sqrt(2/pi), b = a*GELU_COEF_A, using 0.5*(1 + tanh(u)) = sigmoid(2*u)
+inline static void ggml_vec_sigmoid_mul_f32(const int n, float * y, const float * x, const float a, const float b) {
+    int i = 0;
+#if defined(GGML_SIMD_EXPF) && defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t va = vdupq_n_f32(a);
+    const float32x4_t vb = vdupq_n_f32(b);
+    for (; i + 3 < n; i += 4) {
+        const float32x4_t vx = vld1q_f32(x + i);
+        vst1q_f32(y + i, ggml_v_sigmoid_mul(vx, vmulq_f32(vx, vfmaq_f32(va, vb, vmulq_f32(vx, vx)))));
+    }
+#elif defined(GGML_SIMD_EXPF) && defined(__AVX512F__) && defined(__AVX512DQ__)
+    const __m512 va = _mm512_set1_ps(a);
+    const __m512 vb = _mm512_set1_ps(b);
+    for (; i + 15 < n; i += 16) {
+        const __m512 vx = _mm512_loadu_ps(x + i);
+        _mm512_storeu_ps(y + i, ggml_v_sigmoid_mul(vx, _mm512_mul_ps(vx, _mm512_fmadd_ps(vb, _mm512_mul_ps(vx, vx), va))));
+    }
+#elif defined(GGML_SIMD_EXPF)
+    const __m256 va = _mm256_set1_ps(a);
+    const __m256 vb = _mm256_set1_ps(b);
+    for (; i + 7 < n; i += 8) {
+        const __m256 vx = _mm256_loadu_ps(x + i);
+        _mm256_storeu_ps(y + i, ggml_v_sigmoid_mul(vx, _mm256_mul_ps(vx, _mm256_fmadd_ps(vb, _mm256_mul_ps(vx, vx), va))));
+    }
+#endif
+    for (; i < n; ++i) {
+        y[i] = x[i]/(1.0f + expf(-x[i]*(a + b*x[i]*x[i])));
+    }
+}
+
+// y = exp(x - max), returns the sum of y
+inline static ggml_float ggml_vec_soft_max_f32(const int n, float * y, const float * x, const float max) {
+    int i = 0;
+    ggml_float sum = 0.0;
+#if defined(GGML_SIMD_EXPF) && defined(__ARM_NEON) && defined(__aarch64__)
+    const float32x4_t vmax = vdupq_n_f32(max);
+    float32x4_t vsum = vdupq_n_f32(0.0f);
+    for (; i + 3 < n; i += 4) {
+        const float32x4_t val = ggml_v_expf(vsubq_f32(vld1q_f32(x + i), vmax));
+        vst1q_f32(y + i, val);
+        vsum = vaddq_f32(vsum, val);
+    }
+    sum = vaddvq_f32(vsum);
+#elif defined(GGML_SIMD_EXPF) && defined(__AVX512F__) && defined(__AVX512DQ__)
+    const __m512 vmax = _mm512_set1_ps(max);
+    __m512 vsum = _mm512_setzero_ps();
+    for (; i + 15 < n; i += 16) {
+        const __m512 val = ggml_v_expf(_mm512_sub_ps(_mm512_loadu_ps(x + i), vmax));
+        _mm512_storeu_ps(y + i, val);
+        vsum = _mm512_add_ps(vsum, val);
+    }
+    sum = _mm512_reduce_add_ps(vsum);
+#elif defined(GGML_SIMD_EXPF)
+    const __m256 vmax = _mm256_set1_ps(max);
+    __m256 vsum = _mm256_setzero_ps();
+    for (; i + 7 < n; i += 8) {
+        const __m256 val = ggml_v_expf(_mm256_sub_ps(_mm256_loadu_ps(x + i), vmax));
+        _mm256_storeu_ps(y + i, val);
+        vsum = _mm256_add_ps(vsum, val);
+    }
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(vsum), _mm256_extractf128_ps(vsum, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_movehdup_ps(s));
+    sum = _mm_cvtss_f32(s);
+#endif
+    for (; i < n; ++i) {
+        const float val = expf(x[i] - max);
+        sum += (ggml_float)val;
+        y[i] = val;
+    }
+    return sum;
+}
+
 inline static float ggml_gelu_f32(float x) {
     return 0.5f*x*(1.0f + tanhf(SQRT_2_OVER_PI*x*(1.0f + GELU_COEF_A*x*x)));
 }
 
+inline static float ggml_gelu_quick_f32(float x) {
+    return x*(1.0f/(1.0f+expf(GELU_QUICK_COEF*x)));
+}
+
+// Sigmoid Linear Unit (SiLU) function
+inline static float ggml_silu_f32(float x) {
+    return x/(1.0f + expf(-x));
+}
+
+inline static void ggml_critical_section_start(void);
+inline static void ggml_critical_section_end(void);
+
+static const ggml_fp16_t * ggml_table_f16_get(enum ggml_table_f16 table) {
+    if (!atomic_load(&ggml_table_f16_ready[table])) {
+        ggml_critical_section_start();
+
+        if (!atomic_load(&ggml_table_f16_ready[table])) {
+            const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
+
+            ggml_fp16_t * t = ggml_table_f16[table];
+            ggml_fp16_t ii;
+            for (int i = 0; i < (1 << 16); ++i) {
+                uint16_t ui = i;
+                memcpy(&ii, &ui, sizeof(ii));
+                const float f = GGML_COMPUTE_FP16_TO_FP32(ii);
+                switch (table) {
+                    case GGML_TABLE_GELU:       t[i] = GGML_FP32_TO_FP16(ggml_gelu_f32(f));       break;
+                    case GGML_TABLE_GELU_QUICK: t[i] = GGML_FP32_TO_FP16(ggml_gelu_quick_f32(f)); break;
+                    case GGML_TABLE_SILU:       t[i] = GGML_FP32_TO_FP16(ggml_silu_f32(f));       break;
+                    case GGML_TABLE_EXP:        t[i] = GGML_FP32_TO_FP16(expf(f));                break;
+                    default:                    GGML_ASSERT(false);
+                }
+            }
+
+            atomic_store(&ggml_table_f16_ready[table], 1);
+
+            const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
+
+            GGML_PRINT_DEBUG("%s: table %d initialized in %f ms\n", __func__, (int) table, (t_end - t_start)/1000.0f);
+        }
+
+        ggml_critical_section_end();
+    }
+
+    return ggml_table_f16[table];
+}
+
 inline static void ggml_vec_gelu_f16(const int n, ggml_fp16_t * y, const ggml_fp16_t * x) {
+    const ggml_fp16_t * table = ggml_table_f16_get(GGML_TABLE_GELU);
     const uint16_t * i16 = (const uint16_t *) x;
     for (int i = 0; i < n; ++i) {
-        y[i] = ggml_table_gelu_f16[i16[i]];
+        y[i] = table[i16[i]];
     }
 }
 
 #ifdef GGML_GELU_FP16
 inline static void ggml_vec_gelu_f32(const int n, float * y, const float * x) {
+    const ggml_fp16_t * table = ggml_table_f16_get(GGML_TABLE_GELU);
     uint16_t t;
     for (int i = 0; i < n; ++i) {
         ggml_fp16_t fp16 = GGML_FP32_TO_FP16(x[i]);
         memcpy(&t, &fp16, sizeof(uint16_t));
-        y[i] = GGML_FP16_TO_FP32(ggml_table_gelu_f16[t]);
+        y[i] = GGML_FP16_TO_FP32(table[t]);
     }
 }
 #else
 inline static void ggml_vec_gelu_f32(const int n, float * y, const float * x) {
-    for (int i = 0; i < n; ++i) {
-        y[i] = ggml_gelu_f32(x[i]);
-    }
+    ggml_vec_sigmoid_mul_f32(n, y, x, 2.0f*SQRT_2_OVER_PI, 2.0f*SQRT_2_OVER_PI*GELU_COEF_A);
 }
 #endif
 
-inline static float ggml_gelu_quick_f32(float x) {
-    return x*(1.0f/(1.0f+expf(GELU_QUICK_COEF*x)));
-}
-
 //inline static void ggml_vec_gelu_quick_f16(const int n, ggml_fp16_t * y, const ggml_fp16_t * x) {
 //    const uint16_t * i16 = (const uint16_t *) x;
 //    for (int i = 0; i < n; ++i) {
-//        y[i] = ggml_table_gelu_quick_f16[i16[i]];
+//        y[i] = ggml_table_f16_get(GGML_TABLE_GELU_QUICK)[i16[i]];
 //    }
 //}
 
 #ifdef GGML_GELU_QUICK_FP16
 inline static void ggml_vec_gelu_quick_f32(const int n, float * y, const float * x) {
+    const ggml_fp16_t * table = ggml_table_f16_get(GGML_TABLE_GELU_QUICK);
     uint16_t t;
     for (int i = 0; i < n; ++i) {
         ggml_fp16_t fp16 = GGML_FP32_TO_FP16(x[i]);
         memcpy(&t, &fp16, sizeof(uint16_t));
-        y[i] = GGML_FP16_TO_FP32(ggml_table_gelu_quick_f16[t]);
+        y[i] = GGML_FP16_TO_FP32(table[t]);
     }
 }
 #else
 inline static void ggml_vec_gelu_quick_f32(const int n, float * y, const float * x) {
-    for (int i = 0; i < n; ++i) {
-        y[i] = ggml_gelu_quick_f32(x[i]);
-    }
+    ggml_vec_sigmoid_mul_f32(n, y, x, -GELU_QUICK_COEF, 0.0f);
 }
 #endif
 
-// Sigmoid Linear Unit (SiLU) function
-inline static float ggml_silu_f32(float x) {
-    return x/(1.0f + expf(-x));
-}
-
 //inline static void ggml_vec_silu_f16(const int n, ggml_fp16_t * y, const ggml_fp16_t * x) {
 //    const uint16_t * i16 = (const uint16_t *) x;
 //    for (int i = 0; i < n; ++i) {
-//        y[i] = ggml_table_silu_f16[i16[i]];
+//        y[i] = ggml_table_f16_get(GGML_TABLE_SILU)[i16[i]];
 //    }
 //}
 
 #ifdef GGML_SILU_FP16
 inline static void ggml_vec_silu_f32(const int n, float * y, const float * x) {
+    const ggml_fp16_t * table = ggml_table_f16_get(GGML_TABLE_SILU);
     uint16_t t;
     for (int i = 0; i < n; ++i) {
         ggml_fp16_t fp16 = GGML_FP32_TO_FP16(x[i]);
         memcpy(&t, &fp16, sizeof(uint16_t));
-        y[i] = GGML_FP16_TO_FP32(ggml_table_silu_f16[t]);
+        y[i] = GGML_FP16_TO_FP32(table[t]);
     }
 }
 #else
 inline static void ggml_vec_silu_f32(const int n, float * y, const float * x) {
-    for (int i = 0; i < n; ++i) {
-        y[i] = ggml_silu_f32(x[i]);
-    }
+    ggml_vec_sigmoid_mul_f32(n, y, x, 1.0f, 0.0f);
 }
 #endif
 
@@ -1624,6 +1948,7 @@ static const char * GGML_OP_NAME[GGML_OP_COUNT] = {
     "POOL_2D",
     "UPSCALE",
     "ARGSORT",
+    "TOP_K",
 
     "FLASH_ATTN",
     "FLASH_FF",
@@ -1649,10 +1974,14 @@ static const char * GGML_OP_NAME[GGML_OP_COUNT] = {
     "CROSS_ENTROPY_LOSS",
     "CROSS_ENTROPY_LOSS_BACK",
 
-    "PAD_CIRCULAR"
+    "PAD_CIRCULAR",
+    "PAD_CIRCULAR_BACK",
+    "RFFT_2D",
+    "CONV_2D_CIRCULAR",
+    "FLASH_ATTN_EXT",
 };
 
-static_assert(GGML_OP_COUNT == 71, "GGML_OP_COUNT != 71");
+static_assert(GGML_OP_COUNT == 76, "GGML_OP_COUNT != 76");
 
 static const char * GGML_OP_SYMBOL[GGML_OP_COUNT] = {
     "none",
@@ -1710,6 +2039,7 @@ static const char * GGML_OP_SYMBOL[GGML_OP_COUNT] = {
     "pool_2d(x)",
     "upscale(x)",
     "argsort(x)",
+    "top_k(x)",
 
     "flash_attn(x)",
     "flash_ff(x)",
@@ -1735,10 +2065,14 @@ static const char * GGML_OP_SYMBOL[GGML_OP_COUNT] = {
     "cross_entropy_loss(x,y)",
     "cross_entropy_loss_back(x,y)",
 
-    "pad_circular(x)"
+    "pad_circular(x)",
+    "pad_circular_back(x)",
+    "rfft_2d(x)",
+    "conv_2d_circular(x)",
+    "flash_attn_ext(x)",
 };
 
-static_assert(GGML_OP_COUNT == 71, "GGML_OP_COUNT != 71");
+static_assert(GGML_OP_COUNT == 76, "GGML_OP_COUNT != 76");
 
 static_assert(GGML_OP_POOL_COUNT == 2, "GGML_OP_POOL_COUNT != 2");
 
@@ -1778,8 +2112,6 @@ static void ggml_setup_op_has_task_pass(void) {
         bool * p = GGML_OP_HAS_INIT;
 
         p[GGML_OP_ACC                    ] = true;
-        p[GGML_OP_MUL_MAT                ] = true;
-        p[GGML_OP_MUL_MAT_ID             ] = true;
         p[GGML_OP_OUT_PROD               ] = true;
         p[GGML_OP_SET                    ] = true;
         p[GGML_OP_GET_ROWS_BACK          ] = true;
@@ -1943,6 +2275,128 @@ bool ggml_is_numa(void) {
     return g_state.numa.n_nodes > 1;
 }
 
+// the threads of a graph are split in groups of consecutive threads, one per NUMA node, as evenly as possible
+// so that every node has threads when there are enough of them, see set_numa_thread_affinity
+static int ggml_numa_node_of_thread(int ith, int nth) {
+    return (int) ((int64_t) ith*g_state.numa.n_nodes/nth);
+}
+
+#if defined(__linux__) && defined(SYS_mbind)
+// from linux/mempolicy.h
+#define GGML_MPOL_PREFERRED  1
+#define GGML_MPOL_INTERLEAVE 3
+#define GGML_MPOL_MF_MOVE    (1 << 1)
+
+// sets the memory policy of the pages in [begin, end), moving the pages that are already in memory
+static void ggml_numa_mbind(uintptr_t begin, uintptr_t end, int mode, unsigned long nodemask) {
+    const uintptr_t page_size = (uintptr_t) sysconf(_SC_PAGESIZE);
+
+    begin &= ~(page_size - 1);
+    end    = (end + page_size - 1) & ~(page_size - 1);
+
+    if (begin >= end) {
+        return;
+    }
+
+    if (syscall(SYS_mbind, (void *) begin, end - begin, mode, &nodemask, GGML_NUMA_MAX_NODES + 1, GGML_MPOL_MF_MOVE) != 0) {
+        GGML_PRINT_DEBUG("%s: mbind failed: %s\n", __func__, strerror(errno));
+    }
+}
+
+void ggml_numa_interleave(void * data, size_t size) {
+    if (!ggml_is_numa()) {
+        return;
+    }
+
+    ggml_numa_mbind((uintptr_t) data, (uintptr_t) data + size, GGML_MPOL_INTERLEAVE, (1ul << g_state.numa.n_nodes) - 1);
+}
+
+void ggml_numa_distribute_tensor(const struct ggml_tensor * tensor) {
+    if (!ggml_is_numa() || tensor->data == NULL || !ggml_is_contiguous(tensor)) {
+        return;
+    }
+
+    const int     n_nodes = g_state.numa.n_nodes;
+    const int64_t nr      = tensor->ne[1];
+    const int64_t rr      = tensor->flags & GGML_TENSOR_FLAG_REPACKED ? GGML_REPACK_ROWS : 1;
+
+    // the same row blocks as in ggml_compute_forward_mul_mat, for every matrix of the tensor
+    for (int64_t i3 = 0; i3 < tensor->ne[3]; ++i3) {
+        for (int64_t i2 = 0; i2 < tensor->ne[2]; ++i2) {
+            const uintptr_t base = (uintptr_t) tensor->data + i2*tensor->nb[2] + i3*tensor->nb[3];
+
+            for (int n = 0; n < n_nodes; ++n) {
+                const uintptr_t begin = base + ((nr/rr)*n/n_nodes*rr)*tensor->nb[1];
+                const uintptr_t end   = base + ((nr/rr)*(n + 1)/n_nodes*rr)*tensor->nb[1];
+
+                ggml_numa_mbind(begin, end, GGML_MPOL_PREFERRED, 1ul << n);
+            }
+        }
+    }
+}
+#else
+void ggml_numa_interleave(void * data, size_t size) {
+    UNUSED(data);
+    UNUSED(size);
+}
+
+void ggml_numa_distribute_tensor(const struct ggml_tensor * tensor) {
+    UNUSED(tensor);
+}
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool ggml_can_repack(const struct ggml_tensor * tensor) {
+    return type_traits[tensor->type].vec_dot_x4 != NULL &&
+        ggml_is_contiguous(tensor) &&
+        tensor->view_src == NULL &&
+        tensor->ne[1] % GGML_REPACK_ROWS == 0;
+}
+
+// block ib of row r of each group of GGML_REPACK_ROWS rows is stored at block ib*GGML_REPACK_ROWS + r of the group
+void ggml_repack(struct ggml_tensor * tensor, const void * data) {
+    GGML_ASSERT(ggml_can_repack(tensor));
+    GGML_ASSERT(tensor->data != data);
+
+    const size_t  bs  = ggml_type_size(tensor->type);
+    const int64_t nbr = tensor->ne[0]/ggml_blck_size(tensor->type); // blocks per row
+    const int64_t nr  = ggml_nrows(tensor);
+
+    for (int64_t ir = 0; ir < nr; ir += GGML_REPACK_ROWS) {
+        const char * src = (const char *) data         + ir*nbr*bs;
+              char * dst = (char *)       tensor->data + ir*nbr*bs;
+
+        for (int64_t ib = 0; ib < nbr; ++ib) {
+            for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+                memcpy(dst + (ib*GGML_REPACK_ROWS + r)*bs, src + (r*nbr + ib)*bs, bs);
+            }
+        }
+    }
+
+    tensor->flags |= GGML_TENSOR_FLAG_REPACKED;
+}
+
+void ggml_unpack(const struct ggml_tensor * tensor, void * data) {
+    GGML_ASSERT(tensor->flags & GGML_TENSOR_FLAG_REPACKED);
+    GGML_ASSERT(tensor->data != data);
+
+    const size_t  bs  = ggml_type_size(tensor->type);
+    const int64_t nbr = tensor->ne[0]/ggml_blck_size(tensor->type);
+    const int64_t nr  = ggml_nrows(tensor);
+
+    for (int64_t ir = 0; ir < nr; ir += GGML_REPACK_ROWS) {
+        const char * src = (const char *) tensor->data + ir*nbr*bs;
+              char * dst = (char *)       data         + ir*nbr*bs;
+
+        for (int64_t ib = 0; ib < nbr; ++ib) {
+            for (int r = 0; r < GGML_REPACK_ROWS; ++r) {
+                memcpy(dst + (r*nbr + ib)*bs, src + (ib*GGML_REPACK_ROWS + r)*bs, bs);
+            }
+        }
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 
 void ggml_print_object(const struct ggml_object * obj) {
@@ -1976,6 +2430,11 @@ int64_t ggml_nrows(const struct ggml_tensor * tensor) {
 }
 
 size_t ggml_nbytes(const struct ggml_tensor * tensor) {
+    // a wrapped view has no data of its own, it spans exactly the tensor it wraps
+    if (tensor->flags & GGML_TENSOR_FLAG_WRAPPED) {
+        return ggml_nbytes(tensor->view_src);
+    }
+
     size_t nbytes;
     size_t blck_size = ggml_blck_size(tensor->type);
     if (blck_size == 1) {
@@ -2208,7 +2667,10 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
         // initialize time system (required on Windows)
         ggml_time_init();
 
-        // initialize GELU, Quick GELU, SILU and EXP F32 tables
+        // initialize the F16 -> F32 table, only needed where the conversion is not done in hardware
+        // (the CPU dispatch variants of ggml-quants.c may use it even if this file does not)
+        // the GELU, Quick GELU, SILU and EXP tables are built on first use
+#if defined(GGML_FP16_TO_FP32_TABLE) || defined(GGML_CPU_DISPATCH)
         {
             const uint64_t t_start = ggml_time_us(); UNUSED(t_start);
 
@@ -2216,17 +2678,14 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
             for (int i = 0; i < (1 << 16); ++i) {
                 uint16_t ui = i;
                 memcpy(&ii, &ui, sizeof(ii));
-                const float f = ggml_table_f32_f16[i] = GGML_COMPUTE_FP16_TO_FP32(ii);
-                ggml_table_gelu_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_f32(f));
-                ggml_table_gelu_quick_f16[i] = GGML_FP32_TO_FP16(ggml_gelu_quick_f32(f));
-                ggml_table_silu_f16[i] = GGML_FP32_TO_FP16(ggml_silu_f32(f));
-                ggml_table_exp_f16[i]  = GGML_FP32_TO_FP16(expf(f));
+                ggml_table_f32_f16[i] = GGML_COMPUTE_FP16_TO_FP32(ii);
             }
 
             const uint64_t t_end = ggml_time_us(); UNUSED(t_end);
 
-            GGML_PRINT_DEBUG("%s: GELU, Quick GELU, SILU and EXP tables initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
+            GGML_PRINT_DEBUG("%s: F16 table initialized in %f ms\n", __func__, (t_end - t_start)/1000.0f);
         }
+#endif
 
         // initialize g_state
         {
@@ -2255,6 +2714,8 @@ struct ggml_context * ggml_init(struct ggml_init_params params) {
         ggml_cl_init();
 #endif
 
+        ggml_cpu_dispatch_init();
+
         ggml_setup_op_has_task_pass();
 
         is_first_call = false;
@@ -2533,6 +2994,7 @@ static struct ggml_tensor * ggml_new_tensor_impl(
         /*.data         =*/ obj_alloc_size > 0 ? (void *)(result + 1) : data,
         /*.name         =*/ { 0 },
         /*.extra        =*/ NULL,
+        /*.flags        =*/ 0,
         /*.padding      =*/ { 0 },
     };
 
@@ -2752,6 +3214,25 @@ struct ggml_tensor * ggml_set_f32(struct ggml_tensor * tensor, float value) {
     return tensor;
 }
 
+// maps i into [0, n) periodically
+static inline int64_t ggml_wrap_index(int64_t i, int64_t n) {
+    const int64_t r = i % n;
+    return r < 0 ? r + n : r;
+}
+
+// address of element (i0, i1, i2, i3) of a ggml_pad_circular_view, resolved in the tensor it wraps
+static inline const char * ggml_wrapped_view_elem(
+        const struct ggml_tensor * t, int64_t i0, int64_t i1, int64_t i2, int64_t i3) {
+    const struct ggml_tensor * src  = t->src[0];
+    const int32_t            * pads = (const int32_t *) t->op_params;
+
+    return (const char *) src->data
+        + ggml_wrap_index(i0 - pads[0], src->ne[0])*src->nb[0]
+        + ggml_wrap_index(i1 - pads[2], src->ne[1])*src->nb[1]
+        + ggml_wrap_index(i2 - pads[4], src->ne[2])*src->nb[2]
+        + ggml_wrap_index(i3 - pads[6], src->ne[3])*src->nb[3];
+}
+
 void ggml_unravel_index(const struct ggml_tensor * tensor, int64_t i, int64_t * i0, int64_t * i1, int64_t * i2, int64_t * i3) {
     const int64_t ne2 = tensor->ne[2];
     const int64_t ne1 = tensor->ne[1];
@@ -2777,7 +3258,7 @@ void ggml_unravel_index(const struct ggml_tensor * tensor, int64_t i, int64_t *
 }
 
 int32_t ggml_get_i32_1d(const struct ggml_tensor * tensor, int i) {
-    if (!ggml_is_contiguous(tensor)) {
+    if (!ggml_is_contiguous(tensor) || ggml_is_wrapped_view(tensor)) {
         int64_t id[4] = { 0, 0, 0, 0 };
         ggml_unravel_index(tensor, i, &id[0], &id[1], &id[2], &id[3]);
         return ggml_get_i32_nd(tensor, id[0], id[1], id[2], id[3]);
@@ -2818,6 +3299,7 @@ int32_t ggml_get_i32_1d(const struct ggml_tensor * tensor, int i) {
 }
 
 void ggml_set_i32_1d(const struct ggml_tensor * tensor, int i, int32_t value) {
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view cannot be written");
     if (!ggml_is_contiguous(tensor)) {
         int64_t id[4] = { 0, 0, 0, 0 };
         ggml_unravel_index(tensor, i, &id[0], &id[1], &id[2], &id[3]);
@@ -2858,18 +3340,20 @@ void ggml_set_i32_1d(const struct ggml_tensor * tensor, int i, int32_t value) {
 }
 
 int32_t ggml_get_i32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2, int i3) {
-    void * data   = (char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3];
+    const void * data = ggml_is_wrapped_view(tensor)
+        ? (const void *) ggml_wrapped_view_elem(tensor, i0, i1, i2, i3)
+        : (const void *) ((char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3]);
     switch (tensor->type) {
         case GGML_TYPE_I8:
-            return ((int8_t *) data)[0];
+            return ((const int8_t *) data)[0];
         case GGML_TYPE_I16:
-            return ((int16_t *) data)[0];
+            return ((const int16_t *) data)[0];
         case GGML_TYPE_I32:
-            return ((int32_t *) data)[0];
+            return ((const int32_t *) data)[0];
         case GGML_TYPE_F16:
-            return GGML_FP16_TO_FP32(((ggml_fp16_t *) data)[0]);
+            return GGML_FP16_TO_FP32(((const ggml_fp16_t *) data)[0]);
         case GGML_TYPE_F32:
-            return ((float *) data)[0];
+            return ((const float *) data)[0];
         default:
             GGML_ASSERT(false);
     }
@@ -2878,6 +3362,7 @@ int32_t ggml_get_i32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i
 }
 
 void ggml_set_i32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2, int i3, int32_t value) {
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view cannot be written");
     void * data   = (char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3];
     switch (tensor->type) {
         case GGML_TYPE_I8:
@@ -2908,7 +3393,7 @@ void ggml_set_i32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2,
 }
 
 float ggml_get_f32_1d(const struct ggml_tensor * tensor, int i) {
-    if (!ggml_is_contiguous(tensor)) {
+    if (!ggml_is_contiguous(tensor) || ggml_is_wrapped_view(tensor)) {
         int64_t id[4] = { 0, 0, 0, 0 };
         ggml_unravel_index(tensor, i, &id[0], &id[1], &id[2], &id[3]);
         return ggml_get_f32_nd(tensor, id[0], id[1], id[2], id[3]);
@@ -2949,6 +3434,7 @@ float ggml_get_f32_1d(const struct ggml_tensor * tensor, int i) {
 }
 
 void ggml_set_f32_1d(const struct ggml_tensor * tensor, int i, float value) {
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view cannot be written");
     if (!ggml_is_contiguous(tensor)) {
         int64_t id[4] = { 0, 0, 0, 0 };
         ggml_unravel_index(tensor, i, &id[0], &id[1], &id[2], &id[3]);
@@ -2989,18 +3475,20 @@ void ggml_set_f32_1d(const struct ggml_tensor * tensor, int i, float value) {
 }
 
 float ggml_get_f32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2, int i3) {
-    void * data   = (char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3];
+    const void * data = ggml_is_wrapped_view(tensor)
+        ? (const void *) ggml_wrapped_view_elem(tensor, i0, i1, i2, i3)
+        : (const void *) ((char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3]);
     switch (tensor->type) {
         case GGML_TYPE_I8:
-            return ((int8_t *) data)[0];
+            return ((const int8_t *) data)[0];
         case GGML_TYPE_I16:
-            return ((int16_t *) data)[0];
+            return ((const int16_t *) data)[0];
         case GGML_TYPE_I32:
-            return ((int32_t *) data)[0];
+            return ((const int32_t *) data)[0];
         case GGML_TYPE_F16:
-            return GGML_FP16_TO_FP32(((ggml_fp16_t *) data)[0]);
+            return GGML_FP16_TO_FP32(((const ggml_fp16_t *) data)[0]);
         case GGML_TYPE_F32:
-            return ((float *) data)[0];
+            return ((const float *) data)[0];
         default:
             GGML_ASSERT(false);
     }
@@ -3009,6 +3497,7 @@ float ggml_get_f32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2,
 }
 
 void ggml_set_f32_nd(const struct ggml_tensor * tensor, int i0, int i1, int i2, int i3, float value) {
+    GGML_ASSERT(!ggml_is_wrapped_view(tensor) && "a wrapped view cannot be written");
     void * data   = (char *) tensor->data + i0*tensor->nb[0] + i1*tensor->nb[1] + i2*tensor->nb[2] + i3*tensor->nb[3];
     switch (tensor->type) {
         case GGML_TYPE_I8:
@@ -4888,18 +5377,39 @@ struct ggml_tensor * ggml_diag_mask_zero_inplace(
 static struct ggml_tensor * ggml_soft_max_impl(
         struct ggml_context * ctx,
         struct ggml_tensor  * a,
+        struct ggml_tensor  * mask,
+        float                 scale,
+        float                 max_bias,
         bool                  inplace) {
+    GGML_ASSERT(ggml_is_contiguous(a));
+
+    if (mask) {
+        GGML_ASSERT(mask->type == GGML_TYPE_F32);
+        GGML_ASSERT(ggml_is_contiguous(mask));
+        GGML_ASSERT(mask->ne[0] == a->ne[0]);
+        GGML_ASSERT(mask->ne[1] >= a->ne[1]);
+        GGML_ASSERT(mask->ne[2] == 1 && mask->ne[3] == 1);
+    }
+
     bool is_node = false;
 
     if (a->grad) {
         is_node = true;
     }
 
+    if (mask && mask->grad) {
+        GGML_ASSERT(false); // TODO: implement backward for the mask
+    }
+
     struct ggml_tensor * result = inplace ? ggml_view_tensor(ctx, a) : ggml_dup_tensor(ctx, a);
 
+    float params[] = { scale, max_bias };
+    ggml_set_op_params(result, params, sizeof(params));
+
     result->op   = GGML_OP_SOFT_MAX;
     result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
     result->src[0] = a;
+    result->src[1] = mask;
 
     return result;
 }
@@ -4907,13 +5417,22 @@ static struct ggml_tensor * ggml_soft_max_impl(
 struct ggml_tensor * ggml_soft_max(
         struct ggml_context * ctx,
         struct ggml_tensor  * a) {
-    return ggml_soft_max_impl(ctx, a, false);
+    return ggml_soft_max_impl(ctx, a, NULL, 1.0f, 0.0f, false);
 }
 
 struct ggml_tensor * ggml_soft_max_inplace(
         struct ggml_context * ctx,
         struct ggml_tensor  * a) {
-    return ggml_soft_max_impl(ctx, a, true);
+    return ggml_soft_max_impl(ctx, a, NULL, 1.0f, 0.0f, true);
+}
+
+struct ggml_tensor * ggml_soft_max_ext(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * mask,
+        float                 scale,
+        float                 max_bias) {
+    return ggml_soft_max_impl(ctx, a, mask, scale, max_bias, false);
 }
 
 // ggml_soft_max_back
@@ -5199,7 +5718,18 @@ GGML_API struct ggml_tensor * ggml_conv_1d(
         int                   s0,
         int                   p0,
         int                   d0) {
-    struct ggml_tensor * im2col = ggml_im2col(ctx, a, b, s0, 0, p0, 0, d0, 0, false); // [N, OL, IC * K]
+    return ggml_conv_1d_ext(ctx, a, b, s0, p0, d0, GGML_PAD_MODE_ZERO);
+}
+
+struct ggml_tensor * ggml_conv_1d_ext(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b,
+        int                   s0,
+        int                   p0,
+        int                   d0,
+        enum ggml_pad_mode    pad_mode) {
+    struct ggml_tensor * im2col = ggml_im2col_ext(ctx, a, b, s0, 0, p0, 0, d0, 0, false, pad_mode); // [N, OL, IC * K]
 
     struct ggml_tensor * result =
         ggml_mul_mat(ctx,
@@ -5283,6 +5813,21 @@ struct ggml_tensor * ggml_im2col(
     int                  d0,
     int                  d1,
     bool                 is_2D) {
+    return ggml_im2col_ext(ctx, a, b, s0, s1, p0, p1, d0, d1, is_2D, GGML_PAD_MODE_ZERO);
+}
+
+struct ggml_tensor * ggml_im2col_ext(
+    struct ggml_context * ctx,
+    struct ggml_tensor  * a,
+    struct ggml_tensor  * b,
+    int                  s0,
+    int                  s1,
+    int                  p0,
+    int                  p1,
+    int                  d0,
+    int                  d1,
+    bool                 is_2D,
+    enum ggml_pad_mode   pad_mode) {
 
     if(is_2D) {
         GGML_ASSERT(a->ne[2] == b->ne[2]);
@@ -5307,7 +5852,7 @@ struct ggml_tensor * ggml_im2col(
     };
 
     struct ggml_tensor * result = ggml_new_tensor(ctx, GGML_TYPE_F16, 4, ne);
-    int32_t params[] = { s0, s1, p0, p1, d0, d1, (is_2D ? 1 : 0) };
+    int32_t params[] = { s0, s1, p0, p1, d0, d1, (is_2D ? 1 : 0), pad_mode };
     ggml_set_op_params(result, params, sizeof(params));
 
     result->op = GGML_OP_IM2COL;
@@ -5331,14 +5876,105 @@ struct ggml_tensor * ggml_conv_2d(
         int                  p1,
         int                  d0,
         int                  d1) {
-    struct ggml_tensor * im2col = ggml_im2col(ctx, a, b, s0, s1, p0, p1, d0, d1, true); // [N, OH, OW, IC * KH * KW]
+    return ggml_conv_2d_ext(ctx, a, b, s0, s1, p0, p1, d0, d1, GGML_PAD_MODE_ZERO);
+}
+
+struct ggml_tensor * ggml_conv_2d_ext(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b,
+        int                  s0,
+        int                  s1,
+        int                  p0,
+        int                  p1,
+        int                  d0,
+        int                  d1,
+        enum ggml_pad_mode   pad_mode) {
+    struct ggml_tensor * im2col = ggml_im2col_ext(ctx, a, b, s0, s1, p0, p1, d0, d1, true, pad_mode); // [N, OH, OW, IC * KH * KW]
 
     struct ggml_tensor * result =
         ggml_mul_mat(ctx,
                 ggml_reshape_2d(ctx, im2col, im2col->ne[0],  im2col->ne[3] * im2col->ne[2] * im2col->ne[1]), // [N, OH, OW, IC * KH * KW] => [N*OH*OW, IC * KH * KW]
                 ggml_reshape_2d(ctx, a, (a->ne[0] * a->ne[1] * a->ne[2]),  a->ne[3]));                       // [OC，IC, KH, KW] => [OC, IC * KH * KW]
 
-    result = ggml_reshape_4d(ctx, result, im2col->ne[1], im2col->ne[2], a->ne[3], im2col->ne[3]); // [N, OC, OH, OW]
+    if (im2col->ne[3] == 1) {
+        result = ggml_reshape_4d(ctx, result, im2col->ne[1], im2col->ne[2], a->ne[3], 1); // [1, OC, OH, OW]
+    } else {
+        // the rows of the mul_mat result are ordered [OC, N, OH, OW]
+        result = ggml_reshape_4d(ctx, result, im2col->ne[1], im2col->ne[2], im2col->ne[3], a->ne[3]); // [OC, N, OH, OW]
+        result = ggml_cont(ctx, ggml_permute(ctx, result, 0, 1, 3, 2)); // [N, OC, OH, OW]
+    }
+
+    return result;
+}
+
+// ggml_conv_2d_circular
+
+// kernels with at least this many taps are convolved in the frequency domain
+#define GGML_CONV_2D_CIRCULAR_FFT_MIN_KERNEL 49
+
+// real 2D FFT of every [ne1, ne0] plane of a, after wrapping it into a periodic W x H grid shifted by (s0, s1)
+// result: [H, 2*(W/2 + 1)] interleaved complex values per plane
+static struct ggml_tensor * ggml_rfft_2d_impl(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        int                   W,
+        int                   H,
+        int                   s0,
+        int                   s1) {
+    struct ggml_tensor * result = ggml_new_tensor_4d(ctx, GGML_TYPE_F32, 2*(W/2 + 1), H, a->ne[2], a->ne[3]);
+
+    int32_t params[] = { W, s0, s1 };
+    ggml_set_op_params(result, params, sizeof(params));
+
+    result->op   = GGML_OP_RFFT_2D;
+    result->grad = NULL;
+    result->src[0] = a;
+
+    return result;
+}
+
+struct ggml_tensor * ggml_conv_2d_circular(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b,
+        int                   p0,
+        int                   p1) {
+    GGML_ASSERT(a->ne[2] == b->ne[2]);
+
+    if (a->ne[0]*a->ne[1] < GGML_CONV_2D_CIRCULAR_FFT_MIN_KERNEL) {
+        return ggml_conv_2d_ext(ctx, a, b, 1, 1, p0, p1, 1, 1, GGML_PAD_MODE_CIRCULAR);
+    }
+
+    bool is_node = false;
+
+    if (a->grad || b->grad) {
+        GGML_ASSERT(false); // TODO: implement backward
+        is_node = true;
+    }
+
+    const int W = b->ne[0];
+    const int H = b->ne[1];
+
+    // y[o] = sum_k x[o + k - p] * w[k]: the kernel is placed at -p in the periodic grid
+    struct ggml_tensor * af = ggml_rfft_2d_impl(ctx, a, W, H, -p0, -p1); // [OC, IC, H, 2*(W/2 + 1)]
+    struct ggml_tensor * bf = ggml_rfft_2d_impl(ctx, b, W, H, 0, 0);     // [N,  IC, H, 2*(W/2 + 1)]
+
+    const int64_t ne[4] = {
+        ggml_calc_conv_output_size(b->ne[0], a->ne[0], 1, p0, 1),
+        ggml_calc_conv_output_size(b->ne[1], a->ne[1], 1, p1, 1),
+        a->ne[3], b->ne[3],
+    };
+
+    struct ggml_tensor * result = ggml_new_tensor(ctx, GGML_TYPE_F32, 4, ne);
+
+    int32_t params[] = { W, p0, p1 };
+    ggml_set_op_params(result, params, sizeof(params));
+
+    result->op   = GGML_OP_CONV_2D_CIRCULAR;
+    result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
+    result->src[0] = af;
+    result->src[1] = bf;
 
     return result;
 }
@@ -5533,14 +6169,17 @@ struct ggml_tensor * ggml_top_k(
         struct ggml_context * ctx,
         struct ggml_tensor  * a,
         int                   k) {
-    GGML_ASSERT(a->ne[0] >= k);
+    GGML_ASSERT(k > 0 && a->ne[0] >= k);
+
+    bool is_node = false;
+
+    struct ggml_tensor * result = ggml_new_tensor_4d(ctx, GGML_TYPE_I32, k, a->ne[1], a->ne[2], a->ne[3]);
 
-    struct ggml_tensor * result = ggml_argsort(ctx, a, GGML_SORT_DESC);
+    ggml_set_op_params_i32(result, 0, k);
 
-    result = ggml_view_4d(ctx, result,
-                k, result->ne[1], result->ne[2], result->ne[3],
-                   result->nb[1], result->nb[2], result->nb[3],
-                0);
+    result->op   = GGML_OP_TOP_K;
+    result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
+    result->src[0] = a;
 
     return result;
 }
@@ -5577,9 +6216,58 @@ struct ggml_tensor * ggml_flash_attn(
     return result;
 }
 
-// ggml_flash_ff
+// ggml_flash_attn_ext
 
-struct ggml_tensor * ggml_flash_ff(
+struct ggml_tensor * ggml_flash_attn_ext(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * q,
+        struct ggml_tensor  * k,
+        struct ggml_tensor  * v,
+        struct ggml_tensor  * mask,
+        float                 scale,
+        float                 max_bias) {
+    GGML_ASSERT(q->type == GGML_TYPE_F32);
+    GGML_ASSERT(k->type == GGML_TYPE_F32 || k->type == GGML_TYPE_F16);
+    GGML_ASSERT(v->type == GGML_TYPE_F32 || v->type == GGML_TYPE_F16);
+    GGML_ASSERT(q->ne[0] == k->ne[0]);
+    GGML_ASSERT(k->ne[1] == v->ne[1]);
+    GGML_ASSERT(k->ne[2] == v->ne[2] && k->ne[3] == v->ne[3]);
+    GGML_ASSERT(q->ne[2] % k->ne[2] == 0 && q->ne[3] % k->ne[3] == 0);
+
+    if (mask) {
+        GGML_ASSERT(mask->type == GGML_TYPE_F32);
+        GGML_ASSERT(mask->ne[0] == k->ne[1]);
+        GGML_ASSERT(mask->ne[1] >= q->ne[1]);
+        GGML_ASSERT(mask->ne[2] == 1 && mask->ne[3] == 1);
+    }
+
+    bool is_node = false;
+
+    if (q->grad || k->grad || v->grad) {
+        GGML_ASSERT(false); // TODO: implement backward
+        is_node = true;
+    }
+
+    // heads of a token next to each other: [n_embd_v, n_tokens] after a reshape
+    const int64_t ne[4] = { v->ne[0], q->ne[2], q->ne[1], q->ne[3] };
+    struct ggml_tensor * result = ggml_new_tensor(ctx, GGML_TYPE_F32, 4, ne);
+
+    float params[] = { scale, max_bias };
+    ggml_set_op_params(result, params, sizeof(params));
+
+    result->op   = GGML_OP_FLASH_ATTN_EXT;
+    result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
+    result->src[0] = q;
+    result->src[1] = k;
+    result->src[2] = v;
+    result->src[3] = mask;
+
+    return result;
+}
+
+// ggml_flash_ff
+
+struct ggml_tensor * ggml_flash_ff(
         struct ggml_context * ctx,
         struct ggml_tensor  * a,
         struct ggml_tensor  * b0,
@@ -6307,43 +6995,148 @@ struct ggml_tensor * ggml_cross_entropy_loss_back(
     return result;
 }
 
-//GGML_PAD_CIRCULAR
+// ggml_pad_circular
 
 static struct ggml_tensor * ggml_pad_circular_impl(
-    struct ggml_context * ctx,
-    struct ggml_tensor * a,
-    int padding) {
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        const int32_t       * pads,
+        bool                  lazy) {
     bool is_node = false;
 
     if (a->grad) {
-        GGML_ASSERT(false);
         is_node = true;
     }
 
-    int new_height = a->ne[0] + 2 * padding;
-    int new_width = a->ne[1] + 2 * padding;
+    for (int i = 0; i < 8; ++i) {
+        GGML_ASSERT(pads[i] >= 0);
+    }
 
-    struct ggml_tensor * result = ggml_new_tensor_4d(ctx, a->type,
-            new_height,
-            new_width,
-            a->ne[2], a->ne[3]);
+    // quantized rows are wrapped as whole blocks without dequantization
+    GGML_ASSERT(pads[0] % ggml_blck_size(a->type) == 0);
+    GGML_ASSERT(pads[1] % ggml_blck_size(a->type) == 0);
+
+    const int64_t ne[4] = {
+        a->ne[0] + pads[0] + pads[1],
+        a->ne[1] + pads[2] + pads[3],
+        a->ne[2] + pads[4] + pads[5],
+        a->ne[3] + pads[6] + pads[7],
+    };
+
+    struct ggml_tensor * result;
+
+    if (lazy) {
+        // a view of a with the padded shape and contiguous strides, it has no data of its own:
+        // it is created with a single block so that it fits in a and then reshaped
+        const int64_t ne_blck[4] = { ggml_blck_size(a->type), 1, 1, 1 };
+        result = ggml_new_tensor_impl(ctx, a->type, 4, ne_blck, a, 0);
+        ggml_format_name(result, "%s (wrapped)", a->name);
+
+        result->flags |= GGML_TENSOR_FLAG_WRAPPED;
+
+        result->nb[0] = ggml_type_size(a->type);
+        result->nb[1] = result->nb[0]*(ne[0]/ggml_blck_size(a->type));
+        for (int i = 0; i < GGML_MAX_DIMS; ++i) {
+            result->ne[i] = ne[i];
+            if (i > 1) {
+                result->nb[i] = result->nb[i - 1]*ne[i - 1];
+            }
+        }
+    } else {
+        result = ggml_new_tensor(ctx, a->type, 4, ne);
+    }
+
+    ggml_set_op_params(result, pads, 8*sizeof(int32_t));
+    ggml_set_op_params_i32(result, 8, lazy ? 1 : 0);
 
     result->op = GGML_OP_PAD_CIRCULAR;
-    result->op_params[0] = padding;
     result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
     result->src[0] = a;
-    result->src[1] = NULL;
 
     return result;
 }
 
 struct ggml_tensor * ggml_pad_circular(
-    struct ggml_context * ctx,
-    struct ggml_tensor * a,
-    int padding) {
-    return ggml_pad_circular_impl(ctx, a, padding);
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        int                   padding) {
+    const int32_t pads[8] = { padding, padding, padding, padding, 0, 0, 0, 0 };
+    return ggml_pad_circular_impl(ctx, a, pads, false);
+}
+
+struct ggml_tensor * ggml_pad_circular_ext(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        int                   lp0,
+        int                   rp0,
+        int                   lp1,
+        int                   rp1,
+        int                   lp2,
+        int                   rp2,
+        int                   lp3,
+        int                   rp3) {
+    const int32_t pads[8] = { lp0, rp0, lp1, rp1, lp2, rp2, lp3, rp3 };
+    return ggml_pad_circular_impl(ctx, a, pads, false);
+}
+
+struct ggml_tensor * ggml_pad_circular_view(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        int                   lp0,
+        int                   rp0,
+        int                   lp1,
+        int                   rp1,
+        int                   lp2,
+        int                   rp2,
+        int                   lp3,
+        int                   rp3) {
+    const int32_t pads[8] = { lp0, rp0, lp1, rp1, lp2, rp2, lp3, rp3 };
+    return ggml_pad_circular_impl(ctx, a, pads, true);
 }
 
+bool ggml_is_wrapped_view(const struct ggml_tensor * t) {
+    return (t->flags & GGML_TENSOR_FLAG_WRAPPED) != 0;
+}
+
+// ggml_pad_circular_back
+
+struct ggml_tensor * ggml_pad_circular_back(
+        struct ggml_context * ctx,
+        struct ggml_tensor  * a,
+        struct ggml_tensor  * b,
+        int                   lp0,
+        int                   lp1,
+        int                   lp2,
+        int                   lp3) {
+    GGML_ASSERT(a->type == GGML_TYPE_F32);
+
+    const int32_t lp[4] = { lp0, lp1, lp2, lp3 };
+
+    int32_t pads[8];
+    for (int i = 0; i < 4; ++i) {
+        GGML_ASSERT(lp[i] >= 0 && a->ne[i] >= b->ne[i] + lp[i]);
+        pads[2*i + 0] = lp[i];
+        pads[2*i + 1] = a->ne[i] - b->ne[i] - lp[i];
+    }
+
+    bool is_node = false;
+
+    if (a->grad) {
+        GGML_ASSERT(false); // TODO: implement backward
+        is_node = true;
+    }
+
+    struct ggml_tensor * result = ggml_new_tensor(ctx, GGML_TYPE_F32, 4, b->ne);
+
+    ggml_set_op_params(result, pads, sizeof(pads));
+
+    result->op   = GGML_OP_PAD_CIRCULAR_BACK;
+    result->grad = is_node ? ggml_dup_tensor(ctx, result) : NULL;
+    result->src[0] = a;
+    result->src[1] = b;
+
+    return result;
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -6357,6 +7150,40 @@ void ggml_set_param(
     ggml_format_name(tensor->grad, "%s (grad)", tensor->name);
 }
 
+// the params the graph scheduler hands to the ops: the public ggml_compute_params followed by the
+// scheduler state of the node, which stays out of the API, see ggml_compute_params_barrier
+struct ggml_compute_params_sched {
+    struct ggml_compute_params params; // must be first
+
+    uint32_t                      magic; // GGML_COMPUTE_PARAMS_SCHED_MAGIC
+    struct ggml_compute_barrier * barrier;
+};
+
+#define GGML_COMPUTE_PARAMS_SCHED_MAGIC 0x67677363u // "ggsc"
+
+// the ggml_compute_params_sched that params are part of: an op that calls ggml_barrier or ggml_chunk_next
+// with params of its own must copy the whole ggml_compute_params_sched it was given, not just the params
+static const struct ggml_compute_params_sched * ggml_compute_params_sched_of(const struct ggml_compute_params * params) {
+    const struct ggml_compute_params_sched * sched = (const struct ggml_compute_params_sched *) params;
+    GGML_ASSERT(sched->magic == GGML_COMPUTE_PARAMS_SCHED_MAGIC && "params not created by the graph scheduler");
+    return sched;
+}
+
+static struct ggml_compute_barrier * ggml_compute_params_barrier(const struct ggml_compute_params * params) {
+    return ggml_compute_params_sched_of(params)->barrier;
+}
+
+// synchronizes the threads of a node inside its COMPUTE pass, defined with the graph scheduler
+static void ggml_barrier(const struct ggml_compute_params * params);
+static int64_t ggml_chunk_next(const struct ggml_compute_params * params, int64_t ic);
+static int64_t ggml_chunk_take(const struct ggml_compute_params * params, int ig);
+static int ggml_numa_thread_node(void);
+
+// rows per chunk when nr rows are split for ggml_chunk_next, about GGML_CHUNKS_PER_THREAD chunks per thread
+static int64_t ggml_chunk_rows(int64_t nr, int nth) {
+    return MAX(1, (nr + GGML_CHUNKS_PER_THREAD*nth - 1)/(GGML_CHUNKS_PER_THREAD*nth));
+}
+
 // ggml_compute_forward_dup
 
 static void ggml_compute_forward_dup_same_cont(
@@ -9129,32 +9956,37 @@ static void ggml_compute_forward_norm_f32(
     memcpy(&eps, dst->op_params, sizeof(float));
 
     // TODO: optimize
-    for (int64_t i03 = 0; i03 < ne03; i03++) {
-        for (int64_t i02 = 0; i02 < ne02; i02++) {
-            for (int64_t i01 = ith; i01 < ne01; i01 += nth) {
-                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+    const int64_t nr = ne01*ne02*ne03;
+    const int64_t dr = ggml_chunk_rows(nr, nth);
 
-                ggml_float sum = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    sum += (ggml_float)x[i00];
-                }
+    for (int64_t ic = ith; ic*dr < nr; ic = ggml_chunk_next(params, ic)) {
+        for (int64_t ir = ic*dr; ir < MIN(ic*dr + dr, nr); ++ir) {
+            const int64_t i03 = ir/(ne02*ne01);
+            const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+            const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
 
-                float mean = sum/ne00;
+            const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
 
-                float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+            ggml_float sum = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                sum += (ggml_float)x[i00];
+            }
 
-                ggml_float sum2 = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    float v = x[i00] - mean;
-                    y[i00] = v;
-                    sum2 += (ggml_float)(v*v);
-                }
+            float mean = sum/ne00;
 
-                float variance = sum2/ne00;
-                const float scale = 1.0f/sqrtf(variance + eps);
+            float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
 
-                ggml_vec_scale_f32(ne00, y, scale);
+            ggml_float sum2 = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                float v = x[i00] - mean;
+                y[i00] = v;
+                sum2 += (ggml_float)(v*v);
             }
+
+            float variance = sum2/ne00;
+            const float scale = 1.0f/sqrtf(variance + eps);
+
+            ggml_vec_scale_f32(ne00, y, scale);
         }
     }
 }
@@ -9198,29 +10030,34 @@ static void ggml_compute_forward_rms_norm_f32(
     memcpy(&eps, dst->op_params, sizeof(float));
 
     // TODO: optimize
-    for (int64_t i03 = 0; i03 < ne03; i03++) {
-        for (int64_t i02 = 0; i02 < ne02; i02++) {
-            for (int64_t i01 = ith; i01 < ne01; i01 += nth) {
-                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+    const int64_t nr = ne01*ne02*ne03;
+    const int64_t dr = ggml_chunk_rows(nr, nth);
 
-                ggml_float sum = 0.0;
-                for (int64_t i00 = 0; i00 < ne00; i00++) {
-                    sum += (ggml_float)(x[i00] * x[i00]);
-                }
+    for (int64_t ic = ith; ic*dr < nr; ic = ggml_chunk_next(params, ic)) {
+        for (int64_t ir = ic*dr; ir < MIN(ic*dr + dr, nr); ++ir) {
+            const int64_t i03 = ir/(ne02*ne01);
+            const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+            const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
 
-                const float mean = sum/ne00;
+            const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
 
-                float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+            ggml_float sum = 0.0;
+            for (int64_t i00 = 0; i00 < ne00; i00++) {
+                sum += (ggml_float)(x[i00] * x[i00]);
+            }
 
-                memcpy(y, x, ne00 * sizeof(float));
-                // for (int i00 = 0; i00 < ne00; i00++) {
-                //     y[i00] = x[i00];
-                // }
+            const float mean = sum/ne00;
 
-                const float scale = 1.0f/sqrtf(mean + eps);
+            float * y = (float *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
 
-                ggml_vec_scale_f32(ne00, y, scale);
-            }
+            memcpy(y, x, ne00 * sizeof(float));
+            // for (int i00 = 0; i00 < ne00; i00++) {
+            //     y[i00] = x[i00];
+            // }
+
+            const float scale = 1.0f/sqrtf(mean + eps);
+
+            ggml_vec_scale_f32(ne00, y, scale);
         }
     }
 }
@@ -9537,6 +10374,272 @@ static bool ggml_compute_forward_mul_mat_use_blas(
 }
 #endif
 
+// register-tiled GEMM for F32 and F16 src0 with many src1 rows: the dot products of a tile of
+// GGML_GEMM_MR src0 rows and GGML_GEMM_NR src1 rows are accumulated together, so every load feeds
+// several FMAs instead of one as in vec_dot
+static bool ggml_compute_forward_mul_mat_use_gemm(
+        const struct ggml_tensor * src0,
+        const struct ggml_tensor * src1) {
+    return (src0->type == GGML_TYPE_F32 || src0->type == GGML_TYPE_F16) &&
+            src1->type == GGML_TYPE_F32 &&
+            src1->ne[1] >= GGML_GEMM_MIN_NE11;
+}
+
+// c[j*ldc + i] (+)= a[i*lda + :n] . b[j*ldb + :n] for i < mr, j < nr
+static inline void ggml_gemm_f32_tile(
+        const int n, const int mr, const int nr,
+        const float * restrict a, const int64_t lda,
+        const float * restrict b, const int64_t ldb,
+              float * restrict c, const int64_t ldc, const bool accumulate) {
+    float sum[GGML_GEMM_MR][GGML_GEMM_NR] = { { 0.0f } };
+
+    int k = 0;
+
+#if defined(GGML_SIMD)
+    GGML_F32_VEC acc[GGML_GEMM_MR][GGML_GEMM_NR];
+
+    for (int i = 0; i < mr; ++i) {
+        for (int j = 0; j < nr; ++j) {
+            acc[i][j] = GGML_F32_VEC_ZERO;
+        }
+    }
+
+    for (; k + GGML_F32_EPR <= n; k += GGML_F32_EPR) {
+        GGML_F32_VEC bv[GGML_GEMM_NR];
+
+        for (int j = 0; j < nr; ++j) {
+            bv[j] = GGML_F32_VEC_LOAD(b + j*ldb + k);
+        }
+        for (int i = 0; i < mr; ++i) {
+            const GGML_F32_VEC av = GGML_F32_VEC_LOAD(a + i*lda + k);
+            for (int j = 0; j < nr; ++j) {
+                acc[i][j] = GGML_F32_VEC_FMA(acc[i][j], av, bv[j]);
+            }
+        }
+    }
+
+    float tmp[GGML_GEMM_MR][GGML_GEMM_NR][GGML_F32_EPR];
+
+    for (int i = 0; i < mr; ++i) {
+        for (int j = 0; j < nr; ++j) {
+            GGML_F32_VEC_STORE(tmp[i][j], acc[i][j]);
+        }
+    }
+
+    // pairwise, the horizontal sums are on the critical path of short passes
+    for (int w = GGML_F32_EPR/2; w > 0; w /= 2) {
+        for (int i = 0; i < mr; ++i) {
+            for (int j = 0; j < nr; ++j) {
+                for (int l = 0; l < w; ++l) {
+                    tmp[i][j][l] += tmp[i][j][l + w];
+                }
+            }
+        }
+    }
+
+    for (int i = 0; i < mr; ++i) {
+        for (int j = 0; j < nr; ++j) {
+            sum[i][j] = tmp[i][j][0];
+        }
+    }
+#endif
+
+    for (; k < n; ++k) {
+        for (int i = 0; i < mr; ++i) {
+            for (int j = 0; j < nr; ++j) {
+                sum[i][j] += a[i*lda + k]*b[j*ldb + k];
+            }
+        }
+    }
+
+    for (int i = 0; i < mr; ++i) {
+        for (int j = 0; j < nr; ++j) {
+            c[j*ldc + i] = accumulate ? c[j*ldc + i] + sum[i][j] : sum[i][j];
+        }
+    }
+}
+
+// dst rows [ir10, ir11) x columns [ir00, ir01) of a mul_mat with the GEMM kernel
+// F16 src0 rows are converted to F32 panels of GGML_MUL_MAT_CHUNK x GGML_GEMM_KC values in the
+// thread's slice of wdata, src1 and dst are accessed in place and dst accumulates the passes over ne00
+static void ggml_compute_forward_mul_mat_gemm(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src0,
+        const struct ggml_tensor * src1,
+              struct ggml_tensor * dst,
+        const int64_t ir00, const int64_t ir01,
+        const int64_t ir10, const int64_t ir11) {
+    GGML_TENSOR_BINARY_OP_LOCALS
+
+    const int64_t r2 = ne12/ne02;
+    const int64_t r3 = ne13/ne03;
+
+    float * panel = (float *) params->wdata + (int64_t) params->ith*GGML_MUL_MAT_CHUNK*GGML_GEMM_KC;
+
+    assert(src0->type == GGML_TYPE_F32 || params->wsize >= (size_t) (params->ith + 1)*GGML_MUL_MAT_CHUNK*GGML_GEMM_KC*sizeof(float));
+
+    const int64_t ldb = nb11/sizeof(float);
+    const int64_t ldc = nb1/sizeof(float);
+
+    for (int64_t ir1 = ir10; ir1 < ir11; ) {
+        // the src1 rows of the same matrix, they share the src0 matrix
+        const int64_t i13 = (ir1/(ne12*ne11));
+        const int64_t i12 = (ir1 - i13*ne12*ne11)/ne11;
+        const int64_t i11 = (ir1 - i13*ne12*ne11 - i12*ne11);
+
+        const int64_t n1 = MIN(ne11 - i11, ir11 - ir1);
+
+        const char  * x = (const char *) src0->data + (i12/r2)*nb02 + (i13/r3)*nb03;
+        const float * y = (const float *) ((const char *) src1->data + i11*nb11 + i12*nb12 + i13*nb13);
+              float * d = (float *) ((char *) dst->data + i11*nb1 + i12*nb2 + i13*nb3);
+
+        for (int64_t ir0 = ir00; ir0 < ir01; ir0 += GGML_MUL_MAT_CHUNK) {
+            const int64_t n0 = MIN(GGML_MUL_MAT_CHUNK, ir01 - ir0);
+
+            for (int64_t k = 0; k < ne00; k += GGML_GEMM_KC) {
+                const int nk = MIN(GGML_GEMM_KC, ne00 - k);
+
+                const float * a;
+                int64_t lda;
+
+                if (src0->type == GGML_TYPE_F16) {
+                    for (int64_t i = 0; i < n0; ++i) {
+                        ggml_fp16_to_fp32_row((const ggml_fp16_t *) (x + (ir0 + i)*nb01) + k, panel + i*nk, nk);
+                    }
+                    a   = panel;
+                    lda = nk;
+                } else {
+                    a   = (const float *) (x + ir0*nb01) + k;
+                    lda = nb01/sizeof(float);
+                }
+
+                for (int64_t j = 0; j < n1; j += GGML_GEMM_NR) {
+                    const int nr = MIN(GGML_GEMM_NR, n1 - j);
+
+                    for (int64_t i = 0; i < n0; i += GGML_GEMM_MR) {
+                        const int mr = MIN(GGML_GEMM_MR, n0 - i);
+
+                        const float * ai = a + i*lda;
+                        const float * bj = y + j*ldb + k;
+                              float * cij = d + j*ldc + ir0 + i;
+
+                        if (mr == GGML_GEMM_MR && nr == GGML_GEMM_NR) {
+                            ggml_gemm_f32_tile(nk, GGML_GEMM_MR, GGML_GEMM_NR, ai, lda, bj, ldb, cij, ldc, k > 0);
+                        } else {
+                            ggml_gemm_f32_tile(nk, mr, nr, ai, lda, bj, ldb, cij, ldc, k > 0);
+                        }
+                    }
+                }
+            }
+        }
+
+        ir1 += n1;
+    }
+}
+
+// the chunks of dst computed by a thread of ggml_compute_forward_mul_mat
+// dst is split in chunks of GGML_MUL_MAT_CHUNK x GGML_MUL_MAT_CHUNK rows, larger ones along src0 for
+// matrix-vector products. on NUMA systems src0 is cut in one block of rows per node, the block that
+// ggml_numa_distribute_tensor places on that node: a thread takes the chunks of the block of the node
+// it is pinned to first and then helps with the other blocks, so every block is computed whatever the
+// number of threads of the node and their position in it
+struct ggml_mul_mat_chunks {
+    int64_t nr0;
+    int64_t nr1;
+    int64_t rr;
+
+    int n_groups;
+    int ig0;      // block the thread starts with
+    int jg;       // blocks the thread is done with
+    int64_t ic;   // current chunk of block (ig0 + jg) % n_groups
+
+    int64_t ir0_begin;
+    int64_t ir0_end;
+    int64_t nchunk0;
+    int64_t nchunk1;
+    int64_t dr0;
+    int64_t dr1;
+};
+
+static void ggml_mul_mat_chunks_group(struct ggml_mul_mat_chunks * ch, int nth) {
+    const int ig = (ch->ig0 + ch->jg) % ch->n_groups;
+
+    const int64_t nr0 = ch->nr0;
+    const int64_t nr1 = ch->nr1;
+    const int64_t rr  = ch->rr;
+
+    // about as many threads per block as set_numa_thread_affinity pins to each node
+    const int nth_g = MAX(1, nth/ch->n_groups);
+
+    ch->ir0_begin = (nr0/rr)*ig/ch->n_groups*rr;
+    ch->ir0_end   = (nr0/rr)*(ig + 1)/ch->n_groups*rr;
+
+    const int64_t nr0_g = ch->ir0_end - ch->ir0_begin;
+
+    const int64_t chunk_size = nr1 == 1 ? 4*GGML_MUL_MAT_CHUNK : GGML_MUL_MAT_CHUNK;
+
+    ch->nchunk0 = (nr0_g + chunk_size - 1)/chunk_size;
+    ch->nchunk1 = (nr1   + chunk_size - 1)/chunk_size;
+
+    if (ch->nchunk0*ch->nchunk1 < GGML_CHUNKS_PER_THREAD*nth_g) {
+        // too few chunks to balance: one per thread, across the inner or outer loop based on which one is larger
+        ch->nchunk0 = nr0_g > nr1 ? nth_g : 1; // parallelize by src0 rows
+        ch->nchunk1 = nr0_g > nr1 ? 1 : nth_g; // parallelize by src1 rows
+    }
+
+    // chunks of src0 rows start at a group of interleaved rows
+    ch->dr0 = (nr0_g + ch->nchunk0*rr - 1)/(ch->nchunk0*rr)*rr;
+    ch->dr1 = (nr1 + ch->nchunk1 - 1)/ch->nchunk1;
+}
+
+static void ggml_mul_mat_chunks_init(struct ggml_mul_mat_chunks * ch, const struct ggml_compute_params * params,
+        int64_t nr0, int64_t nr1, int64_t rr) {
+    ch->nr0 = nr0;
+    ch->nr1 = nr1;
+    ch->rr  = rr;
+
+    ch->n_groups = ggml_is_numa() ? (int) g_state.numa.n_nodes : 1;
+    ch->jg       = 0;
+    ch->ic       = -1;
+
+    // a thread that is not pinned, such as the caller of ggml_graph_compute, starts with any block
+    const int node = ggml_numa_thread_node();
+    ch->ig0 = node >= 0 && node < ch->n_groups ? node : params->ith % ch->n_groups;
+
+    ggml_mul_mat_chunks_group(ch, params->nth);
+}
+
+// the next chunk of the thread as the rows [ir0, ir1) of src0 and [ir10, ir11) of src1, false when done
+static bool ggml_mul_mat_chunks_next(struct ggml_mul_mat_chunks * ch, const struct ggml_compute_params * params,
+        int64_t * ir00, int64_t * ir01, int64_t * ir10, int64_t * ir11) {
+    while (true) {
+        if (ch->n_groups == 1) {
+            // every thread starts with chunk ith, see ggml_chunk_next
+            ch->ic = ch->ic < 0 ? params->ith : ggml_chunk_next(params, ch->ic);
+        } else {
+            ch->ic = ggml_chunk_take(params, (ch->ig0 + ch->jg) % ch->n_groups);
+        }
+
+        if (ch->ic < ch->nchunk0*ch->nchunk1) {
+            break;
+        }
+
+        if (++ch->jg == ch->n_groups) {
+            return false;
+        }
+
+        ggml_mul_mat_chunks_group(ch, params->nth);
+    }
+
+    *ir00 = ch->ir0_begin + ch->dr0*(ch->ic % ch->nchunk0);
+    *ir01 = MIN(*ir00 + ch->dr0, ch->ir0_end);
+
+    *ir10 = ch->dr1*(ch->ic / ch->nchunk0);
+    *ir11 = MIN(*ir10 + ch->dr1, ch->nr1);
+
+    return true;
+}
+
 static void ggml_compute_forward_mul_mat(
         const struct ggml_compute_params * params,
         const struct ggml_tensor * src0,
@@ -9555,6 +10658,8 @@ static void ggml_compute_forward_mul_mat(
     const bool src1_cont = ggml_is_contiguous(src1);
 
     ggml_vec_dot_t    const vec_dot               = type_traits[type].vec_dot;
+    ggml_vec_dot_nc_t const vec_dot_nc            = type_traits[type].vec_dot_nc;
+    ggml_vec_dot_t    const vec_dot_x4            = type_traits[type].vec_dot_x4;
     enum ggml_type    const vec_dot_type          = type_traits[type].vec_dot_type;
     ggml_from_float_t const from_float_to_vec_dot = type_traits[vec_dot_type].from_float;
 
@@ -9577,11 +10682,17 @@ static void ggml_compute_forward_mul_mat(
     const int64_t r2 = ne12/ne02;
     const int64_t r3 = ne13/ne03;
 
+    // src0 rows interleaved by ggml_repack: computed GGML_REPACK_ROWS at a time by vec_dot_x4
+    const bool    repacked = src0->flags & GGML_TENSOR_FLAG_REPACKED;
+    const int64_t rr       = repacked ? GGML_REPACK_ROWS : 1;
+
+    GGML_ASSERT(!repacked || (vec_dot_x4 && ne01 % GGML_REPACK_ROWS == 0));
+
     // nb01 >= nb00 - src0 is not transposed
     //   compute by src0 rows
 
 #if defined(GGML_USE_CLBLAST)
-    if (ggml_cl_can_mul_mat(src0, src1, dst)) {
+    if (!repacked && ggml_cl_can_mul_mat(src0, src1, dst)) {
         if (params->ith == 0 && params->type == GGML_TASK_COMPUTE) {
             ggml_cl_mul_mat(src0, src1, dst, params->wdata, params->wsize);
         }
@@ -9642,29 +10753,12 @@ static void ggml_compute_forward_mul_mat(
     }
 #endif
 
-    if (params->type == GGML_TASK_INIT) {
-        if (src1->type != vec_dot_type) {
-            char * wdata = params->wdata;
-            const size_t row_size = ne10*ggml_type_size(vec_dot_type)/ggml_blck_size(vec_dot_type);
-
-            assert(params->wsize >= ne11*ne12*ne13*row_size);
-
-            for (int64_t i13 = 0; i13 < ne13; ++i13) {
-                for (int64_t i12 = 0; i12 < ne12; ++i12) {
-                    for (int64_t i11 = 0; i11 < ne11; ++i11) {
-                        from_float_to_vec_dot((float *)((char *) src1->data + i13*nb13 + i12*nb12 + i11*nb11), (void *) wdata, ne10);
-                        wdata += row_size;
-                    }
-                }
-            }
-        }
-
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
         return;
     }
 
-    if (params->type == GGML_TASK_FINALIZE) {
-        return;
-    }
+    // the GEMM kernel reads src1 as F32, it needs no conversion to vec_dot_type
+    const bool use_gemm = ggml_compute_forward_mul_mat_use_gemm(src0, src1);
 
     const void * wdata    = (src1->type == vec_dot_type) ? src1->data : params->wdata;
     const size_t row_size = ne10*ggml_type_size(vec_dot_type)/ggml_blck_size(vec_dot_type);
@@ -9672,32 +10766,36 @@ static void ggml_compute_forward_mul_mat(
     const int64_t nr0 = ne01;           // src0 rows
     const int64_t nr1 = ne11*ne12*ne13; // src1 rows
 
-    //printf("nr0 = %lld, nr1 = %lld\n", nr0, nr1);
+    if (src1->type != vec_dot_type && !use_gemm) {
+        // every thread converts a slice of the src1 rows to vec_dot_type,
+        // the whole of it is needed by all threads after the barrier
+        assert(params->wsize >= nr1*row_size);
 
-    // distribute the thread work across the inner or outer loop based on which one is larger
+        const int64_t dr = (nr1 + nth - 1)/nth;
 
-    const int64_t nth0 = nr0 > nr1 ? nth : 1; // parallelize by src0 rows
-    const int64_t nth1 = nr0 > nr1 ? 1 : nth; // parallelize by src1 rows
+        const int64_t ir0 = dr*ith;
+        const int64_t ir1 = MIN(ir0 + dr, nr1);
 
-    const int64_t ith0 = ith % nth0;
-    const int64_t ith1 = ith / nth0;
+        for (int64_t ir = ir0; ir < ir1; ++ir) {
+            const int64_t i13 = (ir/(ne12*ne11));
+            const int64_t i12 = (ir - i13*ne12*ne11)/ne11;
+            const int64_t i11 = (ir - i13*ne12*ne11 - i12*ne11);
 
-    const int64_t dr0 = (nr0 + nth0 - 1)/nth0;
-    const int64_t dr1 = (nr1 + nth1 - 1)/nth1;
+            from_float_to_vec_dot((float *)((char *) src1->data + i13*nb13 + i12*nb12 + i11*nb11), (char *) params->wdata + ir*row_size, ne10);
+        }
 
-    const int64_t ir010 = dr0*ith0;
-    const int64_t ir011 = MIN(ir010 + dr0, nr0);
+        ggml_barrier(params);
+    }
 
-    const int64_t ir110 = dr1*ith1;
-    const int64_t ir111 = MIN(ir110 + dr1, nr1);
+    //printf("nr0 = %lld, nr1 = %lld\n", nr0, nr1);
 
-    //printf("ir010 = %6lld, ir011 = %6lld, ir110 = %6lld, ir111 = %6lld\n", ir010, ir011, ir110, ir111);
+    struct ggml_mul_mat_chunks chunks;
+    ggml_mul_mat_chunks_init(&chunks, params, nr0, nr1, rr);
 
-    // threads with no work simply yield (not sure if it helps)
-    if (ir010 >= ir011 || ir110 >= ir111) {
-        sched_yield();
-        return;
-    }
+    int64_t ir010;
+    int64_t ir011;
+    int64_t ir110;
+    int64_t ir111;
 
     assert(ne12 % ne02 == 0);
     assert(ne13 % ne03 == 0);
@@ -9709,42 +10807,70 @@ static void ggml_compute_forward_mul_mat(
     // attempt to reduce false-sharing (does not seem to make a difference)
     float tmp[16];
 
-    for (int64_t iir1 = ir110; iir1 < ir111; iir1 += blck_1) {
-        for (int64_t iir0 = ir010; iir0 < ir011; iir0 += blck_0) {
-            for (int64_t ir1 = iir1; ir1 < iir1 + blck_1 && ir1 < ir111; ++ir1) {
-                const int64_t i13 = (ir1/(ne12*ne11));
-                const int64_t i12 = (ir1 - i13*ne12*ne11)/ne11;
-                const int64_t i11 = (ir1 - i13*ne12*ne11 - i12*ne11);
-
-                // broadcast src0 into src1
-                const int64_t i03 = i13/r3;
-                const int64_t i02 = i12/r2;
-
-                const int64_t i1 = i11;
-                const int64_t i2 = i12;
-                const int64_t i3 = i13;
-
-                const char * src0_row = (const char *) src0->data + (0 + i02*nb02 + i03*nb03);
+    while (ggml_mul_mat_chunks_next(&chunks, params, &ir010, &ir011, &ir110, &ir111)) {
+        //printf("ir010 = %6lld, ir011 = %6lld, ir110 = %6lld, ir111 = %6lld\n", ir010, ir011, ir110, ir111);
 
-                // desc: when src1 is not a contiguous memory block we have to calculate the offset using the strides
-                //       if it is, then we have either copied the data to params->wdata and made it contiguous or we are using
-                //       the original src1 data pointer, so we should index using the indices directly
-                // TODO: this is a bit of a hack, we should probably have a better way to handle this
-                const char * src1_col = (const char *) wdata +
-                    (src1_cont || src1->type != vec_dot_type
-                     ? (i11      + i12*ne11 + i13*ne12*ne11)*row_size
-                     : (i11*nb11 + i12*nb12 + i13*nb13));
-
-                float * dst_col = (float *) ((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3));
+        if (use_gemm) {
+            ggml_compute_forward_mul_mat_gemm(params, src0, src1, dst, ir010, ir011, ir110, ir111);
+            continue;
+        }
 
-                //for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ++ir0) {
-                //    vec_dot(ne00, &dst_col[ir0], src0_row + ir0*nb01, src1_col);
-                //}
+        for (int64_t iir1 = ir110; iir1 < ir111; iir1 += blck_1) {
+            for (int64_t iir0 = ir010; iir0 < ir011; iir0 += blck_0) {
+                for (int64_t ir1 = iir1, nc = 1; ir1 < iir1 + blck_1 && ir1 < ir111; ir1 += nc) {
+                    const int64_t i13 = (ir1/(ne12*ne11));
+                    const int64_t i12 = (ir1 - i13*ne12*ne11)/ne11;
+                    const int64_t i11 = (ir1 - i13*ne12*ne11 - i12*ne11);
+
+                    // GGML_VEC_DOT_NC src1 rows of the same matrix at once, they are row_size apart in wdata
+                    nc = vec_dot_nc && !repacked && (src1_cont || src1->type != vec_dot_type) &&
+                         ir1 + GGML_VEC_DOT_NC <= MIN(iir1 + blck_1, ir111) &&
+                         i11 + GGML_VEC_DOT_NC <= ne11 ? GGML_VEC_DOT_NC : 1;
+
+                    // broadcast src0 into src1
+                    const int64_t i03 = i13/r3;
+                    const int64_t i02 = i12/r2;
+
+                    const int64_t i1 = i11;
+                    const int64_t i2 = i12;
+                    const int64_t i3 = i13;
+
+                    const char * src0_row = (const char *) src0->data + (0 + i02*nb02 + i03*nb03);
+
+                    // desc: when src1 is not a contiguous memory block we have to calculate the offset using the strides
+                    //       if it is, then we have either copied the data to params->wdata and made it contiguous or we are using
+                    //       the original src1 data pointer, so we should index using the indices directly
+                    // TODO: this is a bit of a hack, we should probably have a better way to handle this
+                    const char * src1_col = (const char *) wdata +
+                        (src1_cont || src1->type != vec_dot_type
+                         ? (i11      + i12*ne11 + i13*ne12*ne11)*row_size
+                         : (i11*nb11 + i12*nb12 + i13*nb13));
+
+                    float * dst_col = (float *) ((char *) dst->data + (i1*nb1 + i2*nb2 + i3*nb3));
+
+                    //for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ++ir0) {
+                    //    vec_dot(ne00, &dst_col[ir0], src0_row + ir0*nb01, src1_col);
+                    //}
+
+                    if (nc > 1) {
+                        for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ++ir0) {
+                            vec_dot_nc(ne00, &dst_col[ir0], nb1/sizeof(float), src0_row + ir0*nb01, src1_col, row_size);
+                        }
+                        continue;
+                    }
 
-                for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ++ir0) {
-                    vec_dot(ne00, &tmp[ir0 - iir0], src0_row + ir0*nb01, src1_col);
+                    if (repacked) {
+                        // the group of GGML_REPACK_ROWS rows starting at ir0 is stored as that many rows from there
+                        for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ir0 += GGML_REPACK_ROWS) {
+                            vec_dot_x4(ne00, &tmp[ir0 - iir0], src0_row + ir0*nb01, src1_col);
+                        }
+                    } else {
+                        for (int64_t ir0 = iir0; ir0 < iir0 + blck_0 && ir0 < ir011; ++ir0) {
+                            vec_dot(ne00, &tmp[ir0 - iir0], src0_row + ir0*nb01, src1_col);
+                        }
+                    }
+                    memcpy(&dst_col[iir0], tmp, (MIN(iir0 + blck_0, ir011) - iir0)*sizeof(float));
                 }
-                memcpy(&dst_col[iir0], tmp, (MIN(iir0 + blck_0, ir011) - iir0)*sizeof(float));
             }
         }
     }
@@ -10672,6 +11798,7 @@ static void ggml_compute_forward_diag_mask_zero(
 static void ggml_compute_forward_soft_max_f32(
         const struct ggml_compute_params * params,
         const struct ggml_tensor * src0,
+        const struct ggml_tensor * src1,
         struct ggml_tensor * dst) {
     GGML_ASSERT(ggml_is_contiguous(src0));
     GGML_ASSERT(ggml_is_contiguous(dst));
@@ -10681,73 +11808,103 @@ static void ggml_compute_forward_soft_max_f32(
         return;
     }
 
+    float scale    = 1.0f;
+    float max_bias = 0.0f;
+
+    memcpy(&scale,    (float *) dst->op_params + 0, sizeof(float));
+    memcpy(&max_bias, (float *) dst->op_params + 1, sizeof(float));
+
     // TODO: handle transposed/permuted matrices
 
     const int ith = params->ith;
     const int nth = params->nth;
 
+    const int64_t ne01 = src0->ne[1];
+    const int64_t ne02 = src0->ne[2];
+
     const int nc = src0->ne[0];
     const int nr = ggml_nrows(src0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
+    // ALiBi slopes as in ggml_alibi, the heads are along dim 2
+    const int   n_head             = ne02;
+    const int   n_heads_log2_floor = 1 << (int) floor(log2(n_head));
+    const float m0 = powf(2.0f, -(max_bias) / n_heads_log2_floor);
+    const float m1 = powf(2.0f, -(max_bias / 2.0f) / n_heads_log2_floor);
 
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
+    // rows per chunk
+    const int dr = ggml_chunk_rows(nr, nth);
 
-    for (int i1 = ir0; i1 < ir1; i1++) {
-        float *sp = (float *)((char *) src0->data + i1*src0->nb[1]);
-        float *dp = (float *)((char *)  dst->data +  i1*dst->nb[1]);
+    for (int64_t ic = ith; ic*dr < nr; ic = ggml_chunk_next(params, ic)) {
+        const int ir0 = ic*dr;
+        const int ir1 = MIN(ir0 + dr, nr);
 
-#ifndef NDEBUG
-        for (int i = 0; i < nc; ++i) {
-            //printf("p[%d] = %f\n", i, p[i]);
-            assert(!isnan(sp[i]));
-        }
-#endif
+        for (int i1 = ir0; i1 < ir1; i1++) {
+            float *sp = (float *)((char *) src0->data + i1*src0->nb[1]);
+            float *dp = (float *)((char *)  dst->data +  i1*dst->nb[1]);
 
-        float max = -INFINITY;
-        ggml_vec_max_f32(nc, &max, sp);
+            // the mask is broadcast over dims 2 and 3
+            const float * mp = src1 ? (const float *)((const char *) src1->data + (i1%ne01)*src1->nb[1]) : NULL;
 
-        ggml_float sum = 0.0;
+            const int   h     = (i1/ne01)%ne02;
+            const float slope = max_bias > 0.0f
+                ? (h < n_heads_log2_floor ? powf(m0, h + 1) : powf(m1, 2*(h - n_heads_log2_floor) + 1))
+                : 0.0f;
 
-        uint16_t scvt;
-        for (int i = 0; i < nc; i++) {
-            if (sp[i] == -INFINITY) {
-                dp[i] = 0.0f;
+#ifndef NDEBUG
+            for (int i = 0; i < nc; ++i) {
+                //printf("p[%d] = %f\n", i, p[i]);
+                assert(!isnan(sp[i]));
+            }
+#endif
+
+            // scaled, masked and biased row, written to dst in the same pass
+            if (mp && slope != 0.0f) {
+                for (int i = 0; i < nc; i++) {
+                    dp[i] = sp[i]*scale + mp[i] + slope*i;
+                }
+            } else if (mp) {
+                for (int i = 0; i < nc; i++) {
+                    dp[i] = sp[i]*scale + mp[i];
+                }
+            } else if (slope != 0.0f) {
+                for (int i = 0; i < nc; i++) {
+                    dp[i] = sp[i]*scale + slope*i;
+                }
             } else {
-                // const float val = (sp[i] == -INFINITY) ? 0.0 : exp(sp[i] - max);
-                ggml_fp16_t s = GGML_FP32_TO_FP16(sp[i] - max);
-                memcpy(&scvt, &s, sizeof(scvt));
-                const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt]);
-                sum += (ggml_float)val;
-                dp[i] = val;
+                for (int i = 0; i < nc; i++) {
+                    dp[i] = sp[i]*scale;
+                }
             }
-        }
 
-        assert(sum > 0.0);
+            float max = -INFINITY;
+            ggml_vec_max_f32(nc, &max, dp);
+
+            ggml_float sum = ggml_vec_soft_max_f32(nc, dp, dp, max);
+
+            assert(sum > 0.0);
 
-        sum = 1.0/sum;
-        ggml_vec_scale_f32(nc, dp, sum);
+            sum = 1.0/sum;
+            ggml_vec_scale_f32(nc, dp, sum);
 
 #ifndef NDEBUG
-        for (int i = 0; i < nc; ++i) {
-            assert(!isnan(dp[i]));
-            assert(!isinf(dp[i]));
-        }
+            for (int i = 0; i < nc; ++i) {
+                assert(!isnan(dp[i]));
+                assert(!isinf(dp[i]));
+            }
 #endif
+        }
     }
 }
 
 static void ggml_compute_forward_soft_max(
         const struct ggml_compute_params * params,
         const struct ggml_tensor * src0,
+        const struct ggml_tensor * src1,
         struct ggml_tensor * dst) {
     switch (src0->type) {
         case GGML_TYPE_F32:
             {
-                ggml_compute_forward_soft_max_f32(params, src0, dst);
+                ggml_compute_forward_soft_max_f32(params, src0, src1, dst);
             } break;
         default:
             {
@@ -11170,15 +12327,8 @@ static void ggml_compute_forward_rope_f32(
     GGML_ASSERT(n_dims <= ne0);
     GGML_ASSERT(n_dims % 2 == 0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
-
-    // row index used to determine which thread to use
-    int ir = 0;
+    // rows per chunk
+    const int dr = ggml_chunk_rows(nr, nth);
 
     const float theta_scale = powf(freq_base, -2.0f/n_dims);
     const float inv_ndims = -1.f/n_dims;
@@ -11195,92 +12345,92 @@ static void ggml_compute_forward_rope_f32(
 
     const int32_t * pos = (const int32_t *) src1->data;
 
-    for (int64_t i3 = 0; i3 < ne3; i3++) {
-        for (int64_t i2 = 0; i2 < ne2; i2++) {
+    for (int64_t ichunk = ith; ichunk*dr < nr; ichunk = ggml_chunk_next(params, ichunk)) {
+        for (int64_t ir = ichunk*dr; ir < MIN(ichunk*dr + dr, nr); ++ir) {
+            const int64_t i3 = ir/(ne2*ne1);
+            const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+            const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
+
             const int64_t p = pos[i2];
-            for (int64_t i1 = 0; i1 < ne1; i1++) {
-                if (ir++ < ir0) continue;
-                if (ir   > ir1) break;
 
-                float theta_base = (float)p;
+            float theta_base = (float)p;
 
-                if (is_glm) {
-                    theta_base = MIN(p, n_ctx - 2);
-                    float block_theta = MAX(p - (n_ctx - 2), 0);
-                    for (int64_t i0 = 0; i0 < ne0 / 4; i0++) {
-                        const float cos_theta = cosf(theta_base);
-                        const float sin_theta = sinf(theta_base) * sin_sign;
-                        const float cos_block_theta = cosf(block_theta);
-                        const float sin_block_theta = sinf(block_theta) * sin_sign;
+            if (is_glm) {
+                theta_base = MIN(p, n_ctx - 2);
+                float block_theta = MAX(p - (n_ctx - 2), 0);
+                for (int64_t i0 = 0; i0 < ne0 / 4; i0++) {
+                    const float cos_theta = cosf(theta_base);
+                    const float sin_theta = sinf(theta_base) * sin_sign;
+                    const float cos_block_theta = cosf(block_theta);
+                    const float sin_block_theta = sinf(block_theta) * sin_sign;
 
-                        theta_base *= theta_scale;
-                        block_theta *= theta_scale;
+                    theta_base *= theta_scale;
+                    block_theta *= theta_scale;
 
-                        const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                              float * dst_data  = (float *)((char *)  dst->data +  i3*nb3 + i2*nb2  + i1*nb1  + i0*nb0);
+                    const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          float * dst_data  = (float *)((char *)  dst->data +  i3*nb3 + i2*nb2  + i1*nb1  + i0*nb0);
 
-                        const float x0 = src[0];
-                        const float x1 = src[n_dims/2];
-                        const float x2 = src[n_dims];
-                        const float x3 = src[n_dims/2*3];
+                    const float x0 = src[0];
+                    const float x1 = src[n_dims/2];
+                    const float x2 = src[n_dims];
+                    const float x3 = src[n_dims/2*3];
+
+                    dst_data[0]          = x0*cos_theta - x1*sin_theta;
+                    dst_data[n_dims/2]   = x0*sin_theta + x1*cos_theta;
+                    dst_data[n_dims]     = x2*cos_block_theta - x3*sin_block_theta;
+                    dst_data[n_dims/2*3] = x2*sin_block_theta + x3*cos_block_theta;
+                }
+            } else if (!is_neox) {
+                for (int64_t i0 = 0; i0 < ne0; i0 += 2) {
+                    float cos_theta, sin_theta;
+                    rope_yarn(
+                        theta_base, freq_scale, corr_dims, i0, ext_factor, attn_factor, &cos_theta, &sin_theta
+                    );
+                    sin_theta *= sin_sign;
+
+                    // zeta scaling for xPos only:
+                    float zeta = xpos_base != 0.0f ? powf((i0 + 0.4f * ne0) / (1.4f * ne0), p / xpos_base) : 1.0f;
+                    if (xpos_down) zeta = 1.0f / zeta;
+
+                    theta_base *= theta_scale;
+
+                    const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+
+                    const float x0 = src[0];
+                    const float x1 = src[1];
+
+                    dst_data[0] = x0*cos_theta*zeta - x1*sin_theta*zeta;
+                    dst_data[1] = x0*sin_theta*zeta + x1*cos_theta*zeta;
+                }
+            } else {
+                // TODO: this might be wrong for ne0 != n_dims - need double check
+                // ref:  https://github.com/huggingface/transformers/blob/main/src/transformers/models/gpt_neox/modeling_gpt_neox.py#LL251C1-L294C28
+                theta_base *= freq_scale;
+                for (int64_t ib = 0; ib < ne0/n_dims; ++ib) {
+                    for (int64_t ic = 0; ic < n_dims; ic += 2) {
+                        // simplified from `(ib * n_dims + ic) * inv_ndims`
+                        float cur_rot = inv_ndims * ic - ib;
 
-                        dst_data[0]          = x0*cos_theta - x1*sin_theta;
-                        dst_data[n_dims/2]   = x0*sin_theta + x1*cos_theta;
-                        dst_data[n_dims]     = x2*cos_block_theta - x3*sin_block_theta;
-                        dst_data[n_dims/2*3] = x2*sin_block_theta + x3*cos_block_theta;
-                    }
-                } else if (!is_neox) {
-                    for (int64_t i0 = 0; i0 < ne0; i0 += 2) {
                         float cos_theta, sin_theta;
                         rope_yarn(
-                            theta_base, freq_scale, corr_dims, i0, ext_factor, attn_factor, &cos_theta, &sin_theta
+                            theta_base, freq_scale, corr_dims, cur_rot, ext_factor, attn_factor,
+                            &cos_theta, &sin_theta
                         );
                         sin_theta *= sin_sign;
 
-                        // zeta scaling for xPos only:
-                        float zeta = xpos_base != 0.0f ? powf((i0 + 0.4f * ne0) / (1.4f * ne0), p / xpos_base) : 1.0f;
-                        if (xpos_down) zeta = 1.0f / zeta;
-
                         theta_base *= theta_scale;
 
+                        const int64_t i0 = ib*n_dims + ic/2;
+
                         const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
                               float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
                         const float x0 = src[0];
-                        const float x1 = src[1];
-
-                        dst_data[0] = x0*cos_theta*zeta - x1*sin_theta*zeta;
-                        dst_data[1] = x0*sin_theta*zeta + x1*cos_theta*zeta;
-                    }
-                } else {
-                    // TODO: this might be wrong for ne0 != n_dims - need double check
-                    // ref:  https://github.com/huggingface/transformers/blob/main/src/transformers/models/gpt_neox/modeling_gpt_neox.py#LL251C1-L294C28
-                    theta_base *= freq_scale;
-                    for (int64_t ib = 0; ib < ne0/n_dims; ++ib) {
-                        for (int64_t ic = 0; ic < n_dims; ic += 2) {
-                            // simplified from `(ib * n_dims + ic) * inv_ndims`
-                            float cur_rot = inv_ndims * ic - ib;
-
-                            float cos_theta, sin_theta;
-                            rope_yarn(
-                                theta_base, freq_scale, corr_dims, cur_rot, ext_factor, attn_factor,
-                                &cos_theta, &sin_theta
-                            );
-                            sin_theta *= sin_sign;
-
-                            theta_base *= theta_scale;
-
-                            const int64_t i0 = ib*n_dims + ic/2;
-
-                            const float * const src = (float *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                                  float * dst_data  = (float *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
-
-                            const float x0 = src[0];
-                            const float x1 = src[n_dims/2];
+                        const float x1 = src[n_dims/2];
 
-                            dst_data[0]        = x0*cos_theta - x1*sin_theta;
-                            dst_data[n_dims/2] = x0*sin_theta + x1*cos_theta;
-                        }
+                        dst_data[0]        = x0*cos_theta - x1*sin_theta;
+                        dst_data[n_dims/2] = x0*sin_theta + x1*cos_theta;
                     }
                 }
             }
@@ -11327,15 +12477,8 @@ static void ggml_compute_forward_rope_f16(
     GGML_ASSERT(n_dims <= ne0);
     GGML_ASSERT(n_dims % 2 == 0);
 
-    // rows per thread
-    const int dr = (nr + nth - 1)/nth;
-
-    // row range for this thread
-    const int ir0 = dr*ith;
-    const int ir1 = MIN(ir0 + dr, nr);
-
-    // row index used to determine which thread to use
-    int ir = 0;
+    // rows per chunk
+    const int dr = ggml_chunk_rows(nr, nth);
 
     const float theta_scale = powf(freq_base, -2.0f/n_dims);
     const float inv_ndims = -1.f/n_dims;
@@ -11352,88 +12495,88 @@ static void ggml_compute_forward_rope_f16(
 
     const int32_t * pos = (const int32_t *) src1->data;
 
-    for (int64_t i3 = 0; i3 < ne3; i3++) {
-        for (int64_t i2 = 0; i2 < ne2; i2++) {
+    for (int64_t ichunk = ith; ichunk*dr < nr; ichunk = ggml_chunk_next(params, ichunk)) {
+        for (int64_t ir = ichunk*dr; ir < MIN(ichunk*dr + dr, nr); ++ir) {
+            const int64_t i3 = ir/(ne2*ne1);
+            const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+            const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
+
             const int64_t p = pos[i2];
-            for (int64_t i1 = 0; i1 < ne1; i1++) {
-                if (ir++ < ir0) continue;
-                if (ir   > ir1) break;
 
-                float theta_base = (float)p;
+            float theta_base = (float)p;
 
-                if (is_glm) {
-                    theta_base = MIN(p, n_ctx - 2);
-                    float block_theta = MAX(p - (n_ctx - 2), 0);
-                    for (int64_t i0 = 0; i0 < ne0 / 4; i0++) {
-                        const float cos_theta = cosf(theta_base);
-                        const float sin_theta = sinf(theta_base) * sin_sign;
-                        const float cos_block_theta = cosf(block_theta);
-                        const float sin_block_theta = sinf(block_theta) * sin_sign;
+            if (is_glm) {
+                theta_base = MIN(p, n_ctx - 2);
+                float block_theta = MAX(p - (n_ctx - 2), 0);
+                for (int64_t i0 = 0; i0 < ne0 / 4; i0++) {
+                    const float cos_theta = cosf(theta_base);
+                    const float sin_theta = sinf(theta_base) * sin_sign;
+                    const float cos_block_theta = cosf(block_theta);
+                    const float sin_block_theta = sinf(block_theta) * sin_sign;
 
-                        theta_base *= theta_scale;
-                        block_theta *= theta_scale;
+                    theta_base *= theta_scale;
+                    block_theta *= theta_scale;
 
-                        const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                              ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data +  i3*nb3 + i2*nb2  + i1*nb1  + i0*nb0);
+                    const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data +  i3*nb3 + i2*nb2  + i1*nb1  + i0*nb0);
 
-                        const float x0 = GGML_FP16_TO_FP32(src[0]);
-                        const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
-                        const float x2 = GGML_FP16_TO_FP32(src[n_dims]);
-                        const float x3 = GGML_FP16_TO_FP32(src[n_dims/2*3]);
+                    const float x0 = GGML_FP16_TO_FP32(src[0]);
+                    const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
+                    const float x2 = GGML_FP16_TO_FP32(src[n_dims]);
+                    const float x3 = GGML_FP16_TO_FP32(src[n_dims/2*3]);
+
+                    dst_data[0]          = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
+                    dst_data[n_dims/2]   = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
+                    dst_data[n_dims]     = GGML_FP32_TO_FP16(x2*cos_block_theta - x3*sin_block_theta);
+                    dst_data[n_dims/2*3] = GGML_FP32_TO_FP16(x2*sin_block_theta + x3*cos_block_theta);
+                }
+            } else if (!is_neox) {
+                for (int64_t i0 = 0; i0 < ne0; i0 += 2) {
+                    float cos_theta, sin_theta;
+                    rope_yarn(
+                        theta_base, freq_scale, corr_dims, i0, ext_factor, attn_factor, &cos_theta, &sin_theta
+                    );
+                    sin_theta *= sin_sign;
+
+                    theta_base *= theta_scale;
+
+                    const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
+                          ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
+
+                    const float x0 = GGML_FP16_TO_FP32(src[0]);
+                    const float x1 = GGML_FP16_TO_FP32(src[1]);
+
+                    dst_data[0] = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
+                    dst_data[1] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
+                }
+            } else {
+                // TODO: this might be wrong for ne0 != n_dims - need double check
+                // ref:  https://github.com/huggingface/transformers/blob/main/src/transformers/models/gpt_neox/modeling_gpt_neox.py#LL251C1-L294C28
+                theta_base *= freq_scale;
+                for (int64_t ib = 0; ib < ne0/n_dims; ++ib) {
+                    for (int64_t ic = 0; ic < n_dims; ic += 2) {
+                        // simplified from `(ib * n_dims + ic) * inv_ndims`
+                        float cur_rot = inv_ndims * ic - ib;
 
-                        dst_data[0]          = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
-                        dst_data[n_dims/2]   = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
-                        dst_data[n_dims]     = GGML_FP32_TO_FP16(x2*cos_block_theta - x3*sin_block_theta);
-                        dst_data[n_dims/2*3] = GGML_FP32_TO_FP16(x2*sin_block_theta + x3*cos_block_theta);
-                    }
-                } else if (!is_neox) {
-                    for (int64_t i0 = 0; i0 < ne0; i0 += 2) {
                         float cos_theta, sin_theta;
                         rope_yarn(
-                            theta_base, freq_scale, corr_dims, i0, ext_factor, attn_factor, &cos_theta, &sin_theta
+                            theta_base, freq_scale, corr_dims, cur_rot, ext_factor, attn_factor,
+                            &cos_theta, &sin_theta
                         );
                         sin_theta *= sin_sign;
 
                         theta_base *= theta_scale;
 
+                        const int64_t i0 = ib*n_dims + ic/2;
+
                         const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
                               ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
 
                         const float x0 = GGML_FP16_TO_FP32(src[0]);
-                        const float x1 = GGML_FP16_TO_FP32(src[1]);
-
-                        dst_data[0] = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
-                        dst_data[1] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
-                    }
-                } else {
-                    // TODO: this might be wrong for ne0 != n_dims - need double check
-                    // ref:  https://github.com/huggingface/transformers/blob/main/src/transformers/models/gpt_neox/modeling_gpt_neox.py#LL251C1-L294C28
-                    theta_base *= freq_scale;
-                    for (int64_t ib = 0; ib < ne0/n_dims; ++ib) {
-                        for (int64_t ic = 0; ic < n_dims; ic += 2) {
-                            // simplified from `(ib * n_dims + ic) * inv_ndims`
-                            float cur_rot = inv_ndims * ic - ib;
-
-                            float cos_theta, sin_theta;
-                            rope_yarn(
-                                theta_base, freq_scale, corr_dims, cur_rot, ext_factor, attn_factor,
-                                &cos_theta, &sin_theta
-                            );
-                            sin_theta *= sin_sign;
-
-                            theta_base *= theta_scale;
-
-                            const int64_t i0 = ib*n_dims + ic/2;
-
-                            const ggml_fp16_t * const src = (ggml_fp16_t *)((char *) src0->data + i3*nb03 + i2*nb02 + i1*nb01 + i0*nb00);
-                                  ggml_fp16_t * dst_data  = (ggml_fp16_t *)((char *)  dst->data + i3*nb3  + i2*nb2  + i1*nb1  + i0*nb0);
-
-                            const float x0 = GGML_FP16_TO_FP32(src[0]);
-                            const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
+                        const float x1 = GGML_FP16_TO_FP32(src[n_dims/2]);
 
-                            dst_data[0]        = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
-                            dst_data[n_dims/2] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
-                        }
+                        dst_data[0]        = GGML_FP32_TO_FP16(x0*cos_theta - x1*sin_theta);
+                        dst_data[n_dims/2] = GGML_FP32_TO_FP16(x0*sin_theta + x1*cos_theta);
                     }
                 }
             }
@@ -11704,7 +12847,8 @@ static void ggml_compute_forward_im2col_f16(
         const struct ggml_tensor * src0,
         const struct ggml_tensor * src1,
               struct ggml_tensor * dst) {
-    GGML_ASSERT(src0->type == GGML_TYPE_F16);
+    // only the shape of the kernel is used
+    GGML_ASSERT(src0->type == GGML_TYPE_F16 || src0->type == GGML_TYPE_F32);
     GGML_ASSERT(src1->type == GGML_TYPE_F32);
     GGML_ASSERT( dst->type == GGML_TYPE_F16);
 
@@ -11720,6 +12864,8 @@ static void ggml_compute_forward_im2col_f16(
     const int32_t d0 = ((const int32_t *)(dst->op_params))[4];
     const int32_t d1 = ((const int32_t *)(dst->op_params))[5];
     const bool is_2D = ((const int32_t *)(dst->op_params))[6] == 1;
+    const bool circular = ((const int32_t *)(dst->op_params))[7] == GGML_PAD_MODE_CIRCULAR;
+    const bool wrapped  = ggml_is_wrapped_view(src1);
 
     const int ith = params->ith;
     const int nth = params->nth;
@@ -11738,7 +12884,7 @@ static void ggml_compute_forward_im2col_f16(
     int ofs0 = is_2D ? nb13 : nb12;
     int ofs1 = is_2D ? nb12 : nb11;
 
-    GGML_ASSERT(nb00 == sizeof(ggml_fp16_t));
+    GGML_ASSERT(nb00 == ggml_type_size(src0->type));
     GGML_ASSERT(nb10 == sizeof(float));
 
     if (params->type == GGML_TASK_INIT) {
@@ -11760,8 +12906,47 @@ static void ggml_compute_forward_im2col_f16(
 
                         // micro kernel
                         ggml_fp16_t * dst_data = wdata + (in*OH*OW + ioh*OW + iow)*(IC*KH*KW); // [IC, KH, KW]
+
+                        if (wrapped) {
+                            // the image is a lazy circular pad, every read goes through its source
+                            for (int64_t ikh = 0; ikh < KH; ikh++) {  // 1
+                                for (int64_t ikw = 0; ikw < KW; ikw++) {
+                                    int64_t iiw = iow*s0 + ikw*d0 - p0;
+                                    int64_t iih = ioh*s1 + ikh*d1 - p1;
+
+                                    if (circular) {
+                                        iiw = ggml_wrap_index(iiw, IW);
+                                        iih = ggml_wrap_index(iih, IH);
+                                    } else if (iih < 0 || iih >= IH || iiw < 0 || iiw >= IW) {
+                                        dst_data[iic*(KH*KW) + ikh*KW + ikw] = 0;
+                                        continue;
+                                    }
+
+                                    const float * x = is_2D
+                                        ? (const float *) ggml_wrapped_view_elem(src1, iiw, iih, iic, in)
+                                        : (const float *) ggml_wrapped_view_elem(src1, iiw, iic, in, 0);
+
+                                    dst_data[iic*(KH*KW) + ikh*KW + ikw] = GGML_FP32_TO_FP16(*x);
+                                }
+                            }
+                            continue;
+                        }
+
                         const float * const src_data = (float *)((char *) src1->data + in*ofs0 + iic*ofs1); // [IH, IW]
 
+                        if (circular) {
+                            // read the wrapped index instead of padding, no padded copy of the input is needed
+                            for (int64_t ikh = 0; ikh < KH; ikh++) {  // 1
+                                const int64_t iih = ggml_wrap_index(ioh*s1 + ikh*d1 - p1, IH);
+                                for (int64_t ikw = 0; ikw < KW; ikw++) {
+                                    const int64_t iiw = ggml_wrap_index(iow*s0 + ikw*d0 - p0, IW);
+
+                                    dst_data[iic*(KH*KW) + ikh*KW + ikw] = GGML_FP32_TO_FP16(src_data[iih*IW + iiw]);
+                                }
+                            }
+                            continue;
+                        }
+
                         for (int64_t ikh = 0; ikh < KH; ikh++) {  // 1
                             for (int64_t ikw = 0; ikw < KW; ikw++) {
                                 const int64_t iiw = iow*s0 + ikw*d0 - p0;
@@ -11788,12 +12973,9 @@ static void ggml_compute_forward_im2col(
               struct ggml_tensor * dst) {
     switch (src0->type) {
         case GGML_TYPE_F16:
-            {
-                ggml_compute_forward_im2col_f16(params, src0, src1, dst);
-            } break;
         case GGML_TYPE_F32:
             {
-                GGML_ASSERT(false);
+                ggml_compute_forward_im2col_f16(params, src0, src1, dst);
             } break;
         default:
             {
@@ -11995,8 +13177,10 @@ static void ggml_compute_forward_pool_2d(
     const int s1 = opts[4];
     const int p0 = opts[5];
     const int p1 = opts[6];
+    const bool wrapped = ggml_is_wrapped_view(src);
     const char * cdata = (const char*)src->data;
-    const char * const data_end = cdata + ggml_nbytes(src);
+    // a wrapped view only spans the tensor it wraps, its padded planes are counted in its own strides
+    const char * const data_end = cdata + (wrapped ? src->nb[3]*src->ne[3] : ggml_nbytes(src));
 
     const int64_t px = dst->ne[0];
     const int64_t py = dst->ne[1];
@@ -12008,7 +13192,7 @@ static void ggml_compute_forward_pool_2d(
     const int offset0 = -p0;
     const int offset1 = -p1;
 
-    while (cdata < data_end) {
+    for (int64_t ip = 0; cdata < data_end; ++ip) {
         for (int oy = 0; oy < py; ++oy) {
             float * const drow = dplane + oy * px;
             for (int ox = 0; ox < px; ++ox) {
@@ -12028,9 +13212,12 @@ static void ggml_compute_forward_pool_2d(
                     for (int kx = 0; kx < k0; ++kx) {
                         int j = ix + kx;
                         if (j < 0 || j >= src->ne[0]) continue;
+                        const float v = wrapped
+                            ? *(const float *) ggml_wrapped_view_elem(src, j, iy + ky, ip % src->ne[2], ip / src->ne[2])
+                            : srow[j];
                         switch (op) {
-                            case GGML_OP_POOL_AVG:                     *out += srow[j]; break;
-                            case GGML_OP_POOL_MAX: if (srow[j] > *out) *out  = srow[j]; break;
+                            case GGML_OP_POOL_AVG:                *out += v; break;
+                            case GGML_OP_POOL_MAX: if (v > *out) *out  = v; break;
                             case GGML_OP_POOL_COUNT:                GGML_ASSERT(false); break;
                         }
                     }
@@ -12066,6 +13253,7 @@ static void ggml_compute_forward_upscale_f32(
     GGML_TENSOR_UNARY_OP_LOCALS
 
     const int scale_factor = dst->op_params[0];
+    const bool wrapped = ggml_is_wrapped_view(src0);
 
     // TODO: optimize
 
@@ -12076,7 +13264,9 @@ static void ggml_compute_forward_upscale_f32(
                 for (int n = 0; n < dst->ne[0]; n++) {
                     int i00 = n / scale_factor;
 
-                    const float * x = (float *)((char *) src0->data + i00 * nb00 +i01 * nb01 + i02 * nb02 + i03 * nb03);
+                    const float * x = wrapped
+                        ? (const float *) ggml_wrapped_view_elem(src0, i00, i01, i02, i03)
+                        : (const float *)((char *) src0->data + i00 * nb00 + i01 * nb01 + i02 * nb02 + i03 * nb03);
 
                     float * y = (float *)((char *) dst->data + n * dst->nb[0] + m * dst->nb[1] + i02 * dst->nb[2] + i03 * dst->nb[3]);
 
@@ -12105,6 +13295,101 @@ static void ggml_compute_forward_upscale(
 
 // ggml_compute_forward_argsort
 
+#define GGML_SORT_RADIX (1 << GGML_SORT_RADIX_BITS)
+
+// maps a float to a key with the same order as unsigned integer, -0.0f and 0.0f share a key
+static inline uint32_t ggml_sort_key_f32(float x) {
+    uint32_t u;
+    memcpy(&u, &x, sizeof(u));
+
+    if ((u << 1) == 0) {
+        u = 0;
+    }
+
+    return (u & 0x80000000u) ? ~u : u | 0x80000000u;
+}
+
+// the threads share each row when there are fewer rows than threads and the rows are long
+static bool ggml_sort_split(int64_t ne0, int64_t nr, int nth) {
+    return nth > 1 && nr < nth && ne0 >= GGML_SORT_SPLIT;
+}
+
+// work buffer of argsort when every one of nth threads sorts whole rows
+static size_t ggml_sort_rows_size(int64_t ne0, int nth) {
+    return sizeof(uint32_t)*(3*ne0 + GGML_SORT_RADIX + CACHE_LINE_SIZE_F32)*nth;
+}
+
+// stable insertion sort of n keys and the indices that go with them
+static void ggml_sort_insertion_u32(int64_t n, uint32_t * keys, int32_t * idx) {
+    for (int64_t i = 1; i < n; ++i) {
+        const uint32_t key = keys[i];
+        const int32_t  id  = idx[i];
+
+        int64_t j = i;
+        for (; j > 0 && keys[j - 1] > key; --j) {
+            keys[j] = keys[j - 1];
+            idx[j]  = idx[j - 1];
+        }
+
+        keys[j] = key;
+        idx[j]  = id;
+    }
+}
+
+// stable sort of n keys and the indices that go with them, the sorted indices are left in idx
+// short rows are insertion sorted, the others LSD radix sorted
+// keys_tmp and idx_tmp hold n values, hist GGML_SORT_RADIX counts
+static void ggml_sort_u32(
+        int64_t    n,
+        uint32_t * keys,
+        int32_t  * idx,
+        uint32_t * keys_tmp,
+        int32_t  * idx_tmp,
+        uint32_t * hist) {
+    if (n <= GGML_SORT_INSERTION) {
+        ggml_sort_insertion_u32(n, keys, idx);
+        return;
+    }
+
+    uint32_t * src_keys = keys;
+    int32_t  * src_idx  = idx;
+    uint32_t * dst_keys = keys_tmp;
+    int32_t  * dst_idx  = idx_tmp;
+
+    for (int shift = 0; shift < 32; shift += GGML_SORT_RADIX_BITS) {
+        memset(hist, 0, GGML_SORT_RADIX*sizeof(uint32_t));
+
+        for (int64_t i = 0; i < n; ++i) {
+            hist[(src_keys[i] >> shift) & (GGML_SORT_RADIX - 1)]++;
+        }
+
+        // all the keys have the same digit, the pass would not move any of them
+        if (hist[(src_keys[0] >> shift) & (GGML_SORT_RADIX - 1)] == n) {
+            continue;
+        }
+
+        uint32_t sum = 0;
+        for (int b = 0; b < GGML_SORT_RADIX; ++b) {
+            const uint32_t c = hist[b];
+            hist[b] = sum;
+            sum += c;
+        }
+
+        for (int64_t i = 0; i < n; ++i) {
+            const uint32_t j = hist[(src_keys[i] >> shift) & (GGML_SORT_RADIX - 1)]++;
+            dst_keys[j] = src_keys[i];
+            dst_idx[j]  = src_idx[i];
+        }
+
+        uint32_t * tmp_keys = src_keys; src_keys = dst_keys; dst_keys = tmp_keys;
+        int32_t  * tmp_idx  = src_idx;  src_idx  = dst_idx;  dst_idx  = tmp_idx;
+    }
+
+    if (src_idx != idx) {
+        memcpy(idx, src_idx, n*sizeof(int32_t));
+    }
+}
+
 static void ggml_compute_forward_argsort_f32(
     const struct ggml_compute_params * params,
     const struct ggml_tensor * src0,
@@ -12116,7 +13401,7 @@ static void ggml_compute_forward_argsort_f32(
 
     GGML_TENSOR_UNARY_OP_LOCALS
 
-    GGML_ASSERT(nb0 == sizeof(float));
+    GGML_ASSERT(nb00 == sizeof(float));
 
     const int ith = params->ith;
     const int nth = params->nth;
@@ -12125,24 +13410,119 @@ static void ggml_compute_forward_argsort_f32(
 
     enum ggml_sort_order order = (enum ggml_sort_order) ggml_get_op_params_i32(dst, 0);
 
-    for (int64_t i = ith; i < nr; i += nth) {
-        int32_t * dst_data = (int32_t *)((char *) dst->data + i*nb1);
-        const float * src_data = (float *)((char *) src0->data + i*nb01);
+    // descending order sorts the complemented keys, the sort being stable equal values keep their index order
+    const uint32_t flip = order == GGML_SORT_DESC ? 0xFFFFFFFFu : 0;
+
+    // the work buffer is planned for the thread count of the graph, a dag team or a rebalanced pool can run
+    // the node with fewer threads: the rows are then shared whenever the buffers of whole rows do not fit
+    const bool split = nth > 1 && (ggml_sort_split(ne00, nr, nth) || ggml_sort_rows_size(ne00, nth) > params->wsize);
+
+    if (!split) {
+        // every thread sorts whole rows
+        uint32_t * keys     = (uint32_t *) params->wdata + ith*(3*ne00 + GGML_SORT_RADIX + CACHE_LINE_SIZE_F32);
+        uint32_t * keys_tmp = keys + ne00;
+        int32_t  * idx_tmp  = (int32_t *) (keys + 2*ne00);
+        uint32_t * hist     = keys + 3*ne00;
+
+        const int64_t dr = ggml_chunk_rows(nr, nth);
+
+        for (int64_t ic = ith; ic*dr < nr; ic = ggml_chunk_next(params, ic)) {
+            for (int64_t ir = ic*dr; ir < MIN(ic*dr + dr, nr); ++ir) {
+                const int64_t i03 = ir/(ne02*ne01);
+                const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+                const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
+
+                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+                int32_t     * y = (int32_t *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+
+                for (int64_t j = 0; j < ne00; ++j) {
+                    keys[j] = ggml_sort_key_f32(x[j]) ^ flip;
+                    y[j]    = j;
+                }
+
+                ggml_sort_u32(ne00, keys, y, keys_tmp, idx_tmp, hist);
+            }
+        }
+
+        return;
+    }
+
+    // the threads sort each row together: every pass of the radix sort counts the digits of a slice of the row
+    // per thread, the counts of all the threads place the keys of each slice after those of the smaller digits
+    // and of the same digit in the slices before it
+    uint32_t * keys[2] = { (uint32_t *) params->wdata, (uint32_t *) params->wdata + ne00 };
+    int32_t  * idx_tmp = (int32_t *) ((uint32_t *) params->wdata + 2*ne00);
+    uint32_t * hist    = (uint32_t *) params->wdata + 3*ne00;
+
+    uint32_t off[GGML_SORT_RADIX];
+
+    const int64_t dj = (ne00 + nth - 1)/nth;
+
+    const int64_t j0 = MIN(dj*ith, ne00);
+    const int64_t j1 = MIN(j0 + dj, ne00);
+
+    for (int64_t ir = 0; ir < nr; ++ir) {
+        const int64_t i03 = ir/(ne02*ne01);
+        const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+        const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
 
-        for (int64_t j = 0; j < ne0; j++) {
-            dst_data[j] = j;
+        const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+        int32_t     * y = (int32_t *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+
+        int32_t * idx[2] = { y, idx_tmp };
+
+        for (int64_t j = j0; j < j1; ++j) {
+            keys[0][j] = ggml_sort_key_f32(x[j]) ^ flip;
+            idx[0][j]  = j;
         }
 
-        // C doesn't have a functional sort, so we do a bubble sort instead
-        for (int64_t j = 0; j < ne0; j++) {
-            for (int64_t k = j + 1; k < ne0; k++) {
-                if ((order == GGML_SORT_ASC && src_data[dst_data[j]] > src_data[dst_data[k]]) ||
-                    (order == GGML_SORT_DESC && src_data[dst_data[j]] < src_data[dst_data[k]])) {
-                    int32_t tmp = dst_data[j];
-                    dst_data[j] = dst_data[k];
-                    dst_data[k] = tmp;
+        int cur = 0;
+
+        for (int shift = 0; shift < 32; shift += GGML_SORT_RADIX_BITS) {
+            uint32_t * h = hist + ith*GGML_SORT_RADIX;
+
+            memset(h, 0, GGML_SORT_RADIX*sizeof(uint32_t));
+
+            for (int64_t j = j0; j < j1; ++j) {
+                h[(keys[cur][j] >> shift) & (GGML_SORT_RADIX - 1)]++;
+            }
+
+            ggml_barrier(params);
+
+            const uint32_t d0 = (keys[cur][0] >> shift) & (GGML_SORT_RADIX - 1);
+
+            uint32_t sum = 0;
+            bool     all = false;
+
+            for (int b = 0; b < GGML_SORT_RADIX; ++b) {
+                uint32_t before = 0;
+                uint32_t total  = 0;
+                for (int t = 0; t < nth; ++t) {
+                    const uint32_t c = hist[t*GGML_SORT_RADIX + b];
+                    before += t < ith ? c : 0;
+                    total  += c;
+                }
+                off[b] = sum + before;
+                sum   += total;
+                all    = all || (b == (int) d0 && total == ne00);
+            }
+
+            // all the keys have the same digit, every thread makes the same decision
+            if (!all) {
+                for (int64_t j = j0; j < j1; ++j) {
+                    const uint32_t k = off[(keys[cur][j] >> shift) & (GGML_SORT_RADIX - 1)]++;
+                    keys[1 - cur][k] = keys[cur][j];
+                    idx [1 - cur][k] = idx [cur][j];
                 }
+                cur = 1 - cur;
             }
+
+            // the keys are placed and the counts read before the next pass
+            ggml_barrier(params);
+        }
+
+        if (cur != 0) {
+            memcpy(y + j0, idx_tmp + j0, (j1 - j0)*sizeof(int32_t));
         }
     }
 }
@@ -12164,36 +13544,194 @@ static void ggml_compute_forward_argsort(
     }
 }
 
-// ggml_compute_forward_flash_attn
+// ggml_compute_forward_top_k
 
-static void ggml_compute_forward_flash_attn_f32(
-        const struct ggml_compute_params * params,
-        const struct ggml_tensor * q,
-        const struct ggml_tensor * k,
-        const struct ggml_tensor * v,
-        const bool masked,
-        struct ggml_tensor * dst) {
-    int64_t t0 = ggml_perf_time_us();
-    UNUSED(t0);
+// the threads share each row when there are fewer rows than threads and the rows are long enough for the
+// merge of the k candidates of every thread to be cheap
+static bool ggml_top_k_split(int64_t ne0, int64_t nr, int64_t k, int nth) {
+    return ggml_sort_split(ne0, nr, nth) && 4*k*nth <= ne0;
+}
 
-    GGML_TENSOR_LOCALS(int64_t, neq, q,   ne)
-    GGML_TENSOR_LOCALS(size_t,  nbq, q,   nb)
-    GGML_TENSOR_LOCALS(int64_t, nek, k,   ne)
-    GGML_TENSOR_LOCALS(size_t,  nbk, k,   nb)
-    GGML_TENSOR_LOCALS(int64_t, nev, v,   ne)
-    GGML_TENSOR_LOCALS(size_t,  nbv, v,   nb)
-    GGML_TENSOR_LOCALS(int64_t, ne,  dst, ne)
-    GGML_TENSOR_LOCALS(size_t,  nb,  dst, nb)
+// replaces the smallest value of the min-heap of n values with c
+static inline void ggml_heap_replace_top_u64(uint64_t * heap, int64_t n, uint64_t c) {
+    int64_t i = 0;
+    for (;;) {
+        int64_t l = 2*i + 1;
+        if (l >= n) {
+            break;
+        }
+        if (l + 1 < n && heap[l + 1] < heap[l]) {
+            l++;
+        }
+        if (heap[l] >= c) {
+            break;
+        }
+        heap[i] = heap[l];
+        i = l;
+    }
+    heap[i] = c;
+}
 
-    const int ith = params->ith;
-    const int nth = params->nth;
+// keeps in the min-heap of k values the k largest values of x[j0, j1), as (key << 32 | ~j) they are ordered
+// by value and then by lower index, an all zero heap is empty
+static void ggml_top_k_heap_f32(const float * x, int64_t j0, int64_t j1, uint64_t * heap, int64_t k) {
+    for (int64_t j = j0; j < j1; ++j) {
+        const uint64_t c = (uint64_t) ggml_sort_key_f32(x[j]) << 32 | (uint32_t) ~j;
+        if (c > heap[0]) {
+            ggml_heap_replace_top_u64(heap, k, c);
+        }
+    }
+}
 
-    const int64_t D = neq0;
-    const int64_t N = neq1;
-    const int64_t P = nek1 - N;
-    const int64_t M = P + N;
+// stores the indices of the heap in y, largest first
+static void ggml_top_k_store(uint64_t * heap, int64_t k, int32_t * y) {
+    for (int64_t i = k - 1; i > 0; --i) {
+        const uint64_t c = heap[i];
+        heap[i] = heap[0];
+        ggml_heap_replace_top_u64(heap, i, c);
+    }
 
-    const int Mup = ggml_up(M, GGML_SOFT_MAX_UNROLL);
+    for (int64_t i = 0; i < k; ++i) {
+        y[i] = (int32_t) ~(uint32_t) heap[i];
+    }
+}
+
+static void ggml_compute_forward_top_k_f32(
+    const struct ggml_compute_params * params,
+    const struct ggml_tensor * src0,
+    struct ggml_tensor * dst) {
+
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
+        return;
+    }
+
+    GGML_TENSOR_UNARY_OP_LOCALS
+
+    GGML_ASSERT(nb00 == sizeof(float));
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    const int64_t nr = ggml_nrows(src0);
+    const int64_t k  = ggml_get_op_params_i32(dst, 0);
+
+    GGML_ASSERT(k == ne0 && k <= ne00);
+
+    if (!ggml_top_k_split(ne00, nr, k, nth)) {
+        // every thread selects from whole rows
+        uint64_t * heap = (uint64_t *) params->wdata + ith*(k + CACHE_LINE_SIZE/sizeof(uint64_t));
+
+        const int64_t dr = ggml_chunk_rows(nr, nth);
+
+        for (int64_t ic = ith; ic*dr < nr; ic = ggml_chunk_next(params, ic)) {
+            for (int64_t ir = ic*dr; ir < MIN(ic*dr + dr, nr); ++ir) {
+                const int64_t i03 = ir/(ne02*ne01);
+                const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+                const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
+
+                const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+                int32_t     * y = (int32_t *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+
+                memset(heap, 0, k*sizeof(uint64_t));
+
+                ggml_top_k_heap_f32(x, 0, ne00, heap, k);
+                ggml_top_k_store(heap, k, y);
+            }
+        }
+
+        return;
+    }
+
+    // every thread selects k candidates from a slice of each row, then the candidates of each row are merged
+    // by one thread
+    const int64_t dj = (ne00 + nth - 1)/nth;
+
+    const int64_t j0 = MIN(dj*ith, ne00);
+    const int64_t j1 = MIN(j0 + dj, ne00);
+
+    for (int64_t ir = 0; ir < nr; ++ir) {
+        const int64_t i03 = ir/(ne02*ne01);
+        const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+        const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
+
+        const float * x = (float *) ((char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+
+        uint64_t * heap = (uint64_t *) params->wdata + (ir*nth + ith)*k;
+
+        memset(heap, 0, k*sizeof(uint64_t));
+
+        ggml_top_k_heap_f32(x, j0, j1, heap, k);
+    }
+
+    ggml_barrier(params);
+
+    for (int64_t ir = ith; ir < nr; ir += nth) {
+        const int64_t i03 = ir/(ne02*ne01);
+        const int64_t i02 = (ir - i03*ne02*ne01)/ne01;
+        const int64_t i01 = (ir - i03*ne02*ne01 - i02*ne01);
+
+        int32_t * y = (int32_t *) ((char *) dst->data + i01*nb1 + i02*nb2 + i03*nb3);
+
+        // the heap of the first thread takes the candidates of the others
+        uint64_t * heap = (uint64_t *) params->wdata + ir*nth*k;
+
+        for (int64_t i = k; i < nth*k; ++i) {
+            if (heap[i] > heap[0]) {
+                ggml_heap_replace_top_u64(heap, k, heap[i]);
+            }
+        }
+
+        ggml_top_k_store(heap, k, y);
+    }
+}
+
+static void ggml_compute_forward_top_k(
+    const struct ggml_compute_params * params,
+    const struct ggml_tensor * src0,
+    struct ggml_tensor * dst) {
+
+    switch (src0->type) {
+        case GGML_TYPE_F32:
+            {
+                ggml_compute_forward_top_k_f32(params, src0, dst);
+            } break;
+        default:
+            {
+                GGML_ASSERT(false);
+            } break;
+    }
+}
+
+// ggml_compute_forward_flash_attn
+
+static void ggml_compute_forward_flash_attn_f32(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * q,
+        const struct ggml_tensor * k,
+        const struct ggml_tensor * v,
+        const bool masked,
+        struct ggml_tensor * dst) {
+    int64_t t0 = ggml_perf_time_us();
+    UNUSED(t0);
+
+    GGML_TENSOR_LOCALS(int64_t, neq, q,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbq, q,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nek, k,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbk, k,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nev, v,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbv, v,   nb)
+    GGML_TENSOR_LOCALS(int64_t, ne,  dst, ne)
+    GGML_TENSOR_LOCALS(size_t,  nb,  dst, nb)
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    const int64_t D = neq0;
+    const int64_t N = neq1;
+    const int64_t P = nek1 - N;
+    const int64_t M = P + N;
+
+    const int Mup = ggml_up(M, GGML_SOFT_MAX_UNROLL);
 
     GGML_ASSERT(ne0 == D);
     GGML_ASSERT(ne1 == N);
@@ -12225,6 +13763,10 @@ static void ggml_compute_forward_flash_attn_f32(
         return;
     }
 
+#ifdef GGML_FLASH_ATTN_EXP_FP16
+    const ggml_fp16_t * table_exp = ggml_table_f16_get(GGML_TABLE_EXP);
+#endif
+
     // parallelize by q rows using ggml_vec_dot_f32
 
     // total rows in q
@@ -12311,7 +13853,7 @@ static void ggml_compute_forward_flash_attn_f32(
 #else
                             ggml_fp16_t s = GGML_FP32_TO_FP16(SS[j] - max);
                             memcpy(&scvt[j], &s, sizeof(uint16_t));
-                            const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt[j]]);
+                            const float val = GGML_FP16_TO_FP32(table_exp[scvt[j]]);
 #endif
                             sump[j] += (ggml_float)val;
                             SS[j] = val;
@@ -12415,6 +13957,8 @@ static void ggml_compute_forward_flash_attn_f16(
         return;
     }
 
+    const ggml_fp16_t * table_exp = ggml_table_f16_get(GGML_TABLE_EXP);
+
     // parallelize by q rows using ggml_vec_dot_f32
 
     // total rows in q
@@ -12513,7 +14057,7 @@ static void ggml_compute_forward_flash_attn_f16(
                         } else {
                             ggml_fp16_t s = GGML_FP32_TO_FP16(SS[j] - max);
                             memcpy(&scvt[j], &s, sizeof(uint16_t));
-                            const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt[j]]);
+                            const float val = GGML_FP16_TO_FP32(table_exp[scvt[j]]);
                             sump[j] += (ggml_float)val;
                             SS[j] = val;
                         }
@@ -12605,6 +14149,206 @@ static void ggml_compute_forward_flash_attn(
     }
 }
 
+// ggml_compute_forward_flash_attn_ext
+
+static void ggml_compute_forward_flash_attn_ext_f32(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * q,
+        const struct ggml_tensor * k,
+        const struct ggml_tensor * v,
+        const struct ggml_tensor * mask,
+        struct ggml_tensor * dst) {
+    int64_t t0 = ggml_perf_time_us();
+    UNUSED(t0);
+
+    GGML_TENSOR_LOCALS(int64_t, neq, q,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbq, q,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nek, k,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbk, k,   nb)
+    GGML_TENSOR_LOCALS(int64_t, nev, v,   ne)
+    GGML_TENSOR_LOCALS(size_t,  nbv, v,   nb)
+    GGML_TENSOR_LOCALS(int64_t, ne,  dst, ne)
+    GGML_TENSOR_LOCALS(size_t,  nb,  dst, nb)
+
+    const int ith = params->ith;
+
+    const int64_t D  = neq0; // size of a head of q and k
+    const int64_t DV = nev0; // size of a head of v
+    const int64_t N  = neq1; // rows of q (tokens)
+    const int64_t M  = nek1; // rows of k and v
+
+    // k and v can be views into a KV cache, only their rows have to be contiguous
+    GGML_ASSERT(nbq0 == sizeof(float));
+    GGML_ASSERT(nbk0 == ggml_type_size(k->type));
+    GGML_ASSERT(nbv0 == ggml_type_size(v->type));
+    GGML_ASSERT(!mask || mask->nb[0] == sizeof(float));
+
+    GGML_ASSERT(ne0 == DV);
+    GGML_ASSERT(ne1 == neq2);
+    GGML_ASSERT(ne2 == N);
+    GGML_ASSERT(nb0 == sizeof(float));
+
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
+        return;
+    }
+
+    float scale    = 1.0f;
+    float max_bias = 0.0f;
+
+    memcpy(&scale,    (float *) dst->op_params + 0, sizeof(float));
+    memcpy(&max_bias, (float *) dst->op_params + 1, sizeof(float));
+
+    // broadcast factors of k and v over the heads of q (grouped-query attention)
+    const int64_t rk2 = neq2/nek2;
+    const int64_t rk3 = neq3/nek3;
+
+    // ALiBi slopes as in ggml_alibi
+    const int   n_head             = neq2;
+    const int   n_heads_log2_floor = 1 << (int) floor(log2(n_head));
+    const float m0 = powf(2.0f, -(max_bias) / n_heads_log2_floor);
+    const float m1 = powf(2.0f, -(max_bias / 2.0f) / n_heads_log2_floor);
+
+    // per thread: the rows of q in the type of k, their accumulators and the current row of v in F32
+    float * wdata = (float *) params->wdata + ith*(GGML_FLASH_ATTN_TILE*(D + DV) + DV + CACHE_LINE_SIZE_F32);
+
+    float * qw  = wdata;
+    float * acc = qw  + GGML_FLASH_ATTN_TILE*D;
+    float * vw  = acc + GGML_FLASH_ATTN_TILE*DV;
+
+    // a work item is a tile of up to GGML_FLASH_ATTN_TILE rows of q of one head: every row of k and v
+    // is read once for all of them, and the scores never leave the registers (online softmax)
+    const int64_t ntile = (N + GGML_FLASH_ATTN_TILE - 1)/GGML_FLASH_ATTN_TILE;
+    const int64_t nitem = ntile*neq2*neq3;
+
+    for (int64_t it = ith; it < nitem; it = ggml_chunk_next(params, it)) {
+        const int64_t iq3 = it/(neq2*ntile);
+        const int64_t iq2 = (it - iq3*neq2*ntile)/ntile;
+        const int64_t iq1 = (it - iq3*neq2*ntile - iq2*ntile)*GGML_FLASH_ATTN_TILE;
+        const int     nq  = MIN(GGML_FLASH_ATTN_TILE, N - iq1);
+
+        const int64_t ik2 = iq2/rk2;
+        const int64_t ik3 = iq3/rk3;
+
+        const float slope = max_bias > 0.0f
+            ? (iq2 < n_heads_log2_floor ? powf(m0, iq2 + 1) : powf(m1, 2*(iq2 - n_heads_log2_floor) + 1))
+            : 0.0f;
+
+        float S[GGML_FLASH_ATTN_TILE];  // sums of exp(s - M)
+        float Mx[GGML_FLASH_ATTN_TILE]; // largest score so far
+        float s[GGML_FLASH_ATTN_TILE];
+
+        const float * mp[GGML_FLASH_ATTN_TILE];
+
+        for (int r = 0; r < nq; ++r) {
+            const float * pq = (const float *) ((const char *) q->data + (iq1 + r)*nbq1 + iq2*nbq2 + iq3*nbq3);
+
+            if (k->type == GGML_TYPE_F16) {
+                ggml_fp32_to_fp16_row(pq, (ggml_fp16_t *) (qw + r*D), D);
+            } else {
+                memcpy(qw + r*D, pq, D*sizeof(float));
+            }
+
+            mp[r] = mask ? (const float *) ((const char *) mask->data + (iq1 + r)*mask->nb[1]) : NULL;
+
+            S[r]  = 0.0f;
+            Mx[r] = -INFINITY;
+
+            memset(acc + r*DV, 0, DV*sizeof(float));
+        }
+
+        for (int64_t ic = 0; ic < M; ++ic) {
+            char * pk = (char *) k->data + ic*nbk1 + ik2*nbk2 + ik3*nbk3;
+
+            bool any = false;
+
+            for (int r = 0; r < nq; ++r) {
+                const float mv = mp[r] ? mp[r][ic] : 0.0f;
+
+                if (mv == -INFINITY) {
+                    s[r] = -INFINITY;
+                    continue;
+                }
+
+                if (k->type == GGML_TYPE_F16) {
+                    ggml_vec_dot_f16(D, &s[r], (ggml_fp16_t *) pk, (ggml_fp16_t *) (qw + r*D));
+                } else {
+                    ggml_vec_dot_f32(D, &s[r], (const float *) pk, qw + r*D);
+                }
+
+                s[r] = s[r]*scale + mv + slope*ic;
+
+                any = true;
+            }
+
+            if (!any) {
+                continue;
+            }
+
+            const char * pv = (const char *) v->data + ic*nbv1 + ik2*nbv2 + ik3*nbv3;
+
+            const float * vf = (const float *) pv;
+            if (v->type == GGML_TYPE_F16) {
+                ggml_fp16_to_fp32_row((const ggml_fp16_t *) pv, vw, DV);
+                vf = vw;
+            }
+
+            for (int r = 0; r < nq; ++r) {
+                if (s[r] == -INFINITY) {
+                    continue;
+                }
+
+                if (s[r] > Mx[r]) {
+                    // new maximum: rescale what was accumulated so far
+                    const float ms = expf(Mx[r] - s[r]);
+
+                    if (S[r] > 0.0f) {
+                        ggml_vec_scale_f32(DV, acc + r*DV, ms);
+                    }
+                    ggml_vec_acc_f32(DV, acc + r*DV, vf);
+
+                    S[r]  = S[r]*ms + 1.0f;
+                    Mx[r] = s[r];
+                } else {
+                    const float vs = expf(s[r] - Mx[r]);
+
+                    ggml_vec_mad_f32(DV, acc + r*DV, vf, vs);
+
+                    S[r] += vs;
+                }
+            }
+        }
+
+        for (int r = 0; r < nq; ++r) {
+            float * pdst = (float *) ((char *) dst->data + iq2*nb1 + (iq1 + r)*nb2 + iq3*nb3);
+
+            // a row that is masked entirely attends to nothing
+            const float norm = S[r] > 0.0f ? 1.0f/S[r] : 0.0f;
+
+            ggml_vec_cpy_f32  (DV, pdst, acc + r*DV);
+            ggml_vec_scale_f32(DV, pdst, norm);
+        }
+    }
+}
+
+static void ggml_compute_forward_flash_attn_ext(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * q,
+        const struct ggml_tensor * k,
+        const struct ggml_tensor * v,
+        const struct ggml_tensor * mask,
+        struct ggml_tensor * dst) {
+    switch (q->type) {
+        case GGML_TYPE_F32:
+            {
+                ggml_compute_forward_flash_attn_ext_f32(params, q, k, v, mask, dst);
+            } break;
+        default:
+            {
+                GGML_ASSERT(false);
+            } break;
+    }
+}
+
 // ggml_compute_forward_flash_ff
 
 static void ggml_compute_forward_flash_ff_f16(
@@ -12834,6 +14578,10 @@ static void ggml_compute_forward_flash_attn_back_f32(
         return;
     }
 
+#ifdef GGML_FLASH_ATTN_EXP_FP16
+    const ggml_fp16_t * table_exp = ggml_table_f16_get(GGML_TABLE_EXP);
+#endif
+
     const int64_t elem_q = ggml_nelements(q);
     const int64_t elem_k = ggml_nelements(k);
 
@@ -12964,7 +14712,7 @@ static void ggml_compute_forward_flash_attn_back_f32(
 #else
                                     ggml_fp16_t s = GGML_FP32_TO_FP16(SR[j] - max);
                                     memcpy(&scvt[j], &s, sizeof(uint16_t));
-                                    const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt[j]]);
+                                    const float val = GGML_FP16_TO_FP32(table_exp[scvt[j]]);
 #endif
                                     sump[j] += (ggml_float)val;
                                     SW[j] = val;
@@ -13682,6 +15430,10 @@ static void ggml_compute_forward_cross_entropy_loss_f32(
 
     const double eps = 1e-9;
 
+#ifdef GGML_CROSS_ENTROPY_EXP_FP16
+    const ggml_fp16_t * table_exp = ggml_table_f16_get(GGML_TABLE_EXP);
+#endif
+
     // rows per thread
     const int dr = (nr + nth - 1)/nth;
 
@@ -13718,7 +15470,7 @@ static void ggml_compute_forward_cross_entropy_loss_f32(
 #else
                     ggml_fp16_t s = GGML_FP32_TO_FP16(s0[i] - max);
                     memcpy(&scvt, &s, sizeof(scvt));
-                    const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt]);
+                    const float val = GGML_FP16_TO_FP32(table_exp[scvt]);
 #endif
                     sum += (ggml_float)val;
                     st[i] = val;
@@ -13787,6 +15539,10 @@ static void ggml_compute_forward_cross_entropy_loss_back_f32(
         return;
     }
 
+#ifdef GGML_CROSS_ENTROPY_EXP_FP16
+    const ggml_fp16_t * table_exp = ggml_table_f16_get(GGML_TABLE_EXP);
+#endif
+
     const double eps = 1e-9;
 
     // TODO: handle transposed/permuted matrices
@@ -13832,7 +15588,7 @@ static void ggml_compute_forward_cross_entropy_loss_back_f32(
 #else
                     ggml_fp16_t s = GGML_FP32_TO_FP16(s0[i] - max);
                     memcpy(&scvt, &s, sizeof(scvt));
-                    const float val = GGML_FP16_TO_FP32(ggml_table_exp_f16[scvt]);
+                    const float val = GGML_FP16_TO_FP32(table_exp[scvt]);
 #endif
                     sum += (ggml_float)val;
                     ds0[i] = val;
@@ -13876,143 +15632,214 @@ static void ggml_compute_forward_cross_entropy_loss_back(
     }
 }
 
-// ggml_compute_pad_circular
+// ggml_compute_forward_pad_circular
 
-static void ggml_compute_forward_pad_circular_f16(
-        const struct ggml_compute_params * params,
-        const struct ggml_tensor * src,
-        struct ggml_tensor * dst) {
+// fills a dst row of ne0 elements (or quantization blocks) of size ts from a src row of ne00 elements
+// shifted left by lp0, wrapping around
+// the row is written as a few contiguous segments: left halo, interior, right halo
+static void ggml_pad_circular_row(
+        char       * dst,
+        const char * src,
+        int64_t      ne0,
+        int64_t      ne00,
+        int64_t      lp0,
+        size_t       ts) {
+    int64_t i0  = 0;
+    int64_t i00 = ggml_wrap_index(-lp0, ne00);
 
-    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
-        return;
+    while (i0 < ne0) {
+        const int64_t n = MIN(ne00 - i00, ne0 - i0);
+        memcpy(dst + i0*ts, src + i00*ts, n*ts);
+        i0 += n;
+        i00 = 0;
     }
-    const int padding = dst->op_params[0];
-    const int ith = params->ith;
-    const int nth = params->nth;
+}
+
+// writes rows [ir0, ir1) of dst, the circular padding of src0 by pads
+static void ggml_pad_circular_rows(
+        const struct ggml_tensor * src0,
+        struct ggml_tensor       * dst,
+        const int32_t            * pads,
+        int64_t                    ir0,
+        int64_t                    ir1) {
+
+    GGML_TENSOR_UNARY_OP_LOCALS
 
-    ggml_fp16_t * src_data = (ggml_fp16_t *) src->data;
-    ggml_fp16_t * dst_data = (ggml_fp16_t *) dst->data;
+    // quantized rows are copied block by block: ne0 is handled in units of blocks,
+    // ggml_pad_circular_impl guarantees that the ne0 padding is block-aligned
+    const size_t  ts = ggml_type_size(src0->type);
+    const int64_t bs = ggml_blck_size(src0->type);
 
-    const int64_t orig_height = src->ne[0];
-    const int64_t orig_width = src->ne[1];
-    const int64_t new_height = orig_height + 2 * padding;
-    const int64_t new_width = orig_width + 2 * padding;
+    GGML_ASSERT(nb0 == ts);
+    GGML_ASSERT(pads[0] % bs == 0);
 
-    int64_t total_elements = new_height * new_width;
-    int64_t start_index = ith * (total_elements / nth);
-    int64_t end_index = (ith + 1) == nth ? total_elements : (ith + 1) * (total_elements / nth);
+    const int64_t nb_dst = ne0/bs;
+    const int64_t nb_src = ne00/bs;
+    const int64_t lb0    = pads[0]/bs;
 
-    for (int64_t idx = start_index; idx < end_index; ++idx) {
-        int64_t i = idx / new_width;
-        int64_t j = idx % new_width;
+    for (int64_t ir = ir0; ir < ir1; ++ir) {
+        const int64_t i3 = ir/(ne2*ne1);
+        const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+        const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
 
-        int64_t orig_i = (i - padding + orig_height) % orig_height;
-        int64_t orig_j = (j - padding + orig_width) % orig_width;
+        const int64_t i03 = ggml_wrap_index(i3 - pads[6], ne03);
+        const int64_t i02 = ggml_wrap_index(i2 - pads[4], ne02);
+        const int64_t i01 = ggml_wrap_index(i1 - pads[2], ne01);
 
-        dst_data[i * new_width + j] = src_data[orig_i * orig_width + orig_j];
+        const char * src_row = (const char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03;
+              char * dst_row = (char *)        dst->data  + i1*nb1   + i2*nb2   + i3*nb3;
+
+        if (nb00 == ts) {
+            ggml_pad_circular_row(dst_row, src_row, nb_dst, nb_src, lb0, ts);
+        } else {
+            int64_t i00 = ggml_wrap_index(-lb0, nb_src);
+            for (int64_t i0 = 0; i0 < nb_dst; ++i0) {
+                memcpy(dst_row + i0*ts, src_row + i00*nb00, ts);
+                if (++i00 == nb_src) {
+                    i00 = 0;
+                }
+            }
+        }
     }
 }
 
-static void ggml_compute_forward_pad_circular_f32(
+static void ggml_compute_forward_pad_circular_rows(
         const struct ggml_compute_params * params,
-        const struct ggml_tensor * src,
+        const struct ggml_tensor * src0,
         struct ggml_tensor * dst) {
 
     if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
         return;
     }
 
-    const int padding = dst->op_params[0];
+    // a lazy view is resolved by its consumers
+    if (ggml_is_wrapped_view(dst)) {
+        return;
+    }
+
     const int ith = params->ith;
     const int nth = params->nth;
 
-    const int64_t orig_height = src->ne[0];
-    const int64_t orig_width = src->ne[1];
-    const int64_t new_height = orig_height + 2 * padding;
-    const int64_t new_width = orig_width + 2 * padding;
+    // rows per thread
+    const int64_t nr = ggml_nrows(dst);
+    const int64_t dr = (nr + nth - 1)/nth;
 
-    float * src_data = (float *) src->data;
-    float * dst_data = (float *) dst->data;
+    // row range for this thread
+    const int64_t ir0 = dr*ith;
+    const int64_t ir1 = MIN(ir0 + dr, nr);
 
-    int64_t total_elements = new_height * new_width;
-    int64_t start_index = ith * (total_elements / nth);
-    int64_t end_index = (ith + 1) == nth ? total_elements : (ith + 1) * (total_elements / nth);
+    ggml_pad_circular_rows(src0, dst, (const int32_t *) dst->op_params, ir0, ir1);
+}
 
-    for (int64_t idx = start_index; idx < end_index; ++idx) {
-        int64_t i = idx / new_width;
-        int64_t j = idx % new_width;
+// ggml_compute_forward_pad_circular_back
 
-        int64_t orig_i = (i - padding + orig_height) % orig_height;
-        int64_t orig_j = (j - padding + orig_width) % orig_width;
+// accumulates a padded row of ne0 elements onto a dst row of ne00 elements, wrapping around
+static void ggml_pad_circular_back_row(
+        float       * dst,
+        const float * src,
+        int64_t       ne0,
+        int64_t       ne00,
+        int64_t       lp0) {
+    int64_t i0  = 0;
+    int64_t i00 = ggml_wrap_index(-lp0, ne00);
 
-        dst_data[i * new_width + j] = src_data[orig_i * orig_width + orig_j];
+    while (i0 < ne0) {
+        const int n = (int) MIN(ne00 - i00, ne0 - i0);
+        ggml_vec_acc_f32(n, dst + i00, src + i0);
+        i0 += n;
+        i00 = 0;
     }
 }
 
-// TODO: Make sure this works i am not familiar with quantization.
-static void ggml_compute_forward_pad_circular_q_f32(
+static void ggml_compute_forward_pad_circular_back_f32(
         const struct ggml_compute_params * params,
-        const struct ggml_tensor * src,
+        const struct ggml_tensor * src0,
         struct ggml_tensor * dst) {
 
     if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
         return;
     }
 
-    const int padding = dst->op_params[0];
     const int ith = params->ith;
     const int nth = params->nth;
 
-    const int64_t orig_height = src->ne[0];
-    const int64_t orig_width = src->ne[1];
-    const int64_t new_height = orig_height + 2 * padding;
-    const int64_t new_width = orig_width + 2 * padding;
-
-    float * src_data = (float *) src->data;
-    float * dst_data = (float *) dst->data;
+    GGML_TENSOR_UNARY_OP_LOCALS
 
-    int64_t total_elements = new_height * new_width;
-    int64_t start_index = ith * (total_elements / nth);
-    int64_t end_index = (ith + 1) == nth ? total_elements : (ith + 1) * (total_elements / nth);
+    const int32_t * pads = (const int32_t *) dst->op_params;
 
-    for (int64_t idx = start_index; idx < end_index; ++idx) {
-        int64_t i = idx / new_width;
-        int64_t j = idx % new_width;
+    GGML_ASSERT(nb00 == sizeof(float));
+    GGML_ASSERT(nb0  == sizeof(float));
 
-        int64_t orig_i = (i - padding + orig_height) % orig_height;
-        int64_t orig_j = (j - padding + orig_width) % orig_width;
+    // each thread owns a disjoint set of dst rows and gathers every padded row that wraps onto it,
+    // so no synchronization between threads is needed
+    const int64_t nr = ne1*ne2*ne3;
+    const int64_t dr = (nr + nth - 1)/nth;
 
-        dst_data[i * new_width + j] = src_data[orig_i * orig_width + orig_j];
-    }
+    const int64_t ir0 = dr*ith;
+    const int64_t ir1 = MIN(ir0 + dr, nr);
 
-}
+    for (int64_t ir = ir0; ir < ir1; ++ir) {
+        const int64_t i3 = ir/(ne2*ne1);
+        const int64_t i2 = (ir - i3*ne2*ne1)/ne1;
+        const int64_t i1 = (ir - i3*ne2*ne1 - i2*ne1);
 
-static void ggml_compute_forward_pad_circular(
-        const struct ggml_compute_params * params,
-        const struct ggml_tensor * src,
-        struct ggml_tensor * dst) {
+        float * dst_row = (float *) ((char *) dst->data + i1*nb1 + i2*nb2 + i3*nb3);
 
-    int padding = dst->op_params[0];
+        ggml_vec_set_f32(ne0, dst_row, 0.0f);
+
+        // first padded index along each dim that maps onto (i1, i2, i3), then every period after it
+        for (int64_t i03 = ggml_wrap_index(i3 + pads[6], ne3); i03 < ne03; i03 += ne3) {
+            for (int64_t i02 = ggml_wrap_index(i2 + pads[4], ne2); i02 < ne02; i02 += ne2) {
+                for (int64_t i01 = ggml_wrap_index(i1 + pads[2], ne1); i01 < ne01; i01 += ne1) {
+                    const float * src_row = (const float *) ((const char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03);
+                    ggml_pad_circular_back_row(dst_row, src_row, ne00, ne0, pads[0]);
+                }
+            }
+        }
+    }
+}
+
+static void ggml_compute_forward_pad_circular_back(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src0,
+        struct ggml_tensor * dst) {
+    switch (src0->type) {
+        case GGML_TYPE_F32:
+            {
+                ggml_compute_forward_pad_circular_back_f32(params, src0, dst);
+            } break;
+        default:
+            {
+                GGML_ASSERT(false);
+            } break;
+    }
+}
+
+static void ggml_compute_forward_pad_circular(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src,
+        struct ggml_tensor * dst) {
 
     switch (src->type) {
         case GGML_TYPE_F32:
-            ggml_compute_forward_pad_circular_f32(params, src, dst);
-            break;
         case GGML_TYPE_F16:
-            ggml_compute_forward_pad_circular_f16(params, src, dst);
-            break;
+        case GGML_TYPE_I8:
+        case GGML_TYPE_I16:
+        case GGML_TYPE_I32:
         case GGML_TYPE_Q4_0:
         case GGML_TYPE_Q4_1:
         case GGML_TYPE_Q5_0:
         case GGML_TYPE_Q5_1:
         case GGML_TYPE_Q8_0:
+        case GGML_TYPE_Q8_1:
         case GGML_TYPE_Q2_K:
         case GGML_TYPE_Q3_K:
         case GGML_TYPE_Q4_K:
         case GGML_TYPE_Q5_K:
         case GGML_TYPE_Q6_K:
+        case GGML_TYPE_Q8_K:
             {
-                ggml_compute_forward_pad_circular_q_f32(params, src,dst);
+                ggml_compute_forward_pad_circular_rows(params, src, dst);
             } break;
         default:
             {
@@ -14021,6 +15848,500 @@ static void ggml_compute_forward_pad_circular(
     }
 }
 
+// unary op on a ggml_pad_circular_view: every thread materializes its rows of the padded input
+// directly in dst and applies the op in place on them, so no padded copy of the input is kept
+static void ggml_compute_forward_unary_wrapped(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src0,
+        struct ggml_tensor * dst) {
+    GGML_ASSERT(ggml_is_contiguous(dst) && ggml_are_same_shape(src0, dst));
+
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
+        return;
+    }
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    // rows per thread
+    const int64_t nr = ggml_nrows(dst);
+    const int64_t dr = (nr + nth - 1)/nth;
+
+    // row range for this thread
+    const int64_t ir0 = dr*ith;
+    const int64_t ir1 = MIN(ir0 + dr, nr);
+
+    if (ir0 >= ir1) {
+        return;
+    }
+
+    ggml_pad_circular_rows(src0->src[0], dst, (const int32_t *) src0->op_params, ir0, ir1);
+
+    // the rows of this thread as a standalone 2d tensor, processed by a single task
+    struct ggml_tensor rows = *dst;
+    rows.data  = (char *) dst->data + ir0*dst->nb[1];
+    rows.ne[1] = ir1 - ir0;
+    rows.ne[2] = 1;
+    rows.ne[3] = 1;
+    rows.nb[2] = rows.nb[1]*rows.ne[1];
+    rows.nb[3] = rows.nb[2];
+
+    struct ggml_compute_params_sched params_rows = *ggml_compute_params_sched_of(params);
+    params_rows.params.ith = 0;
+    params_rows.params.nth = 1;
+
+    ggml_compute_forward_unary(&params_rows.params, &rows, &rows);
+}
+
+// ggml_fft
+
+// complex-to-complex FFT plans, created on first use and cached until ggml_fft_plans_free or the process exit
+// power-of-2 sizes use an iterative radix-2 transform, other sizes use Bluestein's algorithm on top of it
+// complex values are stored as interleaved (re, im) float pairs
+
+struct ggml_fft_plan {
+    int64_t   n;         // transform size
+    int64_t   m;         // size of the underlying radix-2 transform
+    float   * twiddle;   // m/2 roots of unity exp(-2*pi*i*k/m)
+    int32_t * rev;       // bit-reversal permutation of [0, m)
+    float   * chirp;     // Bluestein only: exp(-pi*i*k^2/n) for k in [0, n)
+    float   * chirp_fft; // Bluestein only: radix-2 transform of the conjugated chirp filter
+};
+
+// the plans are allocated one by one so that the pointers handed out stay valid when the array grows
+static struct ggml_fft_plan ** g_fft_plans     = NULL;
+static int                     g_fft_n_plans   = 0;
+static int                     g_fft_plans_cap = 0;
+
+static bool ggml_fft_is_pow2(int64_t n) {
+    return (n & (n - 1)) == 0;
+}
+
+// size of the radix-2 transform used for a transform of size n
+static int64_t ggml_fft_size_internal(int64_t n) {
+    if (ggml_fft_is_pow2(n)) {
+        return n;
+    }
+
+    int64_t m = 1;
+    while (m < 2*n - 1) {
+        m <<= 1;
+    }
+    return m;
+}
+
+static void ggml_fft_radix2(const struct ggml_fft_plan * plan, float * x) {
+    const int64_t m = plan->m;
+
+    for (int64_t i = 0; i < m; ++i) {
+        const int64_t j = plan->rev[i];
+        if (i < j) {
+            const float re = x[2*i + 0];
+            const float im = x[2*i + 1];
+            x[2*i + 0] = x[2*j + 0];
+            x[2*i + 1] = x[2*j + 1];
+            x[2*j + 0] = re;
+            x[2*j + 1] = im;
+        }
+    }
+
+    for (int64_t len = 2; len <= m; len <<= 1) {
+        const int64_t half = len/2;
+        const int64_t step = m/len;
+
+        for (int64_t i = 0; i < m; i += len) {
+            for (int64_t k = 0; k < half; ++k) {
+                const float wr = plan->twiddle[2*k*step + 0];
+                const float wi = plan->twiddle[2*k*step + 1];
+
+                float * a = x + 2*(i + k);
+                float * b = x + 2*(i + k + half);
+
+                const float tr = b[0]*wr - b[1]*wi;
+                const float ti = b[0]*wi + b[1]*wr;
+
+                b[0] = a[0] - tr;
+                b[1] = a[1] - ti;
+                a[0] = a[0] + tr;
+                a[1] = a[1] + ti;
+            }
+        }
+    }
+}
+
+static void ggml_fft_conj(int64_t n, float * x) {
+    for (int64_t i = 0; i < n; ++i) {
+        x[2*i + 1] = -x[2*i + 1];
+    }
+}
+
+static void ggml_fft_plan_init(struct ggml_fft_plan * plan, int64_t n) {
+    const int64_t m = ggml_fft_size_internal(n);
+
+    plan->n         = n;
+    plan->m         = m;
+    plan->twiddle   = malloc(sizeof(float)*MAX(m, 2));
+    plan->rev       = malloc(sizeof(int32_t)*m);
+    plan->chirp     = NULL;
+    plan->chirp_fft = NULL;
+
+    for (int64_t k = 0; k < m/2; ++k) {
+        const double angle = -2.0*M_PI*(double) k/(double) m;
+        plan->twiddle[2*k + 0] = (float) cos(angle);
+        plan->twiddle[2*k + 1] = (float) sin(angle);
+    }
+
+    int log2m = 0;
+    while (((int64_t) 1 << log2m) < m) {
+        log2m++;
+    }
+    for (int64_t i = 0; i < m; ++i) {
+        int32_t r = 0;
+        for (int b = 0; b < log2m; ++b) {
+            r |= ((i >> b) & 1) << (log2m - 1 - b);
+        }
+        plan->rev[i] = r;
+    }
+
+    if (m == n) {
+        return;
+    }
+
+    plan->chirp     = malloc(sizeof(float)*2*n);
+    plan->chirp_fft = calloc(2*m, sizeof(float));
+
+    for (int64_t k = 0; k < n; ++k) {
+        // k^2 mod 2n keeps the angle small and accurate for large k
+        const double angle = -M_PI*(double) ((k*k) % (2*n))/(double) n;
+        plan->chirp[2*k + 0] = (float) cos(angle);
+        plan->chirp[2*k + 1] = (float) sin(angle);
+    }
+
+    // the convolution filter conj(chirp[l]) for l in (-n, n), stored circularly
+    for (int64_t k = 0; k < n; ++k) {
+        plan->chirp_fft[2*k + 0] =  plan->chirp[2*k + 0];
+        plan->chirp_fft[2*k + 1] = -plan->chirp[2*k + 1];
+        if (k > 0) {
+            plan->chirp_fft[2*(m - k) + 0] =  plan->chirp[2*k + 0];
+            plan->chirp_fft[2*(m - k) + 1] = -plan->chirp[2*k + 1];
+        }
+    }
+    ggml_fft_radix2(plan, plan->chirp_fft);
+}
+
+static const struct ggml_fft_plan * ggml_fft_plan_get(int64_t n) {
+    struct ggml_fft_plan * plan = NULL;
+
+    ggml_critical_section_start();
+
+    for (int i = 0; i < g_fft_n_plans; ++i) {
+        if (g_fft_plans[i]->n == n) {
+            plan = g_fft_plans[i];
+            break;
+        }
+    }
+
+    if (plan == NULL) {
+        static bool registered = false;
+        if (!registered) {
+            atexit(ggml_fft_plans_free);
+            registered = true;
+        }
+
+        if (g_fft_n_plans == g_fft_plans_cap) {
+            g_fft_plans_cap = MAX(2*g_fft_plans_cap, 16);
+            g_fft_plans = realloc(g_fft_plans, sizeof(struct ggml_fft_plan *)*g_fft_plans_cap);
+            GGML_ASSERT(g_fft_plans != NULL);
+        }
+
+        plan = malloc(sizeof(struct ggml_fft_plan));
+        GGML_ASSERT(plan != NULL);
+        ggml_fft_plan_init(plan, n);
+        g_fft_plans[g_fft_n_plans++] = plan;
+    }
+
+    ggml_critical_section_end();
+
+    return plan;
+}
+
+void ggml_fft_plans_free(void) {
+    ggml_critical_section_start();
+
+    for (int i = 0; i < g_fft_n_plans; ++i) {
+        free(g_fft_plans[i]->twiddle);
+        free(g_fft_plans[i]->rev);
+        free(g_fft_plans[i]->chirp);
+        free(g_fft_plans[i]->chirp_fft);
+        free(g_fft_plans[i]);
+    }
+
+    free(g_fft_plans);
+
+    g_fft_plans     = NULL;
+    g_fft_n_plans   = 0;
+    g_fft_plans_cap = 0;
+
+    ggml_critical_section_end();
+}
+
+// in-place forward transform of n complex values
+// scratch must hold 2*m floats when n is not a power of 2
+static void ggml_fft_forward(const struct ggml_fft_plan * plan, float * x, float * scratch) {
+    if (plan->chirp == NULL) {
+        ggml_fft_radix2(plan, x);
+        return;
+    }
+
+    const int64_t n = plan->n;
+    const int64_t m = plan->m;
+
+    const float * c = plan->chirp;
+    const float * f = plan->chirp_fft;
+
+    float * a = scratch;
+
+    for (int64_t k = 0; k < n; ++k) {
+        a[2*k + 0] = x[2*k + 0]*c[2*k + 0] - x[2*k + 1]*c[2*k + 1];
+        a[2*k + 1] = x[2*k + 0]*c[2*k + 1] + x[2*k + 1]*c[2*k + 0];
+    }
+    memset(a + 2*n, 0, sizeof(float)*2*(m - n));
+
+    ggml_fft_radix2(plan, a);
+
+    // multiply with the filter spectrum and transform back; the conjugates turn the forward radix-2 into an inverse
+    for (int64_t k = 0; k < m; ++k) {
+        const float re = a[2*k + 0]*f[2*k + 0] - a[2*k + 1]*f[2*k + 1];
+        const float im = a[2*k + 0]*f[2*k + 1] + a[2*k + 1]*f[2*k + 0];
+        a[2*k + 0] =  re;
+        a[2*k + 1] = -im;
+    }
+
+    ggml_fft_radix2(plan, a);
+
+    const float scale = 1.0f/(float) m;
+
+    for (int64_t k = 0; k < n; ++k) {
+        const float re =  a[2*k + 0]*scale;
+        const float im = -a[2*k + 1]*scale;
+        x[2*k + 0] = re*c[2*k + 0] - im*c[2*k + 1];
+        x[2*k + 1] = re*c[2*k + 1] + im*c[2*k + 0];
+    }
+}
+
+// in-place unnormalized inverse transform of n complex values
+static void ggml_fft_inverse(const struct ggml_fft_plan * plan, float * x, float * scratch) {
+    ggml_fft_conj(plan->n, x);
+    ggml_fft_forward(plan, x, scratch);
+    ggml_fft_conj(plan->n, x);
+}
+
+// per-thread scratch, in floats, for a real 2D transform of a W x H grid
+static size_t ggml_rfft_2d_scratch_size(int64_t W, int64_t H) {
+    return 2*MAX(W, H) + 2*MAX(ggml_fft_size_internal(W), ggml_fft_size_internal(H));
+}
+
+// forward transform of a real H x W grid into H rows of W/2 + 1 complex values
+static void ggml_rfft_2d(
+        const struct ggml_fft_plan * pw,
+        const struct ggml_fft_plan * ph,
+        const float * src,
+        float       * dst,
+        float       * scratch) {
+    const int64_t W  = pw->n;
+    const int64_t H  = ph->n;
+    const int64_t nc = W/2 + 1;
+
+    float * buf = scratch;
+    float * tmp = scratch + 2*MAX(W, H);
+
+    for (int64_t y = 0; y < H; ++y) {
+        for (int64_t x = 0; x < W; ++x) {
+            buf[2*x + 0] = src[y*W + x];
+            buf[2*x + 1] = 0.0f;
+        }
+        ggml_fft_forward(pw, buf, tmp);
+        memcpy(dst + 2*y*nc, buf, sizeof(float)*2*nc);
+    }
+
+    for (int64_t c = 0; c < nc; ++c) {
+        for (int64_t y = 0; y < H; ++y) {
+            buf[2*y + 0] = dst[2*(y*nc + c) + 0];
+            buf[2*y + 1] = dst[2*(y*nc + c) + 1];
+        }
+        ggml_fft_forward(ph, buf, tmp);
+        for (int64_t y = 0; y < H; ++y) {
+            dst[2*(y*nc + c) + 0] = buf[2*y + 0];
+            dst[2*(y*nc + c) + 1] = buf[2*y + 1];
+        }
+    }
+}
+
+// inverse of ggml_rfft_2d, normalized; src is overwritten
+static void ggml_irfft_2d(
+        const struct ggml_fft_plan * pw,
+        const struct ggml_fft_plan * ph,
+        float       * src,
+        float       * dst,
+        float       * scratch) {
+    const int64_t W  = pw->n;
+    const int64_t H  = ph->n;
+    const int64_t nc = W/2 + 1;
+
+    float * buf = scratch;
+    float * tmp = scratch + 2*MAX(W, H);
+
+    for (int64_t c = 0; c < nc; ++c) {
+        for (int64_t y = 0; y < H; ++y) {
+            buf[2*y + 0] = src[2*(y*nc + c) + 0];
+            buf[2*y + 1] = src[2*(y*nc + c) + 1];
+        }
+        ggml_fft_inverse(ph, buf, tmp);
+        for (int64_t y = 0; y < H; ++y) {
+            src[2*(y*nc + c) + 0] = buf[2*y + 0];
+            src[2*(y*nc + c) + 1] = buf[2*y + 1];
+        }
+    }
+
+    const float scale = 1.0f/(float) (W*H);
+
+    for (int64_t y = 0; y < H; ++y) {
+        // each row is now the spectrum of a real signal: restore the upper half by Hermitian symmetry
+        memcpy(buf, src + 2*y*nc, sizeof(float)*2*nc);
+        for (int64_t x = nc; x < W; ++x) {
+            buf[2*x + 0] =  buf[2*(W - x) + 0];
+            buf[2*x + 1] = -buf[2*(W - x) + 1];
+        }
+        ggml_fft_inverse(pw, buf, tmp);
+        for (int64_t x = 0; x < W; ++x) {
+            dst[y*W + x] = buf[2*x + 0]*scale;
+        }
+    }
+}
+
+// ggml_compute_forward_rfft_2d
+
+static void ggml_compute_forward_rfft_2d(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src0,
+        struct ggml_tensor * dst) {
+    GGML_ASSERT(src0->type == GGML_TYPE_F32 || src0->type == GGML_TYPE_F16);
+
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
+        return;
+    }
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    GGML_TENSOR_UNARY_OP_LOCALS
+
+    const int32_t W  = ((const int32_t *)(dst->op_params))[0];
+    const int32_t s0 = ((const int32_t *)(dst->op_params))[1];
+    const int32_t s1 = ((const int32_t *)(dst->op_params))[2];
+    const int64_t H  = ne1;
+
+    const struct ggml_fft_plan * pw = ggml_fft_plan_get(W);
+    const struct ggml_fft_plan * ph = ggml_fft_plan_get(H);
+
+    float * grid    = (float *) params->wdata + ith*(W*H + ggml_rfft_2d_scratch_size(W, H) + CACHE_LINE_SIZE_F32);
+    float * scratch = grid + W*H;
+
+    // one channel per task
+    for (int64_t ic = ith; ic < ne02*ne03; ic += nth) {
+        const int64_t i03 = ic/ne02;
+        const int64_t i02 = ic - i03*ne02;
+
+        // place the source into the periodic W x H grid shifted by (s0, s1), summing the wrapped parts
+        memset(grid, 0, sizeof(float)*W*H);
+
+        for (int64_t i01 = 0; i01 < ne01; ++i01) {
+            const char * src_row = (const char *) src0->data + i01*nb01 + i02*nb02 + i03*nb03;
+
+            float * grid_row = grid + ggml_wrap_index(i01 + s1, H)*W;
+
+            int64_t x = ggml_wrap_index(s0, W);
+            for (int64_t i00 = 0; i00 < ne00; ++i00) {
+                if (src0->type == GGML_TYPE_F32) {
+                    grid_row[x] += *(const float *) (src_row + i00*nb00);
+                } else {
+                    grid_row[x] += GGML_FP16_TO_FP32(*(const ggml_fp16_t *) (src_row + i00*nb00));
+                }
+                if (++x == W) {
+                    x = 0;
+                }
+            }
+        }
+
+        float * dst_data = (float *) ((char *) dst->data + i02*nb2 + i03*nb3);
+
+        ggml_rfft_2d(pw, ph, grid, dst_data, scratch);
+    }
+}
+
+// ggml_compute_forward_conv_2d_circular
+
+static void ggml_compute_forward_conv_2d_circular(
+        const struct ggml_compute_params * params,
+        const struct ggml_tensor * src0,
+        const struct ggml_tensor * src1,
+        struct ggml_tensor * dst) {
+    GGML_ASSERT(src0->type == GGML_TYPE_F32);
+    GGML_ASSERT(src1->type == GGML_TYPE_F32);
+
+    if (params->type == GGML_TASK_INIT || params->type == GGML_TASK_FINALIZE) {
+        return;
+    }
+
+    const int ith = params->ith;
+    const int nth = params->nth;
+
+    GGML_TENSOR_BINARY_OP_LOCALS
+
+    const int32_t W  = ((const int32_t *)(dst->op_params))[0];
+    const int64_t H  = ne01;
+    const int64_t nc = W/2 + 1;
+
+    const int64_t IC = ne02;
+    const int64_t OC = ne03;
+
+    GGML_ASSERT(ne10 == 2*nc && ne11 == H && ne12 == IC);
+
+    const struct ggml_fft_plan * pw = ggml_fft_plan_get(W);
+    const struct ggml_fft_plan * ph = ggml_fft_plan_get(H);
+
+    float * acc     = (float *) params->wdata + ith*(2*nc*H + W*H + ggml_rfft_2d_scratch_size(W, H) + CACHE_LINE_SIZE_F32);
+    float * grid    = acc  + 2*nc*H;
+    float * scratch = grid + W*H;
+
+    // one (output channel, batch) pair per task
+    for (int64_t ip = ith; ip < OC*ne13; ip += nth) {
+        const int64_t in = ip/OC;
+        const int64_t oc = ip - in*OC;
+
+        // correlation theorem: sum over input channels of X * conj(K)
+        memset(acc, 0, sizeof(float)*2*nc*H);
+
+        for (int64_t ic = 0; ic < IC; ++ic) {
+            const float * k = (const float *) ((const char *) src0->data + ic*nb02 + oc*nb03);
+            const float * x = (const float *) ((const char *) src1->data + ic*nb12 + in*nb13);
+
+            for (int64_t i = 0; i < nc*H; ++i) {
+                acc[2*i + 0] += x[2*i + 0]*k[2*i + 0] + x[2*i + 1]*k[2*i + 1];
+                acc[2*i + 1] += x[2*i + 1]*k[2*i + 0] - x[2*i + 0]*k[2*i + 1];
+            }
+        }
+
+        ggml_irfft_2d(pw, ph, acc, grid, scratch);
+
+        // the result is periodic with period (W, H)
+        for (int64_t i1 = 0; i1 < ne1; ++i1) {
+            char * dst_row = (char *) dst->data + i1*nb1 + oc*nb2 + in*nb3;
+            ggml_pad_circular_row(dst_row, (const char *) (grid + (i1 % H)*W), ne0, W, 0, sizeof(float));
+        }
+    }
+}
+
 
 /////////////////////////////////
 
@@ -14040,6 +16361,13 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
     GGML_ASSERT(tensor->src[1] == NULL || tensor->src[1]->backend == GGML_BACKEND_CPU);
 #endif // GGML_USE_CUBLAS
 
+    // the interleaved rows of a repacked tensor are only understood by the matrix multiplication
+    for (int i = 0; i < GGML_MAX_SRC; ++i) {
+        if (tensor->src[i] && (tensor->src[i]->flags & GGML_TENSOR_FLAG_REPACKED)) {
+            GGML_ASSERT((tensor->op == GGML_OP_MUL_MAT && i == 0) || (tensor->op == GGML_OP_MUL_MAT_ID && i >= 2));
+        }
+    }
+
     switch (tensor->op) {
         case GGML_OP_DUP:
             {
@@ -14195,7 +16523,7 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
             } break;
         case GGML_OP_SOFT_MAX:
             {
-                ggml_compute_forward_soft_max(params, tensor->src[0], tensor);
+                ggml_compute_forward_soft_max(params, tensor->src[0], tensor->src[1], tensor);
             } break;
         case GGML_OP_SOFT_MAX_BACK:
             {
@@ -14245,6 +16573,10 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
             {
                 ggml_compute_forward_argsort(params, tensor->src[0], tensor);
             } break;
+        case GGML_OP_TOP_K:
+            {
+                ggml_compute_forward_top_k(params, tensor->src[0], tensor);
+            } break;
         case GGML_OP_FLASH_ATTN:
             {
                 const int32_t t = ggml_get_op_params_i32(tensor, 0);
@@ -14252,6 +16584,10 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
                 const bool masked = t != 0;
                 ggml_compute_forward_flash_attn(params, tensor->src[0], tensor->src[1], tensor->src[2], masked, tensor);
             } break;
+        case GGML_OP_FLASH_ATTN_EXT:
+            {
+                ggml_compute_forward_flash_attn_ext(params, tensor->src[0], tensor->src[1], tensor->src[2], tensor->src[3], tensor);
+            } break;
         case GGML_OP_FLASH_FF:
             {
                 ggml_compute_forward_flash_ff(params, tensor->src[0], tensor->src[1], tensor->src[2], tensor->src[3], tensor->src[4], tensor);
@@ -14273,7 +16609,11 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
             } break;
         case GGML_OP_UNARY:
             {
-                ggml_compute_forward_unary(params, tensor->src[0], tensor);
+                if (ggml_is_wrapped_view(tensor->src[0])) {
+                    ggml_compute_forward_unary_wrapped(params, tensor->src[0], tensor);
+                } else {
+                    ggml_compute_forward_unary(params, tensor->src[0], tensor);
+                }
             } break;
         case GGML_OP_GET_REL_POS:
             {
@@ -14346,17 +16686,28 @@ static void ggml_compute_forward(struct ggml_compute_params * params, struct ggm
         case GGML_OP_PAD_CIRCULAR:
             {
                 ggml_compute_forward_pad_circular(params, tensor->src[0], tensor);
-            }
-            break;
-        case GGML_OP_NONE:
+            } break;
+        case GGML_OP_PAD_CIRCULAR_BACK:
             {
-                // nop
+                ggml_compute_forward_pad_circular_back(params, tensor->src[0], tensor);
             } break;
-        case GGML_OP_COUNT:
+        case GGML_OP_RFFT_2D:
             {
-                GGML_ASSERT(false);
+                ggml_compute_forward_rfft_2d(params, tensor->src[0], tensor);
             } break;
-    }
+        case GGML_OP_CONV_2D_CIRCULAR:
+            {
+                ggml_compute_forward_conv_2d_circular(params, tensor->src[0], tensor->src[1], tensor);
+            } break;
+        case GGML_OP_NONE:
+            {
+                // nop
+            } break;
+        case GGML_OP_COUNT:
+            {
+                GGML_ASSERT(false);
+            } break;
+    }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -15119,9 +17470,18 @@ static void ggml_compute_backward(struct ggml_context * ctx, struct ggml_tensor
             {
                 // necessary for llama
                 if (src0->grad) {
+                    float scale;
+                    memcpy(&scale, (float *) tensor->op_params + 0, sizeof(float));
+
+                    // the mask and the ALiBi bias are constant, only the scale of the input matters
+                    struct ggml_tensor * grad = ggml_soft_max_back(ctx, tensor->grad, tensor);
+                    if (scale != 1.0f) {
+                        grad = ggml_scale_impl(ctx, grad, ggml_new_f32(ctx, scale), false);
+                    }
+
                     src0->grad =
                         ggml_add_or_set(ctx, src0->grad,
-                            ggml_soft_max_back(ctx, tensor->grad, tensor),
+                            grad,
                         zero_table);
                 }
 
@@ -15246,6 +17606,10 @@ static void ggml_compute_backward(struct ggml_context * ctx, struct ggml_tensor
             {
                 GGML_ASSERT(false); // TODO: not implemented
             } break;
+        case GGML_OP_TOP_K:
+            {
+                GGML_ASSERT(false); // TODO: not implemented
+            } break;
         case GGML_OP_FLASH_ATTN:
             {
                 struct ggml_tensor * flash_grad = NULL;
@@ -15300,6 +17664,10 @@ static void ggml_compute_backward(struct ggml_context * ctx, struct ggml_tensor
                             zero_table);
                 }
             } break;
+        case GGML_OP_FLASH_ATTN_EXT:
+            {
+                GGML_ASSERT(false); // TODO: not implemented
+            } break;
         case GGML_OP_FLASH_FF:
             {
                 GGML_ASSERT(false); // not supported
@@ -15414,6 +17782,18 @@ static void ggml_compute_backward(struct ggml_context * ctx, struct ggml_tensor
                 GGML_ASSERT(false); // not supported
             } break;
         case GGML_OP_PAD_CIRCULAR:
+            {
+                if (src0->grad) {
+                    const int32_t * pads = (const int32_t *) tensor->op_params;
+                    src0->grad = ggml_add_or_set(ctx,
+                            src0->grad,
+                            ggml_pad_circular_back(ctx, tensor->grad, src0, pads[0], pads[2], pads[4], pads[6]),
+                            zero_table);
+                }
+            } break;
+        case GGML_OP_PAD_CIRCULAR_BACK:
+        case GGML_OP_RFFT_2D:
+        case GGML_OP_CONV_2D_CIRCULAR:
             {
                 GGML_ASSERT(false); // TODO: not implemented
             } break;
@@ -15748,13 +18128,19 @@ typedef pthread_t ggml_thread_t;
 
 // Android's libc implementation "bionic" does not support setting affinity
 #if defined(__linux__) && !defined(__BIONIC__)
+// the NUMA node the calling thread is pinned to, -1 if it is not
+static _Thread_local int g_numa_thread_node = -1;
+
+static int ggml_numa_thread_node(void) {
+    return g_numa_thread_node;
+}
+
 static void set_numa_thread_affinity(int thread_n, int n_threads) {
     if (!ggml_is_numa()) {
         return;
     }
 
-    // run thread on node_num thread_n / (threads per node)
-    const int node_num = thread_n / ((n_threads + g_state.numa.n_nodes - 1) / g_state.numa.n_nodes);
+    const int node_num = ggml_numa_node_of_thread(thread_n, n_threads);
     struct ggml_numa_node * node = &g_state.numa.nodes[node_num];
     size_t setsize = CPU_ALLOC_SIZE(g_state.numa.total_cpus);
 
@@ -15768,6 +18154,8 @@ static void set_numa_thread_affinity(int thread_n, int n_threads) {
     if (rv) {
             fprintf(stderr, "warning: pthread_setaffinity_np() failed: %s\n",
                     strerror(rv));
+    } else {
+        g_numa_thread_node = node_num;
     }
 
     CPU_FREE(cpus);
@@ -15778,6 +18166,8 @@ static void clear_numa_thread_affinity(void) {
         return;
     }
 
+    g_numa_thread_node = -1;
+
     size_t setsize = CPU_ALLOC_SIZE(g_state.numa.total_cpus);
 
     cpu_set_t * cpus = CPU_ALLOC(g_state.numa.total_cpus);
@@ -15797,10 +18187,51 @@ static void clear_numa_thread_affinity(void) {
 #else
 // TODO: Windows etc.
 // (the linux implementation may also work on BSD, someone should test)
+static int ggml_numa_thread_node(void) { return -1; }
 static void set_numa_thread_affinity(int thread_n, int n_threads) { UNUSED(thread_n); UNUSED(n_threads);  }
 static void clear_numa_thread_affinity(void) {}
 #endif
 
+// counting barrier for the threads of a node
+struct ggml_compute_barrier {
+    atomic_int n_arrived;
+    atomic_int n_passed;
+
+    atomic_int n_chunks[GGML_NUMA_MAX_NODES]; // chunks of the node handed out by ggml_chunk_next, per thread group
+
+    enum ggml_wait_policy wait_policy;
+    int wait_spin_count;
+};
+
+// what the plan of a node depends on
+struct ggml_cplan_key {
+    enum ggml_op   op;
+    enum ggml_type type;
+    int64_t        ne[GGML_MAX_DIMS];
+    int32_t        op_params[GGML_MAX_OP_PARAMS / sizeof(int32_t)];
+
+    enum ggml_type src_type[GGML_MAX_SRC]; // GGML_TYPE_COUNT for no src
+    int64_t        src_ne[GGML_MAX_SRC][GGML_MAX_DIMS];
+};
+
+struct ggml_cplan_cache_node {
+    struct ggml_cplan_key key;
+
+    int n_tasks;
+};
+
+struct ggml_cplan_cache {
+    int n_threads;
+    int n_nodes;
+    int n_nodes_alloc;
+
+    struct ggml_cplan_cache_node * nodes;
+
+    size_t work_size;
+
+    struct ggml_dag * dag; // built by the first compute with ggml_cplan.dag, NULL until then
+};
+
 struct ggml_compute_state_shared {
     const struct ggml_cgraph * cgraph;
     const struct ggml_cplan  * cplan;
@@ -15816,12 +18247,38 @@ struct ggml_compute_state_shared {
 
     bool (*abort_callback)(void * data); // abort ggml_graph_compute when true
     void * abort_callback_data;
+
+    enum ggml_wait_policy wait_policy;
+    int wait_spin_count;
+
+    struct ggml_compute_barrier barrier;
+
+    // GGML_WAIT_POLICY_SLEEP: waiting threads sleep on cond until node_n changes
+    atomic_int     n_sleeping;
+    ggml_mutex_t * mutex;
+    ggml_cond_t  * cond;
+
+    struct ggml_dag * dag; // NULL: the nodes are computed one after the other
+
+    int n_pool_tasks; // threads of the graph still running on pool workers, protected by the pool mutex
+
+    // the pool the graph runs on and its weight, NULL when the threads were created for the call
+    struct ggml_threadpool * threadpool;
+    int weight;
+
+    // threads still computing the graph, lowered at the node boundaries for the other graphs of the pool
+    // the threads with ith >= n_threads_cur have left the graph
+    atomic_int n_threads_cur;
 };
 
 struct ggml_compute_state {
     ggml_thread_t thrd;
     int ith;
     struct ggml_compute_state_shared * shared;
+
+    // wait statistics of the current graph
+    int64_t wait_time_us;
+    int64_t wait_n_sleeps;
 };
 
 static void ggml_graph_compute_perf_stats_node(struct ggml_tensor * node, const struct ggml_compute_state_shared * st) {
@@ -15833,6 +18290,22 @@ static void ggml_graph_compute_perf_stats_node(struct ggml_tensor * node, const
     node->perf_time_us += time_us_cur;
 }
 
+static void ggml_graph_compute_perf_stats_graph(struct ggml_cgraph * cgraph, int64_t perf_start_cycles, int64_t perf_start_time_us) {
+    int64_t perf_cycles_cur  = ggml_perf_cycles()  - perf_start_cycles;
+    int64_t perf_time_us_cur = ggml_perf_time_us() - perf_start_time_us;
+
+    cgraph->perf_runs++;
+    cgraph->perf_cycles  += perf_cycles_cur;
+    cgraph->perf_time_us += perf_time_us_cur;
+
+    GGML_PRINT_DEBUG("%s: perf (%d) - cpu = %.3f / %.3f ms, wall = %.3f / %.3f ms\n",
+            __func__, cgraph->perf_runs,
+            (double) perf_cycles_cur      / (double) ggml_cycles_per_ms(),
+            (double) cgraph->perf_cycles  / (double) ggml_cycles_per_ms() / (double) cgraph->perf_runs,
+            (double) perf_time_us_cur     / 1000.0,
+            (double) cgraph->perf_time_us / 1000.0 / cgraph->perf_runs);
+}
+
 static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
     int n_tasks = 0;
 
@@ -15910,7 +18383,7 @@ static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
                                  //       the threads are still spinning
                 }
 #elif defined(GGML_USE_CLBLAST)
-                if (ggml_cl_can_mul_mat(node->src[0], node->src[1], node)) {
+                if (!(node->src[0]->flags & GGML_TENSOR_FLAG_REPACKED) && ggml_cl_can_mul_mat(node->src[0], node->src[1], node)) {
                     n_tasks = 1; // TODO: this actually is doing nothing
                                  //       the threads are still spinning
                 }
@@ -15984,10 +18457,12 @@ static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
                 n_tasks = n_threads;
             } break;
         case GGML_OP_ARGSORT:
+        case GGML_OP_TOP_K:
             {
                 n_tasks = n_threads;
             } break;
         case GGML_OP_FLASH_ATTN:
+        case GGML_OP_FLASH_ATTN_EXT:
             {
                 n_tasks = n_threads;
             } break;
@@ -16046,9 +18521,12 @@ static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
                 n_tasks = n_threads;
             } break;
         case GGML_OP_PAD_CIRCULAR:
+        case GGML_OP_PAD_CIRCULAR_BACK:
+        case GGML_OP_RFFT_2D:
+        case GGML_OP_CONV_2D_CIRCULAR:
             {
-                n_tasks=n_threads;
-            };
+                n_tasks = n_threads;
+            } break;
         case GGML_OP_NONE:
             {
                 n_tasks = 1;
@@ -16069,40 +18547,176 @@ static int ggml_get_n_tasks(struct ggml_tensor * node, int n_threads) {
     return n_tasks;
 }
 
+static int ggml_graph_node_n_tasks(const struct ggml_cplan * cplan, int i, struct ggml_tensor * node, int n_threads) {
+    if (cplan->cache) {
+        // the graph may have given threads back to the pool since it was planned
+        return MIN(cplan->cache->nodes[i].n_tasks, n_threads);
+    }
+
+    return ggml_get_n_tasks(node, n_threads);
+}
+
+// blocks until all params->nth threads working on the current node have reached it
+static void ggml_barrier(const struct ggml_compute_params * params) {
+    if (params->nth == 1) {
+        return;
+    }
+
+    struct ggml_compute_barrier * barrier = ggml_compute_params_barrier(params);
+
+    // read before arriving: the counter cannot move until this thread has arrived
+    const int n_passed = atomic_load(&barrier->n_passed);
+
+    if (atomic_fetch_add(&barrier->n_arrived, 1) == params->nth - 1) {
+        // last to arrive
+        atomic_store(&barrier->n_arrived, 0);
+        atomic_fetch_add(&barrier->n_passed, 1);
+        return;
+    }
+
+    int n_spin = 0;
+    while (atomic_load(&barrier->n_passed) == n_passed) {
+        // the threads are inside the same node, so there is no sleeping, only yielding
+        if ((barrier->wait_policy == GGML_WAIT_POLICY_YIELD || barrier->wait_policy == GGML_WAIT_POLICY_SLEEP) &&
+            ++n_spin > barrier->wait_spin_count) {
+            sched_yield();
+        }
+    }
+}
+
+// returns the chunk to compute after chunk ic, chunks >= the number of chunks of the node mean done
+// every thread starts with chunk ith, the rest go to the threads that finish first, so a slow core
+// does not hold back the whole node
+static int64_t ggml_chunk_next(const struct ggml_compute_params * params, int64_t ic) {
+    if (params->nth == 1) {
+        return ic + 1;
+    }
+
+    return params->nth + ggml_chunk_take(params, 0);
+}
+
+// hands out the chunks of counter ig of the node in order, 0 first, to the threads that ask for one
+static int64_t ggml_chunk_take(const struct ggml_compute_params * params, int ig) {
+    return atomic_fetch_add(&ggml_compute_params_barrier(params)->n_chunks[ig], 1);
+}
+
+// waits until another thread publishes a node_n different from last and returns it
+static int ggml_graph_compute_wait(struct ggml_compute_state * state, int last) {
+    struct ggml_compute_state_shared * shared = state->shared;
+
+    const int64_t t_start = ggml_time_us();
+
+    int node_n;
+    int n_spin = 0;
+
+    while (true) {
+        node_n = atomic_load(&shared->node_n);
+        if (node_n != last) {
+            break;
+        }
+
+        switch (shared->wait_policy) {
+            case GGML_WAIT_POLICY_DEFAULT:
+                {
+                    // ref: https://github.com/ggerganov/ggml/issues/291
+#if defined(GGML_USE_ACCELERATE) || defined(GGML_USE_OPENBLAS)
+                    sched_yield();
+#endif
+                } break;
+            case GGML_WAIT_POLICY_SPIN:
+                {
+                } break;
+            case GGML_WAIT_POLICY_YIELD:
+                {
+                    if (n_spin < shared->wait_spin_count) {
+                        n_spin++;
+                    } else {
+                        sched_yield();
+                    }
+                } break;
+            case GGML_WAIT_POLICY_SLEEP:
+                {
+                    if (n_spin < shared->wait_spin_count) {
+                        n_spin++;
+                        break;
+                    }
+
+                    // announce the sleeper before checking node_n again, see ggml_graph_compute_wake
+                    atomic_fetch_add(&shared->n_sleeping, 1);
+                    ggml_mutex_lock(shared->mutex);
+                    while (atomic_load(&shared->node_n) == last) {
+                        ggml_cond_wait(shared->cond, shared->mutex);
+                    }
+                    ggml_mutex_unlock(shared->mutex);
+                    atomic_fetch_sub(&shared->n_sleeping, 1);
+
+                    state->wait_n_sleeps++;
+                } break;
+        }
+    }
+
+    state->wait_time_us += ggml_time_us() - t_start;
+
+    return node_n;
+}
+
+// wakes the threads sleeping in ggml_graph_compute_wait, to be called after node_n was updated
+static void ggml_graph_compute_wake(struct ggml_compute_state_shared * shared) {
+    if (atomic_load(&shared->n_sleeping) > 0) {
+        ggml_mutex_lock(shared->mutex);
+        ggml_cond_broadcast(shared->cond);
+        ggml_mutex_unlock(shared->mutex);
+    }
+}
+
+static thread_ret_t ggml_graph_compute_thread_dag(struct ggml_compute_state * state);
+
+static int ggml_threadpool_rebalance(struct ggml_threadpool * tp, int n_threads, int weight);
+
 static thread_ret_t ggml_graph_compute_thread(void * data) {
     struct ggml_compute_state * state = (struct ggml_compute_state *) data;
 
+    if (state->shared->dag) {
+        return ggml_graph_compute_thread_dag(state);
+    }
+
     const struct ggml_cgraph * cgraph = state->shared->cgraph;
     const struct ggml_cplan  * cplan  = state->shared->cplan;
 
-    const int   n_threads   = state->shared->n_threads;
-
-    set_numa_thread_affinity(state->ith, n_threads);
+    set_numa_thread_affinity(state->ith, state->shared->n_threads);
 
     int node_n = -1;
 
     while (true) {
         if (cplan->abort_callback && cplan->abort_callback(cplan->abort_callback_data)) {
             state->shared->node_n += 1;
+            ggml_graph_compute_wake(state->shared);
             return (thread_ret_t) GGML_EXIT_ABORTED;
         }
         if (atomic_fetch_sub(&state->shared->n_active, 1) == 1) {
             // all other threads are finished and spinning
             // do finalize and init here so we don't have synchronize again
-            struct ggml_compute_params params = {
-                /*.type  =*/ GGML_TASK_FINALIZE,
-                /*.ith   =*/ 0,
-                /*.nth   =*/ 0,
-                /*.wsize =*/ cplan->work_size,
-                /*.wdata =*/ cplan->work_data,
+            int n_threads = atomic_load(&state->shared->n_threads_cur);
+
+            struct ggml_compute_params_sched sched = {
+                /*.params  =*/ {
+                    /*.type  =*/ GGML_TASK_FINALIZE,
+                    /*.ith   =*/ 0,
+                    /*.nth   =*/ 0,
+                    /*.wsize =*/ cplan->work_size,
+                    /*.wdata =*/ cplan->work_data,
+                },
+                /*.magic   =*/ GGML_COMPUTE_PARAMS_SCHED_MAGIC,
+                /*.barrier =*/ &state->shared->barrier,
             };
+            struct ggml_compute_params * params = &sched.params;
 
             if (node_n != -1) {
                 /* FINALIZE */
                 struct ggml_tensor * node = cgraph->nodes[node_n];
                 if (GGML_OP_HAS_FINALIZE[node->op]) {
-                    params.nth = ggml_get_n_tasks(node, n_threads);
-                    ggml_compute_forward(&params, node);
+                    params->nth = ggml_graph_node_n_tasks(cplan, node_n, node, n_threads);
+                    ggml_compute_forward(params, node);
                 }
                 ggml_graph_compute_perf_stats_node(node, state->shared);
             }
@@ -16111,29 +18725,42 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
             while (++node_n < cgraph->n_nodes) {
                 GGML_PRINT_DEBUG_5("%s: %d/%d\n", __func__, node_n, cgraph->n_nodes);
 
+                // make room for the graphs waiting for the pool, the threads above the new count leave below
+                const int n_threads_prev = n_threads;
+                if (state->shared->threadpool) {
+                    n_threads = ggml_threadpool_rebalance(state->shared->threadpool, n_threads, state->shared->weight);
+                }
+
                 struct ggml_tensor * node = cgraph->nodes[node_n];
-                const int n_tasks = ggml_get_n_tasks(node, n_threads);
+                const int n_tasks = ggml_graph_node_n_tasks(cplan, node_n, node, n_threads);
 
                 state->shared->perf_node_start_cycles  = ggml_perf_cycles();
                 state->shared->perf_node_start_time_us = ggml_perf_time_us();
 
-                params.nth = n_tasks;
+                params->nth = n_tasks;
+
+                // the chunk counters of the node, also used by the nodes computed here
+                for (int ig = 0; ig < GGML_NUMA_MAX_NODES; ++ig) {
+                    atomic_store(&state->shared->barrier.n_chunks[ig], 0);
+                }
 
                 /* INIT */
                 if (GGML_OP_HAS_INIT[node->op]) {
-                    params.type = GGML_TASK_INIT;
-                    ggml_compute_forward(&params, node);
+                    params->type = GGML_TASK_INIT;
+                    ggml_compute_forward(params, node);
                 }
 
-                if (n_tasks == 1) {
+                // a node with fewer threads is published even for a single task, so that the threads
+                // given back to the pool leave now and not after the nodes computed here
+                if (n_tasks == 1 && n_threads == n_threads_prev) {
                     // TODO: maybe push node_n to the atomic but if other threads see n_tasks is 1,
                     // they do something more efficient than spinning (?)
-                    params.type = GGML_TASK_COMPUTE;
-                    ggml_compute_forward(&params, node);
+                    params->type = GGML_TASK_COMPUTE;
+                    ggml_compute_forward(params, node);
 
                     if (GGML_OP_HAS_FINALIZE[node->op]) {
-                        params.type = GGML_TASK_FINALIZE;
-                        ggml_compute_forward(&params, node);
+                        params->type = GGML_TASK_FINALIZE;
+                        ggml_compute_forward(params, node);
                     }
 
                     ggml_graph_compute_perf_stats_node(node, state->shared);
@@ -16146,250 +18773,1288 @@ static thread_ret_t ggml_graph_compute_thread(void * data) {
                 }
             }
 
-            atomic_store(&state->shared->n_active, n_threads);
-            atomic_store(&state->shared->node_n,   node_n);
+            atomic_store(&state->shared->n_threads_cur, n_threads);
+            atomic_store(&state->shared->n_active,      n_threads);
+            atomic_store(&state->shared->node_n,        node_n);
+            ggml_graph_compute_wake(state->shared);
         } else {
             // wait for other threads to finish
-            const int last = node_n;
-            while (true) {
-                // TODO: this sched_yield can have significant impact on the performance - either positive or negative
-                //       depending on the workload and the operating system.
-                //       since it is not clear what is the best approach, it should potentially become user-configurable
-                //       ref: https://github.com/ggerganov/ggml/issues/291
-#if defined(GGML_USE_ACCELERATE) || defined(GGML_USE_OPENBLAS)
-                sched_yield();
-#endif
-
-                node_n = atomic_load(&state->shared->node_n);
-                if (node_n != last) break;
-            };
+            node_n = ggml_graph_compute_wait(state, node_n);
         }
 
         // check if we should stop
         if (node_n >= cgraph->n_nodes) break;
 
+        const int n_threads = atomic_load(&state->shared->n_threads_cur);
+        if (state->ith >= n_threads) {
+            // given back to the pool
+            break;
+        }
+
         /* COMPUTE */
         struct ggml_tensor * node = cgraph->nodes[node_n];
-        const int n_tasks = ggml_get_n_tasks(node, n_threads);
-
-        struct ggml_compute_params params = {
-            /*.type  =*/ GGML_TASK_COMPUTE,
-            /*.ith   =*/ state->ith,
-            /*.nth   =*/ n_tasks,
-            /*.wsize =*/ cplan->work_size,
-            /*.wdata =*/ cplan->work_data,
+        const int n_tasks = ggml_graph_node_n_tasks(cplan, node_n, node, n_threads);
+
+        struct ggml_compute_params_sched sched = {
+            /*.params  =*/ {
+                /*.type  =*/ GGML_TASK_COMPUTE,
+                /*.ith   =*/ state->ith,
+                /*.nth   =*/ n_tasks,
+                /*.wsize =*/ cplan->work_size,
+                /*.wdata =*/ cplan->work_data,
+            },
+            /*.magic   =*/ GGML_COMPUTE_PARAMS_SCHED_MAGIC,
+            /*.barrier =*/ &state->shared->barrier,
         };
+        struct ggml_compute_params * params = &sched.params;
 
         if (state->ith < n_tasks) {
-            ggml_compute_forward(&params, node);
+            ggml_compute_forward(params, node);
         }
     }
 
     return GGML_EXIT_SUCCESS;
 }
 
-struct ggml_cplan ggml_graph_plan(struct ggml_cgraph * cgraph, int n_threads) {
-    if (n_threads <= 0) {
-        n_threads = GGML_DEFAULT_N_THREADS;
+// the ops that resolve the indices of a ggml_pad_circular_view when it is their i-th source
+static bool ggml_can_read_wrapped_view(const struct ggml_tensor * node, int i) {
+    switch (node->op) {
+        case GGML_OP_IM2COL:
+            return i == 1;
+        case GGML_OP_POOL_2D:
+        case GGML_OP_UPSCALE:
+        case GGML_OP_UNARY:
+            return i == 0;
+        default:
+            return false;
     }
+}
 
-    size_t work_size = 0;
-
-    struct ggml_cplan cplan;
-    memset(&cplan, 0, sizeof(struct ggml_cplan));
-
-    // thread scheduling for the different operations + work buffer size estimation
-    for (int i = 0; i < cgraph->n_nodes; i++) {
-        int n_tasks = 1;
-
-        struct ggml_tensor * node = cgraph->nodes[i];
+// size of the work buffer needed by node when computed with up to n_threads threads
+static size_t ggml_graph_node_work_size(const struct ggml_tensor * node, int n_threads) {
+    int n_tasks = 1;
 
-        size_t cur = 0;
+    size_t cur = 0;
 
-        switch (node->op) {
-            case GGML_OP_CPY:
-            case GGML_OP_DUP:
-                {
-                    n_tasks = n_threads;
+    switch (node->op) {
+        case GGML_OP_CPY:
+        case GGML_OP_DUP:
+            {
+                n_tasks = n_threads;
 
-                    if (ggml_is_quantized(node->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_ADD:
-            case GGML_OP_ADD1:
-                {
-                    n_tasks = n_threads;
+                if (ggml_is_quantized(node->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_ADD:
+        case GGML_OP_ADD1:
+            {
+                n_tasks = n_threads;
 
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_ACC:
-                {
-                    n_tasks = n_threads;
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_ACC:
+            {
+                n_tasks = n_threads;
 
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[1]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_MUL_MAT:
-                {
-                    const enum ggml_type vec_dot_type = type_traits[node->src[0]->type].vec_dot_type;
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[1]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_MUL_MAT:
+            {
+                const enum ggml_type vec_dot_type = type_traits[node->src[0]->type].vec_dot_type;
 
 #if defined(GGML_USE_CLBLAST)
-                    if (ggml_cl_can_mul_mat(node->src[0], node->src[1], node)) {
-                        cur = ggml_cl_mul_mat_get_wsize(node->src[0], node->src[1], node);
-                    } else
+                if (!(node->src[0]->flags & GGML_TENSOR_FLAG_REPACKED) && ggml_cl_can_mul_mat(node->src[0], node->src[1], node)) {
+                    cur = ggml_cl_mul_mat_get_wsize(node->src[0], node->src[1], node);
+                } else
 #endif
 #if defined(GGML_USE_ACCELERATE) || defined(GGML_USE_OPENBLAS)
-                    if (ggml_compute_forward_mul_mat_use_blas(node->src[0], node->src[1], node)) {
-                        if (node->src[0]->type != GGML_TYPE_F32) {
-                            // here we need memory just for single 2D matrix from src0
-                            cur = ggml_type_size(GGML_TYPE_F32)*(node->src[0]->ne[0]*node->src[0]->ne[1]);
-                        }
-                    } else
+                if (ggml_compute_forward_mul_mat_use_blas(node->src[0], node->src[1], node)) {
+                    if (node->src[0]->type != GGML_TYPE_F32) {
+                        // here we need memory just for single 2D matrix from src0
+                        cur = ggml_type_size(GGML_TYPE_F32)*(node->src[0]->ne[0]*node->src[0]->ne[1]);
+                    }
+                } else
 #endif
-                    if (node->src[1]->type != vec_dot_type) {
-                        cur = ggml_type_size(vec_dot_type)*ggml_nelements(node->src[1])/ggml_blck_size(vec_dot_type);
+                if (ggml_compute_forward_mul_mat_use_gemm(node->src[0], node->src[1])) {
+                    if (node->src[0]->type != GGML_TYPE_F32) {
+                        // one F32 panel of src0 per thread
+                        cur = sizeof(float)*GGML_MUL_MAT_CHUNK*GGML_GEMM_KC*n_threads;
                     }
-                } break;
-            case GGML_OP_MUL_MAT_ID:
-                {
-                    const struct ggml_tensor * a = node->src[2];
-                    const struct ggml_tensor * b = node->src[1];
-                    const enum ggml_type vec_dot_type = type_traits[a->type].vec_dot_type;
+                } else
+                if (node->src[1]->type != vec_dot_type) {
+                    cur = ggml_type_size(vec_dot_type)*ggml_nelements(node->src[1])/ggml_blck_size(vec_dot_type);
+                }
+            } break;
+        case GGML_OP_MUL_MAT_ID:
+            {
+                const struct ggml_tensor * a = node->src[2];
+                const struct ggml_tensor * b = node->src[1];
+                const enum ggml_type vec_dot_type = type_traits[a->type].vec_dot_type;
 #if defined(GGML_USE_ACCELERATE) || defined(GGML_USE_OPENBLAS)
-                    if (ggml_compute_forward_mul_mat_use_blas(a, b, node)) {
-                        if (a->type != GGML_TYPE_F32) {
-                            // here we need memory just for single 2D matrix from src0
-                            cur = ggml_type_size(GGML_TYPE_F32)*(a->ne[0]*a->ne[1]);
-                        }
-                    } else
+                if (ggml_compute_forward_mul_mat_use_blas(a, b, node)) {
+                    if (a->type != GGML_TYPE_F32) {
+                        // here we need memory just for single 2D matrix from src0
+                        cur = ggml_type_size(GGML_TYPE_F32)*(a->ne[0]*a->ne[1]);
+                    }
+                } else
 #endif
-                    if (b->type != vec_dot_type) {
-                        cur = ggml_type_size(vec_dot_type)*ggml_nelements(b)/ggml_blck_size(vec_dot_type);
+                if (ggml_compute_forward_mul_mat_use_gemm(a, b)) {
+                    if (a->type != GGML_TYPE_F32) {
+                        // one F32 panel of src0 per thread
+                        cur = sizeof(float)*GGML_MUL_MAT_CHUNK*GGML_GEMM_KC*n_threads;
                     }
-                } break;
-            case GGML_OP_OUT_PROD:
-                {
-                    n_tasks = n_threads;
+                } else
+                if (b->type != vec_dot_type) {
+                    cur = ggml_type_size(vec_dot_type)*ggml_nelements(b)/ggml_blck_size(vec_dot_type);
+                }
+            } break;
+        case GGML_OP_OUT_PROD:
+            {
+                n_tasks = n_threads;
 
-                    if (ggml_is_quantized(node->src[0]->type)) {
-                        cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
-                    }
-                } break;
-            case GGML_OP_CONV_TRANSPOSE_1D:
-                {
-                    GGML_ASSERT(node->src[0]->ne[3] == 1);
-                    GGML_ASSERT(node->src[1]->ne[2] == 1);
-                    GGML_ASSERT(node->src[1]->ne[3] == 1);
-
-                    const int64_t ne00 = node->src[0]->ne[0];  // K
-                    const int64_t ne01 = node->src[0]->ne[1];  // Cout
-                    const int64_t ne02 = node->src[0]->ne[2];  // Cin
-
-                    const int64_t ne10 = node->src[1]->ne[0];  // L
-                    const int64_t ne11 = node->src[1]->ne[1];  // Cin
-
-                    if (node->src[0]->type == GGML_TYPE_F16 &&
-                        node->src[1]->type == GGML_TYPE_F32) {
-                        cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02;
-                        cur += sizeof(ggml_fp16_t)*ne10*ne11;
-                    } else if (node->src[0]->type == GGML_TYPE_F32 &&
-                               node->src[1]->type == GGML_TYPE_F32) {
-                        cur += sizeof(float)*ne00*ne01*ne02;
-                        cur += sizeof(float)*ne10*ne11;
-                    } else {
-                        GGML_ASSERT(false);
-                    }
-                } break;
-            case GGML_OP_IM2COL:
-                {
-                    n_tasks = n_threads;
-                } break;
-            case GGML_OP_CONV_TRANSPOSE_2D:
-                {
-                    const int64_t ne00 = node->src[0]->ne[0]; // W
-                    const int64_t ne01 = node->src[0]->ne[1]; // H
-                    const int64_t ne02 = node->src[0]->ne[2]; // Channels Out
-                    const int64_t ne03 = node->src[0]->ne[3]; // Channels In
+                if (ggml_is_quantized(node->src[0]->type)) {
+                    cur = ggml_type_size(GGML_TYPE_F32) * node->src[0]->ne[0] * n_tasks;
+                }
+            } break;
+        case GGML_OP_CONV_TRANSPOSE_1D:
+            {
+                GGML_ASSERT(node->src[0]->ne[3] == 1);
+                GGML_ASSERT(node->src[1]->ne[2] == 1);
+                GGML_ASSERT(node->src[1]->ne[3] == 1);
+
+                const int64_t ne00 = node->src[0]->ne[0];  // K
+                const int64_t ne01 = node->src[0]->ne[1];  // Cout
+                const int64_t ne02 = node->src[0]->ne[2];  // Cin
+
+                const int64_t ne10 = node->src[1]->ne[0];  // L
+                const int64_t ne11 = node->src[1]->ne[1];  // Cin
+
+                if (node->src[0]->type == GGML_TYPE_F16 &&
+                    node->src[1]->type == GGML_TYPE_F32) {
+                    cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02;
+                    cur += sizeof(ggml_fp16_t)*ne10*ne11;
+                } else if (node->src[0]->type == GGML_TYPE_F32 &&
+                           node->src[1]->type == GGML_TYPE_F32) {
+                    cur += sizeof(float)*ne00*ne01*ne02;
+                    cur += sizeof(float)*ne10*ne11;
+                } else {
+                    GGML_ASSERT(false);
+                }
+            } break;
+        case GGML_OP_IM2COL:
+            {
+                n_tasks = n_threads;
+            } break;
+        case GGML_OP_CONV_TRANSPOSE_2D:
+            {
+                const int64_t ne00 = node->src[0]->ne[0]; // W
+                const int64_t ne01 = node->src[0]->ne[1]; // H
+                const int64_t ne02 = node->src[0]->ne[2]; // Channels Out
+                const int64_t ne03 = node->src[0]->ne[3]; // Channels In
 
-                    const int64_t ne10 = node->src[1]->ne[0]; // W
-                    const int64_t ne11 = node->src[1]->ne[1]; // H
-                    const int64_t ne12 = node->src[1]->ne[2]; // Channels In
+                const int64_t ne10 = node->src[1]->ne[0]; // W
+                const int64_t ne11 = node->src[1]->ne[1]; // H
+                const int64_t ne12 = node->src[1]->ne[2]; // Channels In
 
-                    cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02*ne03;
-                    cur += sizeof(ggml_fp16_t)*ne10*ne11*ne12;
-                } break;
-            case GGML_OP_FLASH_ATTN:
-                {
-                    n_tasks = n_threads;
+                cur += sizeof(ggml_fp16_t)*ne00*ne01*ne02*ne03;
+                cur += sizeof(ggml_fp16_t)*ne10*ne11*ne12;
+            } break;
+        case GGML_OP_RFFT_2D:
+            {
+                n_tasks = n_threads;
 
-                    const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
+                const int64_t W = ggml_get_op_params_i32(node, 0);
+                const int64_t H = node->ne[1];
 
-                    if (node->src[1]->type == GGML_TYPE_F32) {
-                        cur  = sizeof(float)*ne11*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*ne11*n_tasks; // this is overestimated by x2
-                    } else if (node->src[1]->type == GGML_TYPE_F16) {
-                        cur  = sizeof(float)*ne11*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*ne11*n_tasks; // this is overestimated by x2
-                    }
-                } break;
-            case GGML_OP_FLASH_FF:
-                {
-                    n_tasks = n_threads;
+                cur = sizeof(float)*(W*H + ggml_rfft_2d_scratch_size(W, H) + CACHE_LINE_SIZE_F32)*n_tasks;
+            } break;
+        case GGML_OP_CONV_2D_CIRCULAR:
+            {
+                n_tasks = n_threads;
 
-                    if (node->src[1]->type == GGML_TYPE_F32) {
-                        cur  = sizeof(float)*node->src[1]->ne[1]*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*node->src[1]->ne[1]*n_tasks; // this is overestimated by x2
-                    } else if (node->src[1]->type == GGML_TYPE_F16) {
-                        cur  = sizeof(float)*node->src[1]->ne[1]*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*node->src[1]->ne[1]*n_tasks; // this is overestimated by x2
-                    }
-                } break;
-            case GGML_OP_FLASH_ATTN_BACK:
-                {
-                    n_tasks = n_threads;
+                const int64_t W = ggml_get_op_params_i32(node, 0);
+                const int64_t H = node->src[1]->ne[1];
 
-                    const int64_t    D = node->src[0]->ne[0];
-                    const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
-                    const int64_t mxDn = MAX(D, ne11) * 2; // *2 because of S and SM in ggml_compute_forward_flash_attn_back
-                    if (node->src[1]->type == GGML_TYPE_F32) {
-                        cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
-                    } else if (node->src[1]->type == GGML_TYPE_F16) {
-                        cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
-                        cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
-                    }
-                } break;
+                cur = sizeof(float)*(2*(W/2 + 1)*H + W*H + ggml_rfft_2d_scratch_size(W, H) + CACHE_LINE_SIZE_F32)*n_tasks;
+            } break;
+        case GGML_OP_FLASH_ATTN:
+            {
+                n_tasks = n_threads;
+
+                const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
+
+                if (node->src[1]->type == GGML_TYPE_F32) {
+                    cur  = sizeof(float)*ne11*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*ne11*n_tasks; // this is overestimated by x2
+                } else if (node->src[1]->type == GGML_TYPE_F16) {
+                    cur  = sizeof(float)*ne11*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*ne11*n_tasks; // this is overestimated by x2
+                }
+            } break;
+        case GGML_OP_ARGSORT:
+            {
+                n_tasks = n_threads;
+
+                const int64_t ne00 = node->src[0]->ne[0];
+                const int64_t nr   = ggml_nrows(node->src[0]);
+
+                // the kernel shares the rows with any thread count the buffer of whole rows is too small for,
+                // the shared buffer grows with the thread count so it fits for every nth <= n_tasks
+                if (ggml_sort_split(ne00, nr, n_tasks)) {
+                    cur = sizeof(uint32_t)*(3*ne00 + GGML_SORT_RADIX*n_tasks);
+                } else {
+                    cur = ggml_sort_rows_size(ne00, n_tasks);
+                }
+            } break;
+        case GGML_OP_TOP_K:
+            {
+                n_tasks = n_threads;
+
+                const int64_t ne00 = node->src[0]->ne[0];
+                const int64_t nr   = ggml_nrows(node->src[0]);
+                const int64_t k    = node->ne[0];
+
+                // a dag team or a rebalanced pool can run the node with fewer threads than planned, which
+                // can take either path: the buffer fits both for every nth <= n_tasks
+                cur = (sizeof(uint64_t)*k + CACHE_LINE_SIZE)*n_tasks;
+                if (ggml_sort_split(ne00, nr, n_tasks)) {
+                    cur = MAX(cur, sizeof(uint64_t)*k*nr*n_tasks);
+                }
+            } break;
+        case GGML_OP_FLASH_ATTN_EXT:
+            {
+                n_tasks = n_threads;
+
+                const int64_t D  = node->src[0]->ne[0];
+                const int64_t DV = node->src[2]->ne[0];
+
+                cur = sizeof(float)*(GGML_FLASH_ATTN_TILE*(D + DV) + DV + CACHE_LINE_SIZE_F32)*n_tasks;
+            } break;
+        case GGML_OP_FLASH_FF:
+            {
+                n_tasks = n_threads;
+
+                if (node->src[1]->type == GGML_TYPE_F32) {
+                    cur  = sizeof(float)*node->src[1]->ne[1]*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*node->src[1]->ne[1]*n_tasks; // this is overestimated by x2
+                } else if (node->src[1]->type == GGML_TYPE_F16) {
+                    cur  = sizeof(float)*node->src[1]->ne[1]*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*node->src[1]->ne[1]*n_tasks; // this is overestimated by x2
+                }
+            } break;
+        case GGML_OP_FLASH_ATTN_BACK:
+            {
+                n_tasks = n_threads;
+
+                const int64_t    D = node->src[0]->ne[0];
+                const int64_t ne11 = ggml_up(node->src[1]->ne[1], GGML_SOFT_MAX_UNROLL);
+                const int64_t mxDn = MAX(D, ne11) * 2; // *2 because of S and SM in ggml_compute_forward_flash_attn_back
+                if (node->src[1]->type == GGML_TYPE_F32) {
+                    cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
+                } else if (node->src[1]->type == GGML_TYPE_F16) {
+                    cur  = sizeof(float)*mxDn*n_tasks; // TODO: this can become (n_tasks-1)
+                    cur += sizeof(float)*mxDn*n_tasks; // this is overestimated by x2
+                }
+            } break;
+
+        case GGML_OP_CROSS_ENTROPY_LOSS:
+            {
+                n_tasks = n_threads;
+
+                cur = ggml_type_size(node->type)*(n_tasks + node->src[0]->ne[0]*n_tasks);
+            } break;
+        case GGML_OP_COUNT:
+            {
+                GGML_ASSERT(false);
+            } break;
+        default:
+            break;
+    }
+
+    return cur;
+}
+
+struct ggml_cplan ggml_graph_plan(struct ggml_cgraph * cgraph, int n_threads) {
+    if (n_threads <= 0) {
+        n_threads = GGML_DEFAULT_N_THREADS;
+    }
+
+    size_t work_size = 0;
+
+    struct ggml_cplan cplan;
+    memset(&cplan, 0, sizeof(struct ggml_cplan));
+
+    // thread scheduling for the different operations + work buffer size estimation
+    for (int i = 0; i < cgraph->n_nodes; i++) {
+        struct ggml_tensor * node = cgraph->nodes[i];
+
+        // a ggml_pad_circular_view has no data, any other consumer would read garbage
+        for (int j = 0; j < GGML_MAX_SRC; ++j) {
+            if (node->src[j] != NULL && ggml_is_wrapped_view(node->src[j])) {
+                GGML_ASSERT(ggml_can_read_wrapped_view(node, j));
+            }
+        }
+
+        work_size = MAX(work_size, ggml_graph_node_work_size(node, n_threads));
+    }
+
+    if (work_size > 0) {
+        work_size += CACHE_LINE_SIZE*(n_threads - 1);
+    }
+
+    cplan.n_threads = n_threads;
+    cplan.work_size = work_size;
+    cplan.work_data = NULL;
+
+    return cplan;
+}
+
+struct ggml_cplan_cache * ggml_cplan_cache_new(void) {
+    struct ggml_cplan_cache * cache = malloc(sizeof(struct ggml_cplan_cache));
+    GGML_ASSERT(cache);
+
+    cache->n_threads     = 0;
+    cache->n_nodes       = 0;
+    cache->n_nodes_alloc = 0;
+    cache->nodes         = NULL;
+    cache->work_size     = 0;
+    cache->dag           = NULL;
+
+    return cache;
+}
+
+static void ggml_dag_free(struct ggml_dag * dag);
+
+void ggml_cplan_cache_free(struct ggml_cplan_cache * cache) {
+    if (cache == NULL) {
+        return;
+    }
+
+    if (cache->dag) {
+        ggml_dag_free(cache->dag);
+    }
+
+    free(cache->nodes);
+    free(cache);
+}
+
+static void ggml_cplan_key_init(struct ggml_cplan_key * key, const struct ggml_tensor * node) {
+    // zero the padding too, the keys are compared with memcmp
+    memset(key, 0, sizeof(struct ggml_cplan_key));
+
+    key->op   = node->op;
+    key->type = node->type;
+    memcpy(key->ne,        node->ne,        sizeof(key->ne));
+    memcpy(key->op_params, node->op_params, sizeof(key->op_params));
+
+    for (int j = 0; j < GGML_MAX_SRC; ++j) {
+        const struct ggml_tensor * src = node->src[j];
+
+        key->src_type[j] = src ? src->type : GGML_TYPE_COUNT;
+        if (src) {
+            memcpy(key->src_ne[j], src->ne, sizeof(key->src_ne[j]));
+        }
+    }
+}
+
+struct ggml_cplan ggml_graph_plan_cached(struct ggml_cgraph * cgraph, int n_threads, struct ggml_cplan_cache * cache) {
+    if (n_threads <= 0) {
+        n_threads = GGML_DEFAULT_N_THREADS;
+    }
+
+    bool reuse = cache->n_threads == n_threads && cache->n_nodes == cgraph->n_nodes;
+
+    for (int i = 0; i < cgraph->n_nodes && reuse; i++) {
+        struct ggml_cplan_key key;
+        ggml_cplan_key_init(&key, cgraph->nodes[i]);
+
+        reuse = memcmp(&key, &cache->nodes[i].key, sizeof(struct ggml_cplan_key)) == 0;
+    }
+
+    if (!reuse) {
+        const struct ggml_cplan cplan = ggml_graph_plan(cgraph, n_threads);
+
+        if (cache->n_nodes_alloc < cgraph->n_nodes) {
+            cache->nodes = realloc(cache->nodes, cgraph->n_nodes*sizeof(struct ggml_cplan_cache_node));
+            GGML_ASSERT(cache->nodes);
+            cache->n_nodes_alloc = cgraph->n_nodes;
+        }
+
+        for (int i = 0; i < cgraph->n_nodes; i++) {
+            ggml_cplan_key_init(&cache->nodes[i].key, cgraph->nodes[i]);
+            cache->nodes[i].n_tasks = ggml_get_n_tasks(cgraph->nodes[i], n_threads);
+        }
+
+        cache->n_threads = n_threads;
+        cache->n_nodes   = cgraph->n_nodes;
+        cache->work_size = cplan.work_size;
+
+        if (cache->dag) {
+            ggml_dag_free(cache->dag);
+            cache->dag = NULL;
+        }
+    }
+
+    struct ggml_cplan cplan;
+    memset(&cplan, 0, sizeof(struct ggml_cplan));
+
+    cplan.n_threads = n_threads;
+    cplan.work_size = cache->work_size;
+    cplan.work_data = NULL;
+    cplan.cache     = cache;
+
+    return cplan;
+}
+
+// ggml_dag
+
+// with ggml_cplan.dag the nodes of the graph are not computed one after the other: every node
+// waits only for the earlier nodes it depends on and idle threads pick up any node that is ready.
+// the dependencies come from the memory the nodes access: a node depends on the earlier nodes that
+// write memory it reads or writes, and on the earlier nodes that read memory it writes. this covers
+// the src edges as well as views, in-place ops and buffers reused by ggml-alloc.
+// the work buffer is shared by all nodes, so the nodes that use it are chained in graph order.
+// small nodes get a team of fewer threads, sized by GGML_DAG_TASK_COST
+// with a ggml_cplan_cache the dag is built once and only its counters are reset for every compute,
+// as long as the nodes and their sources keep their data
+
+#define GGML_DAG_TASK_COST 32768 // elementary operations per thread
+
+struct ggml_dag_node {
+    int n_deps;  // earlier nodes that must complete first
+    int i_succ;  // the nodes that depend on this one: succ[i_succ, i_succ + n_succ)
+    int n_succ;
+    int n_tasks; // size of the team computing the node
+    int n_joined; // team members handed out, protected by the dag mutex
+
+    atomic_int n_pending; // dependencies that did not complete yet
+    atomic_int n_done;    // team members done with COMPUTE
+
+    struct ggml_compute_barrier barrier;
+};
+
+struct ggml_dag {
+    int n_nodes;
+
+    struct ggml_dag_node * nodes;
+    int                  * succ;
+
+    // the data of every node and of its sources, the edges are only valid for these addresses
+    const void ** data;
+
+    // nodes whose dependencies completed, in the order they became ready
+    // every node is pushed once, so the queue never wraps around
+    ggml_mutex_t mutex;
+    int        * queue;
+    int          head;
+    int          tail;
+
+    atomic_int n_completed;
+    atomic_int n_inflight; // pushed but not completed
+    atomic_int aborted;
+};
+
+// a memory range accessed by a node
+struct ggml_dag_range {
+    uintptr_t begin;
+    uintptr_t end;
+    int       node;
+    bool      write;
+};
+
+static int ggml_dag_range_cmp(const void * a, const void * b) {
+    const struct ggml_dag_range * ra = (const struct ggml_dag_range *) a;
+    const struct ggml_dag_range * rb = (const struct ggml_dag_range *) b;
+    return (ra->begin > rb->begin) - (ra->begin < rb->begin);
+}
+
+// view ops only compute an address, they do not touch the data
+static bool ggml_dag_node_writes(const struct ggml_tensor * node) {
+    switch (node->op) {
+        case GGML_OP_NONE:
+        case GGML_OP_VIEW:
+        case GGML_OP_RESHAPE:
+        case GGML_OP_PERMUTE:
+        case GGML_OP_TRANSPOSE:
+            return false;
+        default:
+            return !ggml_is_wrapped_view(node);
+    }
+}
+
+static bool ggml_dag_tensor_range(const struct ggml_tensor * t, int node, bool write, struct ggml_dag_range * range) {
+    // the data of a lazy circular pad is the tensor it wraps
+    if (ggml_is_wrapped_view(t)) {
+        t = t->src[0];
+    }
+
+    if (t->data == NULL || ggml_nbytes(t) == 0) {
+        return false;
+    }
+
+    range->begin = (uintptr_t) t->data;
+    range->end   = (uintptr_t) t->data + ggml_nbytes(t);
+    range->node  = node;
+    range->write = write;
+
+    return true;
+}
+
+// the number of threads for a node: enough to give each one GGML_DAG_TASK_COST operations
+static int ggml_dag_team_size(struct ggml_tensor * node, int n_threads) {
+    int64_t cost = ggml_nelements(node);
+
+    switch (node->op) {
+        case GGML_OP_MUL_MAT:    cost *= node->src[0]->ne[0]; break;
+        case GGML_OP_MUL_MAT_ID: cost *= node->src[2]->ne[0]; break;
+        case GGML_OP_OUT_PROD:   cost *= node->src[0]->ne[1]; break;
+        default:                                              break;
+    }
+
+    const int team = (int) MIN((int64_t) n_threads, 1 + cost/GGML_DAG_TASK_COST);
+
+    return ggml_get_n_tasks(node, team);
+}
+
+struct ggml_dag_edges {
+    int * from;
+    int * to;
+    int   n;
+    int   size;
+};
+
+static void ggml_dag_add_edge(struct ggml_dag_edges * edges, int * mark, int from, int to) {
+    if (mark[from] == to) {
+        return;
+    }
+    mark[from] = to;
+
+    if (edges->n == edges->size) {
+        edges->size = MAX(2*edges->size, 1024);
+        edges->from = realloc(edges->from, edges->size*sizeof(int));
+        edges->to   = realloc(edges->to,   edges->size*sizeof(int));
+        GGML_ASSERT(edges->from && edges->to);
+    }
+
+    edges->from[edges->n] = from;
+    edges->to  [edges->n] = to;
+    edges->n++;
+}
+
+// adds an edge to node from every earlier node with a conflicting access to range r
+// ranges is sorted by begin, max_end[k] is the largest end in ranges[0..k]
+static void ggml_dag_add_conflicts(
+        struct ggml_dag_edges       * edges,
+        int                         * mark,
+        const struct ggml_dag_range * ranges,
+        const uintptr_t             * max_end,
+        int                           n_ranges,
+        const struct ggml_dag_range * r) {
+    // the last range that begins before r ends
+    int lo = 0;
+    int hi = n_ranges;
+    while (lo < hi) {
+        const int mid = (lo + hi)/2;
+        if (ranges[mid].begin < r->end) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    for (int k = lo - 1; k >= 0 && max_end[k] > r->begin; --k) {
+        const struct ggml_dag_range * o = &ranges[k];
+        if (o->node < r->node && o->end > r->begin && (o->write || r->write)) {
+            ggml_dag_add_edge(edges, mark, o->node, r->node);
+        }
+    }
+}
+
+static void ggml_dag_tensor_data(const struct ggml_cgraph * cgraph, int i, const void ** data) {
+    const struct ggml_tensor * node = cgraph->nodes[i];
+
+    data[0] = node->data;
+    for (int j = 0; j < GGML_MAX_SRC; ++j) {
+        data[1 + j] = node->src[j] ? node->src[j]->data : NULL;
+    }
+}
+
+static struct ggml_dag * ggml_dag_new(struct ggml_cgraph * cgraph, int n_threads) {
+    const int n_nodes = cgraph->n_nodes;
+
+    struct ggml_dag * dag = malloc(sizeof(struct ggml_dag));
+    GGML_ASSERT(dag);
+
+    dag->n_nodes = n_nodes;
+    dag->nodes   = malloc(MAX(n_nodes, 1)*sizeof(struct ggml_dag_node));
+    dag->data    = malloc(MAX(n_nodes, 1)*(GGML_MAX_SRC + 1)*sizeof(const void *));
+    dag->queue   = malloc(MAX(n_nodes, 1)*sizeof(int));
+    GGML_ASSERT(dag->nodes && dag->data && dag->queue);
+
+    ggml_mutex_init(&dag->mutex);
+
+    for (int i = 0; i < n_nodes; ++i) {
+        ggml_dag_tensor_data(cgraph, i, dag->data + i*(GGML_MAX_SRC + 1));
+    }
+
+    // memory accessed by every node
+    struct ggml_dag_range * ranges = malloc(MAX(n_nodes, 1)*(GGML_MAX_SRC + 1)*sizeof(struct ggml_dag_range));
+    GGML_ASSERT(ranges);
+
+    int n_ranges = 0;
+    for (int i = 0; i < n_nodes; ++i) {
+        struct ggml_tensor * node = cgraph->nodes[i];
+        if (ggml_dag_node_writes(node) && ggml_dag_tensor_range(node, i, true, &ranges[n_ranges])) {
+            n_ranges++;
+        }
+        for (int j = 0; j < GGML_MAX_SRC; ++j) {
+            if (node->src[j] && ggml_dag_tensor_range(node->src[j], i, false, &ranges[n_ranges])) {
+                n_ranges++;
+            }
+        }
+    }
+
+    qsort(ranges, n_ranges, sizeof(struct ggml_dag_range), ggml_dag_range_cmp);
+
+    uintptr_t * max_end = malloc(MAX(n_ranges, 1)*sizeof(uintptr_t));
+    int       * mark    = malloc(MAX(n_nodes, 1)*sizeof(int));
+    GGML_ASSERT(max_end && mark);
+
+    for (int k = 0; k < n_ranges; ++k) {
+        max_end[k] = k == 0 ? ranges[k].end : MAX(max_end[k - 1], ranges[k].end);
+    }
+    for (int i = 0; i < n_nodes; ++i) {
+        mark[i] = -1;
+    }
+
+    struct ggml_dag_edges edges = { NULL, NULL, 0, 0 };
+
+    int last_wdata = -1;
+    for (int i = 0; i < n_nodes; ++i) {
+        struct ggml_tensor * node = cgraph->nodes[i];
+        struct ggml_dag_range r;
+
+        if (ggml_dag_node_writes(node) && ggml_dag_tensor_range(node, i, true, &r)) {
+            ggml_dag_add_conflicts(&edges, mark, ranges, max_end, n_ranges, &r);
+        }
+        for (int j = 0; j < GGML_MAX_SRC; ++j) {
+            if (node->src[j] && ggml_dag_tensor_range(node->src[j], i, false, &r)) {
+                ggml_dag_add_conflicts(&edges, mark, ranges, max_end, n_ranges, &r);
+            }
+        }
+
+        if (ggml_graph_node_work_size(node, n_threads) > 0) {
+            if (last_wdata >= 0) {
+                ggml_dag_add_edge(&edges, mark, last_wdata, i);
+            }
+            last_wdata = i;
+        }
+    }
+
+    // successor lists
+    for (int i = 0; i < n_nodes; ++i) {
+        struct ggml_dag_node * dn = &dag->nodes[i];
+
+        dn->n_deps   = 0;
+        dn->n_succ   = 0;
+        dn->n_tasks  = ggml_dag_team_size(cgraph->nodes[i], n_threads);
+    }
+
+    for (int e = 0; e < edges.n; ++e) {
+        dag->nodes[edges.from[e]].n_succ++;
+        dag->nodes[edges.to  [e]].n_deps++;
+    }
+
+    dag->succ = malloc(MAX(edges.n, 1)*sizeof(int));
+    GGML_ASSERT(dag->succ);
+
+    for (int i = 0, offs = 0; i < n_nodes; ++i) {
+        dag->nodes[i].i_succ = offs;
+        offs += dag->nodes[i].n_succ;
+        dag->nodes[i].n_succ = 0;
+    }
+
+    for (int e = 0; e < edges.n; ++e) {
+        struct ggml_dag_node * dn = &dag->nodes[edges.from[e]];
+        dag->succ[dn->i_succ + dn->n_succ++] = edges.to[e];
+    }
+
+    free(edges.from);
+    free(edges.to);
+    free(mark);
+    free(max_end);
+    free(ranges);
+
+    return dag;
+}
+
+static void ggml_dag_free(struct ggml_dag * dag) {
+    ggml_mutex_destroy(&dag->mutex);
+
+    free(dag->succ);
+    free(dag->queue);
+    free(dag->data);
+    free(dag->nodes);
+    free(dag);
+}
+
+// true if the dag was built for a graph with the same nodes at the same addresses
+static bool ggml_dag_matches(const struct ggml_dag * dag, const struct ggml_cgraph * cgraph) {
+    if (dag->n_nodes != cgraph->n_nodes) {
+        return false;
+    }
+
+    for (int i = 0; i < cgraph->n_nodes; ++i) {
+        const void * data[GGML_MAX_SRC + 1];
+        ggml_dag_tensor_data(cgraph, i, data);
+
+        if (memcmp(data, dag->data + i*(GGML_MAX_SRC + 1), sizeof(data)) != 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the state of a compute: nothing is ready, completed or handed out
+static void ggml_dag_reset(struct ggml_dag * dag, enum ggml_wait_policy wait_policy, int wait_spin_count) {
+    dag->head = 0;
+    dag->tail = 0;
+
+    atomic_store(&dag->n_completed, 0);
+    atomic_store(&dag->n_inflight,  0);
+    atomic_store(&dag->aborted,     0);
+
+    for (int i = 0; i < dag->n_nodes; ++i) {
+        struct ggml_dag_node * dn = &dag->nodes[i];
+
+        dn->n_joined = 0;
+
+        atomic_store(&dn->n_pending, dn->n_deps);
+        atomic_store(&dn->n_done,    0);
+
+        dn->barrier = (struct ggml_compute_barrier) {
+            /*.n_arrived       =*/ 0,
+            /*.n_passed        =*/ 0,
+            /*.n_chunks        =*/ { 0 },
+            /*.wait_policy     =*/ wait_policy,
+            /*.wait_spin_count =*/ wait_spin_count,
+        };
+    }
+}
+
+// makes a node available to the threads once its dependencies completed, after running its INIT pass
+static void ggml_dag_push(struct ggml_compute_state_shared * shared, int i) {
+    struct ggml_dag      * dag  = shared->dag;
+    struct ggml_dag_node * dn   = &dag->nodes[i];
+    struct ggml_tensor   * node = shared->cgraph->nodes[i];
+
+    if (GGML_OP_HAS_INIT[node->op]) {
+        struct ggml_compute_params_sched sched = {
+            /*.params  =*/ {
+                /*.type  =*/ GGML_TASK_INIT,
+                /*.ith   =*/ 0,
+                /*.nth   =*/ dn->n_tasks,
+                /*.wsize =*/ shared->cplan->work_size,
+                /*.wdata =*/ shared->cplan->work_data,
+            },
+            /*.magic   =*/ GGML_COMPUTE_PARAMS_SCHED_MAGIC,
+            /*.barrier =*/ &dn->barrier,
+        };
+        struct ggml_compute_params * params = &sched.params;
+        ggml_compute_forward(params, node);
+    }
+
+    atomic_fetch_add(&dag->n_inflight, 1);
+
+    ggml_mutex_lock(&dag->mutex);
+    dag->queue[dag->tail++] = i;
+    ggml_mutex_unlock(&dag->mutex);
+}
+
+// hands out the next team slot of the oldest ready node that is not fully staffed
+// only the head of the queue can be partially staffed, so every team eventually completes
+static bool ggml_dag_join(struct ggml_dag * dag, int * i, int * ith) {
+    bool found = false;
+
+    ggml_mutex_lock(&dag->mutex);
+    if (dag->head < dag->tail) {
+        struct ggml_dag_node * dn = &dag->nodes[dag->queue[dag->head]];
+
+        *i   = dag->queue[dag->head];
+        *ith = dn->n_joined++;
+
+        if (dn->n_joined == dn->n_tasks) {
+            dag->head++;
+        }
+
+        found = true;
+    }
+    ggml_mutex_unlock(&dag->mutex);
 
-            case GGML_OP_CROSS_ENTROPY_LOSS:
-                {
-                    n_tasks = n_threads;
+    return found;
+}
 
-                    cur = ggml_type_size(node->type)*(n_tasks + node->src[0]->ne[0]*n_tasks);
-                } break;
-            case GGML_OP_COUNT:
-                {
-                    GGML_ASSERT(false);
-                } break;
-            default:
+static void ggml_dag_complete(struct ggml_compute_state_shared * shared, int i) {
+    struct ggml_dag           * dag   = shared->dag;
+    const struct ggml_dag_node * dn    = &dag->nodes[i];
+    const struct ggml_cplan    * cplan = shared->cplan;
+
+    if (cplan->abort_callback && cplan->abort_callback(cplan->abort_callback_data)) {
+        atomic_store(&dag->aborted, 1);
+    }
+
+    if (!atomic_load(&dag->aborted)) {
+        for (int k = 0; k < dn->n_succ; ++k) {
+            const int s = dag->succ[dn->i_succ + k];
+            if (atomic_fetch_sub(&dag->nodes[s].n_pending, 1) == 1) {
+                ggml_dag_push(shared, s);
+            }
+        }
+    }
+
+    // the successors are in flight before this node leaves, so n_inflight only reaches 0 at the end
+    atomic_fetch_add(&dag->n_completed, 1);
+    atomic_fetch_sub(&dag->n_inflight,  1);
+}
+
+static bool ggml_dag_finished(struct ggml_dag * dag) {
+    return atomic_load(&dag->n_completed) == dag->n_nodes ||
+          (atomic_load(&dag->aborted) && atomic_load(&dag->n_inflight) == 0);
+}
+
+static thread_ret_t ggml_graph_compute_thread_dag(struct ggml_compute_state * state) {
+    struct ggml_compute_state_shared * shared = state->shared;
+    struct ggml_dag                  * dag    = shared->dag;
+
+    const struct ggml_cplan * cplan = shared->cplan;
+
+    set_numa_thread_affinity(state->ith, shared->n_threads);
+
+    int     n_spin = 0;
+    int64_t t_wait = -1;
+
+    while (true) {
+        int i;
+        int ith;
+
+        if (!ggml_dag_join(dag, &i, &ith)) {
+            if (ggml_dag_finished(dag)) {
                 break;
+            }
+
+            // nothing is ready: the threads of a graph never sleep here, they yield after the spin budget
+            if (t_wait < 0) {
+                t_wait = ggml_time_us();
+            }
+            if (shared->wait_policy != GGML_WAIT_POLICY_SPIN && ++n_spin > shared->wait_spin_count) {
+                sched_yield();
+            }
+            continue;
+        }
+
+        if (t_wait >= 0) {
+            state->wait_time_us += ggml_time_us() - t_wait;
+            t_wait = -1;
         }
+        n_spin = 0;
 
-        work_size = MAX(work_size, cur);
+        struct ggml_tensor   * node = shared->cgraph->nodes[i];
+        struct ggml_dag_node * dn   = &dag->nodes[i];
+
+        struct ggml_compute_params_sched sched = {
+            /*.params  =*/ {
+                /*.type  =*/ GGML_TASK_COMPUTE,
+                /*.ith   =*/ ith,
+                /*.nth   =*/ dn->n_tasks,
+                /*.wsize =*/ cplan->work_size,
+                /*.wdata =*/ cplan->work_data,
+            },
+            /*.magic   =*/ GGML_COMPUTE_PARAMS_SCHED_MAGIC,
+            /*.barrier =*/ &dn->barrier,
+        };
+        struct ggml_compute_params * params = &sched.params;
+
+        ggml_compute_forward(params, node);
+
+        // the last member of the team finalizes the node and releases the nodes that depend on it
+        if (atomic_fetch_add(&dn->n_done, 1) == dn->n_tasks - 1) {
+            if (GGML_OP_HAS_FINALIZE[node->op]) {
+                params->type = GGML_TASK_FINALIZE;
+                params->ith  = 0;
+                ggml_compute_forward(params, node);
+            }
+
+            ggml_dag_complete(shared, i);
+        }
     }
 
-    if (work_size > 0) {
-        work_size += CACHE_LINE_SIZE*(n_threads - 1);
+    if (t_wait >= 0) {
+        state->wait_time_us += ggml_time_us() - t_wait;
     }
 
-    cplan.n_threads = n_threads;
-    cplan.work_size = work_size;
-    cplan.work_data = NULL;
+    return (thread_ret_t) (size_t) (atomic_load(&dag->aborted) ? GGML_EXIT_ABORTED : GGML_EXIT_SUCCESS);
+}
 
-    return cplan;
+// ggml_threadpool
+
+// a graph computed by ggml_graph_compute_async
+struct ggml_compute_future {
+    struct ggml_cgraph * cgraph;
+    struct ggml_cplan    cplan;
+
+    ggml_thread_t thrd; // the thread created to compute the graph, when own_thread
+    bool          own_thread;
+
+    ggml_mutex_t mutex;
+    ggml_cond_t  cond; // signaled when done is set
+    bool         done;
+    int          status;
+};
+
+static void ggml_compute_future_complete(struct ggml_compute_future * future, int status) {
+    ggml_mutex_lock(&future->mutex);
+    future->status = status;
+    future->done   = true;
+    ggml_cond_broadcast(&future->cond);
+    ggml_mutex_unlock(&future->mutex);
+}
+
+static thread_ret_t ggml_compute_future_thread(void * data) {
+    struct ggml_compute_future * future = (struct ggml_compute_future *) data;
+
+    ggml_compute_future_complete(future, ggml_graph_compute(future->cgraph, &future->cplan));
+
+    return 0;
+}
+
+struct ggml_threadpool_worker {
+    ggml_thread_t            thrd;
+    struct ggml_threadpool * threadpool;
+
+    struct ggml_compute_state * task; // the thread of a graph to run, protected by the pool mutex
+};
+
+// the pool is shared by the graphs computed on it concurrently, each one holds a number of slots: the
+// thread calling ggml_graph_compute and the pool workers running its other threads. the slots are
+// split by weight, so the threads of all graphs together never exceed the size of the pool
+struct ggml_threadpool {
+    ggml_mutex_t mutex;
+    ggml_cond_t  cond_work;  // a worker was given a task or the pool is stopping
+    ggml_cond_t  cond_done;  // a worker finished its task or a graph released its slots
+    ggml_cond_t  cond_async; // a graph was posted by ggml_graph_compute_async or the pool is stopping
+
+    int n_threads;
+    struct ggml_threadpool_worker * workers; // [n_threads], workers[0] is unused: the calling threads take its place
+
+    // protected by mutex
+    int  n_used;         // slots held by the graphs being computed
+    int  n_leaving;      // slots the graphs being computed are giving back, see ggml_threadpool_rebalance
+    int  weight_running; // total weight of the graphs being computed
+    bool stop;
+
+    atomic_int weight_waiting; // total weight of the graphs waiting for a slot, updated with mutex held
+
+    // the thread calling ggml_graph_compute for ggml_graph_compute_async, created on first use
+    ggml_thread_t                async_thrd;
+    bool                         async_started;
+    struct ggml_compute_future * async_future; // protected by mutex
+};
+
+static thread_ret_t ggml_threadpool_async(void * data) {
+    struct ggml_threadpool * tp = (struct ggml_threadpool *) data;
+
+    while (true) {
+        ggml_mutex_lock(&tp->mutex);
+        while (!tp->stop && tp->async_future == NULL) {
+            ggml_cond_wait(&tp->cond_async, &tp->mutex);
+        }
+        struct ggml_compute_future * future = tp->async_future;
+        ggml_mutex_unlock(&tp->mutex);
+
+        if (future == NULL) {
+            break;
+        }
+
+        // the graph takes the place of the calling thread as worker 0
+        const int status = ggml_graph_compute(future->cgraph, &future->cplan);
+
+        // free the async thread before the future completes, so that its waiter can submit the next graph
+        ggml_mutex_lock(&tp->mutex);
+        tp->async_future = NULL;
+        ggml_mutex_unlock(&tp->mutex);
+
+        ggml_compute_future_complete(future, status);
+    }
+
+    return 0;
+}
+
+static thread_ret_t ggml_threadpool_worker(void * data) {
+    struct ggml_threadpool_worker * worker = (struct ggml_threadpool_worker *) data;
+    struct ggml_threadpool        * tp     = worker->threadpool;
+
+    while (true) {
+        ggml_mutex_lock(&tp->mutex);
+        while (!tp->stop && worker->task == NULL) {
+            ggml_cond_wait(&tp->cond_work, &tp->mutex);
+        }
+        struct ggml_compute_state * state = worker->task;
+        ggml_mutex_unlock(&tp->mutex);
+
+        if (state == NULL) {
+            break;
+        }
+
+        ggml_graph_compute_thread(state);
+
+        ggml_mutex_lock(&tp->mutex);
+        worker->task = NULL;
+        state->shared->n_pool_tasks--;
+        if (state->ith >= atomic_load(&state->shared->n_threads_cur)) {
+            // the thread left the graph at a node boundary, its slot is free for the waiting graphs
+            tp->n_used--;
+            tp->n_leaving--;
+        }
+        ggml_cond_broadcast(&tp->cond_done);
+        ggml_mutex_unlock(&tp->mutex);
+    }
+
+    return 0;
+}
+
+struct ggml_threadpool * ggml_threadpool_new(int n_threads) {
+    GGML_ASSERT(n_threads > 0);
+
+    struct ggml_threadpool * tp = malloc(sizeof(struct ggml_threadpool));
+    GGML_ASSERT(tp);
+
+    ggml_mutex_init(&tp->mutex);
+    ggml_cond_init(&tp->cond_work);
+    ggml_cond_init(&tp->cond_done);
+    ggml_cond_init(&tp->cond_async);
+
+    tp->n_threads      = n_threads;
+    tp->workers        = malloc(sizeof(struct ggml_threadpool_worker)*n_threads);
+    tp->n_used         = 0;
+    tp->n_leaving      = 0;
+    tp->weight_running = 0;
+    tp->stop           = false;
+
+    atomic_store(&tp->weight_waiting, 0);
+
+    tp->async_started = false;
+    tp->async_future  = NULL;
+
+    GGML_ASSERT(tp->workers);
+
+    for (int j = 0; j < n_threads; ++j) {
+        tp->workers[j] = (struct ggml_threadpool_worker) {
+            .thrd       = 0,
+            .threadpool = tp,
+            .task       = NULL,
+        };
+    }
+
+    for (int j = 1; j < n_threads; ++j) {
+        const int rc = ggml_thread_create(&tp->workers[j].thrd, NULL, ggml_threadpool_worker, &tp->workers[j]);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    return tp;
+}
+
+void ggml_threadpool_free(struct ggml_threadpool * tp) {
+    if (tp == NULL) {
+        return;
+    }
+
+    ggml_mutex_lock(&tp->mutex);
+    GGML_ASSERT(tp->n_used == 0 && tp->async_future == NULL && "the thread pool is still computing a graph");
+    tp->stop = true;
+    ggml_cond_broadcast(&tp->cond_work);
+    ggml_cond_broadcast(&tp->cond_async);
+    ggml_mutex_unlock(&tp->mutex);
+
+    for (int j = 1; j < tp->n_threads; ++j) {
+        const int rc = ggml_thread_join(tp->workers[j].thrd, NULL);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    if (tp->async_started) {
+        const int rc = ggml_thread_join(tp->async_thrd, NULL);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    ggml_cond_destroy(&tp->cond_async);
+    ggml_cond_destroy(&tp->cond_done);
+    ggml_cond_destroy(&tp->cond_work);
+    ggml_mutex_destroy(&tp->mutex);
+
+    free(tp->workers);
+    free(tp);
+}
+
+int ggml_threadpool_get_n_threads(const struct ggml_threadpool * tp) {
+    return tp->n_threads;
+}
+
+// the share of the pool of a graph of the given weight, out of the total weight of the graphs running or waiting
+static int ggml_threadpool_share(const struct ggml_threadpool * tp, int weight, int weight_total) {
+    return MAX(1, (int) ((int64_t) tp->n_threads*weight/weight_total));
+}
+
+// waits for a free slot and returns the number of threads the graph gets: at most n_threads, its
+// share of the pool by weight among the graphs running or waiting, and the slots that are free
+// the running graphs above their share give threads back at their next node boundary, the graph
+// waits for these before taking fewer threads than its share
+static int ggml_threadpool_acquire(struct ggml_threadpool * tp, int n_threads, int weight) {
+    ggml_mutex_lock(&tp->mutex);
+
+    atomic_fetch_add(&tp->weight_waiting, weight);
+
+    int n_want;
+    while (true) {
+        const int weight_total = tp->weight_running + atomic_load(&tp->weight_waiting);
+        const int n_free       = tp->n_threads - tp->n_used;
+
+        n_want = MIN(n_threads, ggml_threadpool_share(tp, weight, weight_total));
+
+        if (n_free >= n_want || (n_free > 0 && tp->n_leaving == 0)) {
+            break;
+        }
+        ggml_cond_wait(&tp->cond_done, &tp->mutex);
+    }
+
+    atomic_fetch_sub(&tp->weight_waiting, weight);
+
+    const int n = MIN(n_want, tp->n_threads - tp->n_used);
+
+    tp->n_used         += n;
+    tp->weight_running += weight;
+
+    ggml_mutex_unlock(&tp->mutex);
+
+    return n;
+}
+
+// called at a node boundary of a graph holding n_threads slots: when other graphs wait for the pool,
+// returns the share of the graph and counts the threads above it as leaving
+// only for the sequential executor, the teams of the dag executor need all the threads they were sized for
+static int ggml_threadpool_rebalance(struct ggml_threadpool * tp, int n_threads, int weight) {
+    if (atomic_load(&tp->weight_waiting) == 0) {
+        return n_threads;
+    }
+
+    ggml_mutex_lock(&tp->mutex);
+
+    const int weight_total = tp->weight_running + atomic_load(&tp->weight_waiting);
+    const int n            = MIN(n_threads, ggml_threadpool_share(tp, weight, weight_total));
+
+    tp->n_leaving += n_threads - n;
+
+    ggml_mutex_unlock(&tp->mutex);
+
+    return n;
+}
+
+static void ggml_threadpool_release(struct ggml_threadpool * tp, int n_threads, int weight) {
+    ggml_mutex_lock(&tp->mutex);
+    tp->n_used         -= n_threads;
+    tp->weight_running -= weight;
+    ggml_cond_broadcast(&tp->cond_done);
+    ggml_mutex_unlock(&tp->mutex);
+}
+
+// runs the graph on idle workers of the pool, the calling thread acts as worker 0
+// the slots of the graph were taken with ggml_threadpool_acquire
+static int ggml_threadpool_compute(struct ggml_threadpool * tp, struct ggml_compute_state * workers, struct ggml_compute_state_shared * shared) {
+    const int n_threads = shared->n_threads;
+
+    for (int j = 0; j < n_threads; ++j) {
+        workers[j] = (struct ggml_compute_state) {
+            .thrd          = 0,
+            .ith           = j,
+            .shared        = shared,
+            .wait_time_us  = 0,
+            .wait_n_sleeps = 0,
+        };
+    }
+
+    ggml_mutex_lock(&tp->mutex);
+    shared->n_pool_tasks = n_threads - 1;
+    // the slots held by all graphs leave at least n_threads - 1 workers idle
+    for (int j = 1, k = 1; j < n_threads; ++k) {
+        GGML_ASSERT(k < tp->n_threads);
+        if (tp->workers[k].task == NULL) {
+            tp->workers[k].task = &workers[j++];
+        }
+    }
+    ggml_cond_broadcast(&tp->cond_work);
+    ggml_mutex_unlock(&tp->mutex);
+
+    const int compute_status = (size_t) ggml_graph_compute_thread(&workers[0]);
+
+    // wait for every worker to let go of shared before it goes out of scope
+    ggml_mutex_lock(&tp->mutex);
+    while (shared->n_pool_tasks > 0) {
+        ggml_cond_wait(&tp->cond_done, &tp->mutex);
+    }
+    ggml_mutex_unlock(&tp->mutex);
+
+    return compute_status;
+}
+
+// runs the graph on n_threads - 1 threads created for this call and the calling thread
+static int ggml_graph_compute_threads(struct ggml_compute_state * workers, struct ggml_compute_state_shared * state_shared) {
+    const int n_threads = state_shared->n_threads;
+
+    // create thread pool
+    if (n_threads > 1) {
+        for (int j = 1; j < n_threads; ++j) {
+            workers[j] = (struct ggml_compute_state) {
+                .thrd          = 0,
+                .ith           = j,
+                .shared        = state_shared,
+                .wait_time_us  = 0,
+                .wait_n_sleeps = 0,
+            };
+
+            const int rc = ggml_thread_create(&workers[j].thrd, NULL, ggml_graph_compute_thread, &workers[j]);
+            GGML_ASSERT(rc == 0);
+            UNUSED(rc);
+        }
+    }
+
+    workers[0] = (struct ggml_compute_state) {
+        .thrd          = 0,
+        .ith           = 0,
+        .shared        = state_shared,
+        .wait_time_us  = 0,
+        .wait_n_sleeps = 0,
+    };
+
+    // this is a work thread too
+    int compute_status = (size_t) ggml_graph_compute_thread(&workers[0]);
+
+    // join or kill thread pool
+    if (n_threads > 1) {
+        for (int j = 1; j < n_threads; j++) {
+            const int rc = ggml_thread_join(workers[j].thrd, NULL);
+            GGML_ASSERT(rc == 0);
+        }
+    }
+
+    return compute_status;
 }
 
 int ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
@@ -16400,13 +20065,42 @@ int ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
         if (cplan->work_size > 0) {
             GGML_ASSERT(cplan->work_data);
         }
+
+        if (cplan->threadpool) {
+            GGML_ASSERT(cplan->n_threads <= cplan->threadpool->n_threads);
+        }
+
+        if (cplan->cache) {
+            // the cache planned another graph since
+            GGML_ASSERT(cplan->cache->n_nodes   == cgraph->n_nodes);
+            GGML_ASSERT(cplan->cache->n_threads == cplan->n_threads);
+        }
+    }
+
+    struct ggml_threadpool * tp = cplan->threadpool;
+
+    // on a pool shared with other graphs, the graph may get fewer threads than planned
+    const int weight    = cplan->weight > 0 ? cplan->weight : 1;
+    const int n_threads = tp ? ggml_threadpool_acquire(tp, cplan->n_threads, weight) : cplan->n_threads;
+
+    // the plan as computed, the cached task counts are only valid for the planned number of threads
+    struct ggml_cplan plan = *cplan;
+    plan.n_threads = n_threads;
+    if (n_threads != cplan->n_threads) {
+        plan.cache = NULL;
     }
 
-    const int n_threads = cplan->n_threads;
+    const int wait_spin_count = cplan->wait_spin_count > 0 ? cplan->wait_spin_count : GGML_WAIT_SPIN_COUNT_DEFAULT;
+
+    ggml_mutex_t wait_mutex;
+    ggml_cond_t  wait_cond;
+
+    ggml_mutex_init(&wait_mutex);
+    ggml_cond_init(&wait_cond);
 
     struct ggml_compute_state_shared state_shared = {
         /*.cgraph                  =*/ cgraph,
-        /*.cgraph_plan             =*/ cplan,
+        /*.cgraph_plan             =*/ &plan,
         /*.perf_node_start_cycles  =*/ 0,
         /*.perf_node_start_time_us =*/ 0,
         /*.n_threads               =*/ n_threads,
@@ -16414,62 +20108,154 @@ int ggml_graph_compute(struct ggml_cgraph * cgraph, struct ggml_cplan * cplan) {
         /*.node_n                  =*/ -1,
         /*.abort_callback          =*/ NULL,
         /*.abort_callback_data     =*/ NULL,
+        /*.wait_policy             =*/ cplan->wait_policy,
+        /*.wait_spin_count         =*/ wait_spin_count,
+        /*.barrier                 =*/ { 0, 0, { 0 }, cplan->wait_policy, wait_spin_count },
+        /*.n_sleeping              =*/ 0,
+        /*.mutex                   =*/ &wait_mutex,
+        /*.cond                    =*/ &wait_cond,
+        /*.dag                     =*/ NULL,
+        /*.n_pool_tasks            =*/ 0,
+        /*.threadpool              =*/ tp,
+        /*.weight                  =*/ weight,
+        /*.n_threads_cur           =*/ n_threads,
     };
+
     struct ggml_compute_state * workers = alloca(sizeof(struct ggml_compute_state)*n_threads);
+    int compute_status;
 
-    // create thread pool
-    if (n_threads > 1) {
-        for (int j = 1; j < n_threads; ++j) {
-            workers[j] = (struct ggml_compute_state) {
-                .thrd   = 0,
-                .ith = j,
-                .shared = &state_shared,
-            };
+    const int64_t perf_start_cycles  = ggml_perf_cycles();
+    const int64_t perf_start_time_us = ggml_perf_time_us();
 
-            const int rc = ggml_thread_create(&workers[j].thrd, NULL, ggml_graph_compute_thread, &workers[j]);
-            GGML_ASSERT(rc == 0);
-            UNUSED(rc);
+    if (cplan->dag && n_threads > 1) {
+        struct ggml_cplan_cache * cache = plan.cache;
+
+        if (cache && cache->dag && ggml_dag_matches(cache->dag, cgraph)) {
+            state_shared.dag = cache->dag;
+        } else {
+            state_shared.dag = ggml_dag_new(cgraph, n_threads);
+
+            if (cache) {
+                if (cache->dag) {
+                    ggml_dag_free(cache->dag);
+                }
+                cache->dag = state_shared.dag;
+            }
         }
-    }
 
-    workers[0].ith = 0;
-    workers[0].shared = &state_shared;
+        ggml_dag_reset(state_shared.dag, cplan->wait_policy, wait_spin_count);
 
-    const int64_t perf_start_cycles  = ggml_perf_cycles();
-    const int64_t perf_start_time_us = ggml_perf_time_us();
+        // the nodes without dependencies are ready from the start
+        for (int i = 0; i < cgraph->n_nodes; ++i) {
+            if (state_shared.dag->nodes[i].n_deps == 0) {
+                ggml_dag_push(&state_shared, i);
+            }
+        }
+    }
 
-    // this is a work thread too
-    int compute_status = (size_t) ggml_graph_compute_thread(&workers[0]);
+    if (tp) {
+        compute_status = ggml_threadpool_compute(tp, workers, &state_shared);
+        // the threads that left the graph early gave their slots back already
+        ggml_threadpool_release(tp, atomic_load(&state_shared.n_threads_cur), weight);
+    } else {
+        compute_status = ggml_graph_compute_threads(workers, &state_shared);
+    }
 
     // don't leave affinity set on the main thread
     clear_numa_thread_affinity();
 
-    // join or kill thread pool
-    if (n_threads > 1) {
-        for (int j = 1; j < n_threads; j++) {
-            const int rc = ggml_thread_join(workers[j].thrd, NULL);
-            GGML_ASSERT(rc == 0);
+    cplan->wait_time_us  = 0;
+    cplan->wait_n_sleeps = 0;
+    for (int j = 0; j < n_threads; ++j) {
+        cplan->wait_time_us  += workers[j].wait_time_us;
+        cplan->wait_n_sleeps += workers[j].wait_n_sleeps;
+    }
+
+    if (state_shared.dag && (plan.cache == NULL || plan.cache->dag != state_shared.dag)) {
+        ggml_dag_free(state_shared.dag);
+    }
+
+    ggml_cond_destroy(&wait_cond);
+    ggml_mutex_destroy(&wait_mutex);
+
+    ggml_graph_compute_perf_stats_graph(cgraph, perf_start_cycles, perf_start_time_us);
+
+    return compute_status;
+}
+
+struct ggml_compute_future * ggml_graph_compute_async(struct ggml_cgraph * cgraph, const struct ggml_cplan * cplan) {
+    struct ggml_compute_future * future = malloc(sizeof(struct ggml_compute_future));
+    GGML_ASSERT(future);
+
+    future->cgraph     = cgraph;
+    future->cplan      = *cplan;
+    future->thrd       = 0;
+    future->own_thread = false;
+    future->done       = false;
+    future->status     = GGML_EXIT_SUCCESS;
+
+    ggml_mutex_init(&future->mutex);
+    ggml_cond_init(&future->cond);
+
+    struct ggml_threadpool * tp = cplan->threadpool;
+
+    if (tp) {
+        ggml_mutex_lock(&tp->mutex);
+        if (tp->async_future == NULL) {
+            if (!tp->async_started) {
+                const int rc = ggml_thread_create(&tp->async_thrd, NULL, ggml_threadpool_async, tp);
+                GGML_ASSERT(rc == 0);
+                UNUSED(rc);
+                tp->async_started = true;
+            }
+            tp->async_future = future;
+            ggml_cond_broadcast(&tp->cond_async);
+        } else {
+            // the async thread of the pool is busy with another graph, both share the workers of the pool
+            future->own_thread = true;
         }
+        ggml_mutex_unlock(&tp->mutex);
+    } else {
+        future->own_thread = true;
     }
 
-    // performance stats (graph)
-    {
-        int64_t perf_cycles_cur  = ggml_perf_cycles()  - perf_start_cycles;
-        int64_t perf_time_us_cur = ggml_perf_time_us() - perf_start_time_us;
+    if (future->own_thread) {
+        const int rc = ggml_thread_create(&future->thrd, NULL, ggml_compute_future_thread, future);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    return future;
+}
+
+bool ggml_compute_future_is_done(struct ggml_compute_future * future) {
+    ggml_mutex_lock(&future->mutex);
+    const bool done = future->done;
+    ggml_mutex_unlock(&future->mutex);
 
-        cgraph->perf_runs++;
-        cgraph->perf_cycles  += perf_cycles_cur;
-        cgraph->perf_time_us += perf_time_us_cur;
+    return done;
+}
 
-        GGML_PRINT_DEBUG("%s: perf (%d) - cpu = %.3f / %.3f ms, wall = %.3f / %.3f ms\n",
-                __func__, cgraph->perf_runs,
-                (double) perf_cycles_cur      / (double) ggml_cycles_per_ms(),
-                (double) cgraph->perf_cycles  / (double) ggml_cycles_per_ms() / (double) cgraph->perf_runs,
-                (double) perf_time_us_cur     / 1000.0,
-                (double) cgraph->perf_time_us / 1000.0 / cgraph->perf_runs);
+int ggml_compute_future_wait(struct ggml_compute_future * future) {
+    ggml_mutex_lock(&future->mutex);
+    while (!future->done) {
+        ggml_cond_wait(&future->cond, &future->mutex);
     }
+    ggml_mutex_unlock(&future->mutex);
 
-    return compute_status;
+    if (future->own_thread) {
+        const int rc = ggml_thread_join(future->thrd, NULL);
+        GGML_ASSERT(rc == 0);
+        UNUSED(rc);
+    }
+
+    const int status = future->status;
+
+    ggml_cond_destroy(&future->cond);
+    ggml_mutex_destroy(&future->mutex);
+    free(future);
+
+    return status;
 }
 
 void ggml_graph_compute_with_ctx(struct ggml_context * ctx, struct ggml_cgraph * cgraph, int n_threads) {
@@ -19385,6 +23171,8 @@ void gguf_get_meta_data(const struct gguf_context * ctx, void * data) {
 int ggml_cpu_has_avx(void) {
 #if defined(__AVX__)
     return 1;
+#elif defined(GGML_CPU_DISPATCH)
+    return g_cpu_level >= GGML_CPU_LEVEL_AVX;
 #else
     return 0;
 #endif
@@ -19393,6 +23181,8 @@ int ggml_cpu_has_avx(void) {
 int ggml_cpu_has_avx2(void) {
 #if defined(__AVX2__)
     return 1;
+#elif defined(GGML_CPU_DISPATCH)
+    return g_cpu_level >= GGML_CPU_LEVEL_AVX2;
 #else
     return 0;
 #endif
@@ -19401,6 +23191,8 @@ int ggml_cpu_has_avx2(void) {
 int ggml_cpu_has_avx512(void) {
 #if defined(__AVX512F__)
     return 1;
+#elif defined(GGML_CPU_DISPATCH)
+    return g_cpu_level >= GGML_CPU_LEVEL_AVX512;
 #else
     return 0;
 #endif
@@ -19425,6 +23217,8 @@ int ggml_cpu_has_avx512_vnni(void) {
 int ggml_cpu_has_fma(void) {
 #if defined(__FMA__)
     return 1;
+#elif defined(GGML_CPU_DISPATCH)
+    return g_cpu_level >= GGML_CPU_LEVEL_AVX2;
 #else
     return 0;
 #endif
@@ -19457,6 +23251,8 @@ int ggml_cpu_has_metal(void) {
 int ggml_cpu_has_f16c(void) {
 #if defined(__F16C__)
     return 1;
+#elif defined(GGML_CPU_DISPATCH)
+    return g_cpu_level >= GGML_CPU_LEVEL_AVX2;
 #else
     return 0;
 #endif
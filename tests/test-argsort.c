@@ -0,0 +1,165 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// checks ggml_argsort and ggml_top_k against a qsort of (value, index) pairs, in both orders, with ties,
+// infinities and -0.0f, short rows, rows sorted by one thread and long rows shared by the threads
+// with the dag executor the nodes can run with fewer threads than planned, the work buffer is followed by
+// a guard that must not be written
+
+struct test_case {
+    int ne0;
+    int ne1;
+    int k;
+    int n_distinct; // 0 for distinct values
+    int n_threads;
+    int dag;
+};
+
+#define GUARD_SIZE 4096
+
+struct pair {
+    float value;
+    int   index;
+};
+
+static int cmp_asc(const void * a, const void * b) {
+    const struct pair * pa = a;
+    const struct pair * pb = b;
+    if (pa->value != pb->value) {
+        return pa->value < pb->value ? -1 : 1;
+    }
+    return pa->index - pb->index;
+}
+
+static int cmp_desc(const void * a, const void * b) {
+    const struct pair * pa = a;
+    const struct pair * pb = b;
+    if (pa->value != pb->value) {
+        return pa->value > pb->value ? -1 : 1;
+    }
+    return pa->index - pb->index;
+}
+
+static float value(int i, int n_distinct) {
+    const unsigned h = (unsigned) i*2654435761u;
+
+    if (n_distinct > 0) {
+        const int v = (int) (h % (unsigned) n_distinct);
+        switch (v) {
+            case 0:  return -INFINITY;
+            case 1:  return INFINITY;
+            case 2:  return -0.0f;
+            case 3:  return 0.0f;
+            default: return (float) (v - n_distinct/2);
+        }
+    }
+
+    return ((float) (h >> 8) - 8388608.0f)/1024.0f;
+}
+
+static int run(struct ggml_context * ctx, const struct test_case * tc) {
+    struct ggml_tensor * a = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, tc->ne0, tc->ne1);
+
+    for (int i = 0; i < tc->ne0*tc->ne1; ++i) {
+        ggml_set_f32_1d(a, i, value(i, tc->n_distinct));
+    }
+
+    struct ggml_tensor * asc  = ggml_argsort(ctx, a, GGML_SORT_ASC);
+    struct ggml_tensor * desc = ggml_argsort(ctx, a, GGML_SORT_DESC);
+    struct ggml_tensor * top  = ggml_top_k(ctx, a, tc->k);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, asc);
+    ggml_build_forward_expand(gf, desc);
+    ggml_build_forward_expand(gf, top);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, tc->n_threads);
+    unsigned char * work = malloc(cplan.work_size + GUARD_SIZE);
+    memset(work + cplan.work_size, 0xA5, GUARD_SIZE);
+    cplan.work_data = work;
+    cplan.dag = tc->dag;
+    ggml_graph_compute(gf, &cplan);
+
+    int n_err = 0;
+
+    for (int i = 0; i < GUARD_SIZE; ++i) {
+        n_err += work[cplan.work_size + i] != 0xA5;
+    }
+    free(work);
+
+    struct pair * ref = malloc(tc->ne0*sizeof(struct pair));
+
+    for (int r = 0; r < tc->ne1; ++r) {
+        for (int order = 0; order < 2; ++order) {
+            for (int j = 0; j < tc->ne0; ++j) {
+                ref[j].value = ggml_get_f32_1d(a, r*tc->ne0 + j);
+                ref[j].index = j;
+            }
+
+            qsort(ref, tc->ne0, sizeof(struct pair), order == 0 ? cmp_asc : cmp_desc);
+
+            const struct ggml_tensor * res = order == 0 ? asc : desc;
+
+            for (int j = 0; j < tc->ne0; ++j) {
+                n_err += ggml_get_i32_1d(res, r*tc->ne0 + j) != ref[j].index;
+            }
+
+            // top k is the start of the descending argsort
+            if (order == 1) {
+                for (int j = 0; j < tc->k; ++j) {
+                    n_err += ggml_get_i32_1d(top, r*tc->k + j) != ref[j].index;
+                }
+            }
+        }
+    }
+
+    free(ref);
+
+    if (n_err > 0) {
+        fprintf(stderr, "%s: ne0 = %d, ne1 = %d, k = %d, n_distinct = %d, n_threads = %d, dag = %d: %d errors\n",
+                __func__, tc->ne0, tc->ne1, tc->k, tc->n_distinct, tc->n_threads, tc->dag, n_err);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 64*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    const struct test_case cases[] = {
+        {     1,  3,   1,  0, 1 },
+        {    16, 10,   4,  0, 2 },
+        {    31,  7,  31,  6, 3 },
+        {   200, 13,  10,  0, 4 },
+        {  1000,  5, 100, 12, 2 },
+        { 20000,  1,  40,  0, 1 },
+        { 20000,  1,  40,  0, 4 },
+        { 30001,  3,  50,  9, 4 },
+        { 50000,  2, 200,  0, 3 },
+        { 40000,  1,   7,  5, 2 },
+        { 16384,  2,  16,  0, 8, 1 },
+        { 10000,  2,  10,  7, 4, 1 },
+        { 20000,  1,  40,  0, 4, 1 },
+        {   200, 13,  10,  0, 4, 1 },
+    };
+
+    int failed = 0;
+    for (int i = 0; i < (int) (sizeof(cases)/sizeof(cases[0])); ++i) {
+        failed |= run(ctx, &cases[i]);
+    }
+
+    ggml_free(ctx);
+
+    return failed;
+}
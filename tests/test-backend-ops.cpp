@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <array>
 #include <cfloat>
+#include <cmath>
 #include <cstring>
 #include <functional>
 #include <memory>
@@ -852,6 +853,47 @@ struct test_argsort : public test_case {
     }
 };
 
+// GGML_OP_TOP_K
+struct test_top_k : public test_case {
+    const ggml_type type;
+    const std::array<int64_t, 4> ne;
+    const int k;
+
+    std::string vars() override {
+        return VARS_TO_STR3(type, ne, k);
+    }
+
+    test_top_k(ggml_type type = GGML_TYPE_F32,
+            std::array<int64_t, 4> ne = {16, 10, 10, 10},
+            int k = 4)
+        : type(type), ne(ne), k(k) {}
+
+    ggml_tensor * build_graph(ggml_context * ctx) override {
+        ggml_tensor * a = ggml_new_tensor(ctx, type, 4, ne.data());
+        ggml_tensor * out = ggml_top_k(ctx, a, k);
+        return out;
+    }
+
+    void initialize_tensors(ggml_context * ctx) override {
+        std::random_device rd;
+        std::default_random_engine rng(rd());
+        for (ggml_tensor * t = ggml_get_first_tensor(ctx); t != NULL; t = ggml_get_next_tensor(ctx, t)) {
+            if (t->type != GGML_TYPE_F32) {
+                continue;
+            }
+            // initialize with unique values to avoid ties
+            for (int64_t r = 0; r < ggml_nrows(t); r++) {
+                std::vector<float> data(t->ne[0]);
+                for (int i = 0; i < t->ne[0]; i++) {
+                    data[i] = i;
+                }
+                std::shuffle(data.begin(), data.end(), rng);
+                ggml_backend_tensor_set(t, data.data(), r * t->nb[1], t->ne[0] * sizeof(float));
+            }
+        }
+    }
+};
+
 // GGML_OP_MUL_MAT_ID
 struct test_mul_mat_id : public test_case {
     const ggml_type type_a;
@@ -1039,6 +1081,9 @@ static bool test_backend(ggml_backend_t backend, test_mode mode, const char * op
         test_cases.emplace_back(new test_argsort(GGML_TYPE_F32, {16, 10, 10, 10}, order));
     }
 
+    test_cases.emplace_back(new test_top_k(GGML_TYPE_F32, {16, 10, 10, 10}, 4));
+    test_cases.emplace_back(new test_top_k(GGML_TYPE_F32, {60000, 2, 1, 1}, 40));
+
     for (ggml_type type_a : all_types) {
         for (ggml_type type_b : {GGML_TYPE_F32 /*, GGML_TYPE_F16 */}) {
             for (int n_mats : {1, 2, 4}) {
@@ -1066,6 +1111,114 @@ static bool test_backend(ggml_backend_t backend, test_mode mode, const char * op
     return n_ok == test_cases.size();
 }
 
+// the comparison with the CPU backend cannot catch an approximation error of the CPU kernels themselves:
+// check the activations and soft_max of the CPU against a double precision reference
+static bool test_cpu_accuracy(const char * op_name) {
+    ggml_init_params params = {
+        /* .mem_size = */ 64*1024*1024,
+        /* .mem_base = */ NULL,
+        /* .no_alloc = */ false,
+    };
+    ggml_context * ctx = ggml_init(params);
+
+    // rows not a multiple of the SIMD width, a dense grid over [-20, 20] and a few large values
+    const int64_t ne0 = 1001;
+    const int64_t ne1 = 100;
+
+    ggml_tensor * x = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, ne0, ne1);
+    float * xd = (float *) x->data;
+    for (int64_t i = 0; i < ne0*ne1; i++) {
+        xd[i] = -20.0f + 40.0f*i/(ne0*ne1 - 1);
+    }
+    xd[1] = -1e4f;
+    xd[2] = -100.0f;
+    xd[ne0*ne1 - 2] = 100.0f;
+    xd[ne0*ne1 - 1] = 1e4f;
+
+    // soft_max rows with masked values and a spread of 60 around the maximum
+    ggml_tensor * s = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, ne0, 16);
+    float * sd = (float *) s->data;
+    std::default_random_engine rng(0);
+    std::uniform_real_distribution<float> dist(-30.0f, 30.0f);
+    for (int64_t i = 0; i < ggml_nelements(s); i++) {
+        sd[i] = i % 7 == 3 ? -INFINITY : dist(rng);
+    }
+
+    struct accuracy_case {
+        const char  * name;
+        ggml_tensor * out;
+        double     (* ref)(double);
+    };
+
+    const accuracy_case cases[] = {
+        { "GELU",       ggml_gelu(ctx, x),       [](double v) { return 0.5*v*(1.0 + std::tanh(0.79788456080286535588*v*(1.0 + 0.044715*v*v))); } },
+        { "GELU_QUICK", ggml_gelu_quick(ctx, x), [](double v) { return v/(1.0 + std::exp(-1.702*v)); } },
+        { "SILU",       ggml_silu(ctx, x),       [](double v) { return v/(1.0 + std::exp(-v)); } },
+        { "SOFT_MAX",   ggml_soft_max(ctx, s),   nullptr },
+    };
+
+    ggml_cgraph * gf = ggml_new_graph(ctx);
+    for (const accuracy_case & c : cases) {
+        ggml_build_forward_expand(gf, c.out);
+    }
+    ggml_graph_compute_with_ctx(ctx, gf, 2);
+
+    // max error relative to the reference, or to 1e-3 for smaller values
+    const double max_err = 1e-5;
+
+    bool ok = true;
+
+    for (const accuracy_case & c : cases) {
+        if (op_name != nullptr && strcmp(op_name, c.name) != 0) {
+            continue;
+        }
+
+        const float * y = (const float *) c.out->data;
+        const int64_t nr = ggml_nrows(c.out);
+
+        std::vector<double> ref(ne0);
+
+        double err = 0.0;
+        for (int64_t r = 0; r < nr; r++) {
+            const float * src = (const float *) c.out->src[0]->data + r*ne0;
+            if (c.ref) {
+                for (int64_t i = 0; i < ne0; i++) {
+                    ref[i] = c.ref(src[i]);
+                }
+            } else {
+                double max = -INFINITY;
+                for (int64_t i = 0; i < ne0; i++) {
+                    max = std::max(max, (double) src[i]);
+                }
+                double sum = 0.0;
+                for (int64_t i = 0; i < ne0; i++) {
+                    ref[i] = std::exp(src[i] - max);
+                    sum += ref[i];
+                }
+                for (int64_t i = 0; i < ne0; i++) {
+                    ref[i] /= sum;
+                }
+            }
+            for (int64_t i = 0; i < ne0; i++) {
+                const double v = y[r*ne0 + i];
+                err = std::isnan(v) ? INFINITY : std::max(err, std::fabs(v - ref[i])/std::max(std::fabs(ref[i]), 1e-3));
+            }
+        }
+
+        printf("  %s: max error = %e: ", c.name, err);
+        if (err <= max_err) {
+            printf("\033[1;32mOK\033[0m\n");
+        } else {
+            printf("\033[1;31mFAIL\033[0m\n");
+            ok = false;
+        }
+    }
+
+    ggml_free(ctx);
+
+    return ok;
+}
+
 static void usage(char ** argv) {
     // command line: test-backend-ops [mode] [-o op] [-b backend]
     // modes are correctness (compare with CPU) or performance
@@ -1138,7 +1291,15 @@ int main(int argc, char ** argv) {
     }
 
     printf("%zu/%zu backends passed\n", n_ok, ggml_backend_reg_get_count());
-    if (n_ok != ggml_backend_reg_get_count()) {
+
+    bool accuracy_ok = true;
+    if (mode == MODE_TEST && (backend == NULL || strcmp(backend, "CPU") == 0)) {
+        printf("\nCPU accuracy\n");
+        accuracy_ok = test_cpu_accuracy(op_name);
+        printf("\n");
+    }
+
+    if (n_ok != ggml_backend_reg_get_count() || !accuracy_ok) {
         printf("\033[1;31mFAIL\033[0m\n");
         return 1;
     } else {
@@ -204,6 +204,72 @@ struct ggml_cgraph * compute_graph(const test_model & model, struct ggml_allocr
     return gf;
 }
 
+// ggml_conv_2d with zero padding and a batch of N > 1 against a direct convolution,
+// the result is [N, OC, OH, OW] with a different value for every batch and channel
+static bool test_conv2d_batched(void) {
+    const int KW = 3, KH = 2, IC = 3, OC = 4;
+    const int IW = 7, IH = 5, N = 3;
+    const int s0 = 2, s1 = 1, p0 = 1, p1 = 1, d0 = 1, d1 = 2;
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * a = ggml_new_tensor_4d(ctx, GGML_TYPE_F16, KW, KH, IC, OC);
+    struct ggml_tensor * b = ggml_new_tensor_4d(ctx, GGML_TYPE_F32, IW, IH, IC, N);
+
+    for (int i = 0; i < ggml_nelements(a); i++) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 5) - 2.0f);
+    }
+    for (int i = 0; i < ggml_nelements(b); i++) {
+        ggml_set_f32_1d(b, i, (float) ((i*13) % 11) - 5.0f);
+    }
+
+    struct ggml_tensor * res = ggml_conv_2d(ctx, a, b, s0, s1, p0, p1, d0, d1);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+    ggml_graph_compute_with_ctx(ctx, gf, 1);
+
+    const int OW = (IW + 2*p0 - d0*(KW - 1) - 1)/s0 + 1;
+    const int OH = (IH + 2*p1 - d1*(KH - 1) - 1)/s1 + 1;
+
+    bool passed = res->ne[0] == OW && res->ne[1] == OH && res->ne[2] == OC && res->ne[3] == N;
+
+    for (int n = 0; passed && n < N; n++) {
+        for (int oc = 0; oc < OC; oc++) {
+            for (int oh = 0; oh < OH; oh++) {
+                for (int ow = 0; ow < OW; ow++) {
+                    float ref = 0.0f;
+                    for (int ic = 0; ic < IC; ic++) {
+                        for (int kh = 0; kh < KH; kh++) {
+                            for (int kw = 0; kw < KW; kw++) {
+                                const int iw = ow*s0 + kw*d0 - p0;
+                                const int ih = oh*s1 + kh*d1 - p1;
+                                if (iw < 0 || iw >= IW || ih < 0 || ih >= IH) {
+                                    continue;
+                                }
+                                ref += ggml_get_f32_nd(a, kw, kh, ic, oc)*ggml_get_f32_nd(b, iw, ih, ic, n);
+                            }
+                        }
+                    }
+                    if (ggml_get_f32_nd(res, ow, oh, oc, n) != ref) {
+                        passed = false;
+                    }
+                }
+            }
+        }
+    }
+
+    ggml_free(ctx);
+
+    return passed;
+}
+
 int main(void)
 {
     ggml_time_init();
@@ -398,10 +464,14 @@ int main(void)
 
     printf("ggml_conv2d (%d): %s\n", (int) ggml_nelements(conv2d_res), passed && (ggml_nelements(conv2d_res) == n_conv2d_test) ? "\033[32mPASSED\033[0m" : "\033[31mFAILED\033[0m");
 
+    const bool passed_batched = test_conv2d_batched();
+
+    printf("ggml_conv2d (N > 1): %s\n", passed_batched ? "\033[32mPASSED\033[0m" : "\033[31mFAILED\033[0m");
+
     ggml_free(model.ctx);
 
     ggml_backend_buffer_free(model.buffer);
     ggml_backend_buffer_free(buf_compute);
     ggml_backend_free(model.backend);
-    return 0;
+    return passed_batched ? 0 : 1;
 }
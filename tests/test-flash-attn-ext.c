@@ -0,0 +1,149 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// checks ggml_flash_attn_ext against a double precision softmax(scale*q*k^T + mask + alibi)*v, with
+// q, k and v as strided views of a KV cache laid out as in examples/gpt-2 ([n_embd_head, n_head, n_ctx]),
+// F32 and F16 caches, grouped-query heads, more tokens than one tile, fully masked rows and ALiBi
+
+struct test_case {
+    enum ggml_type type_kv;
+    int D;
+    int DV;
+    int n_tokens;
+    int n_kv;
+    int n_head;
+    int n_head_kv;
+    float max_bias;
+    int n_threads;
+};
+
+static int run(struct ggml_context * ctx, const struct test_case * tc) {
+    const int n_ctx = tc->n_kv + 3; // the views do not cover the whole cache
+
+    // q as a permuted view, like Qcur in the examples
+    struct ggml_tensor * qcur = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc->D, tc->n_head, tc->n_tokens);
+    struct ggml_tensor * kc   = ggml_new_tensor_3d(ctx, tc->type_kv, tc->D,  tc->n_head_kv, n_ctx);
+    struct ggml_tensor * vc   = ggml_new_tensor_3d(ctx, tc->type_kv, tc->DV, tc->n_head_kv, n_ctx);
+    struct ggml_tensor * mask = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, tc->n_kv, tc->n_tokens + 2);
+
+    for (int i = 0; i < ggml_nelements(qcur); ++i) {
+        ggml_set_f32_1d(qcur, i, (float) ((i*7) % 13 - 6)/13.0f);
+    }
+    for (int i = 0; i < ggml_nelements(kc); ++i) {
+        ggml_set_f32_1d(kc, i, (float) ((i*5) % 11 - 5)/11.0f);
+    }
+    for (int i = 0; i < ggml_nelements(vc); ++i) {
+        ggml_set_f32_1d(vc, i, (float) ((i*3) % 17 - 8)/17.0f);
+    }
+
+    // causal, the tokens are the last n_tokens of the kv, token 1 sees nothing
+    const int n_past = tc->n_kv - tc->n_tokens;
+    for (int i1 = 0; i1 < mask->ne[1]; ++i1) {
+        for (int i0 = 0; i0 < tc->n_kv; ++i0) {
+            const int masked = i0 > n_past + i1 || (i1 == 1 && tc->n_tokens > 1);
+            ggml_set_f32_nd(mask, i0, i1, 0, 0, masked ? -INFINITY : (float) (i0 % 3)/10.0f);
+        }
+    }
+
+    struct ggml_tensor * q = ggml_permute(ctx, qcur, 0, 2, 1, 3);
+    struct ggml_tensor * k = ggml_view_3d(ctx, kc, tc->D,  tc->n_kv, tc->n_head_kv, kc->nb[2], kc->nb[1], kc->nb[2]);
+    struct ggml_tensor * v = ggml_view_3d(ctx, vc, tc->DV, tc->n_kv, tc->n_head_kv, vc->nb[2], vc->nb[1], vc->nb[2]);
+
+    const float scale = 1.0f/sqrtf((float) tc->D);
+
+    struct ggml_tensor * res = ggml_flash_attn_ext(ctx, q, k, v, mask, scale, tc->max_bias);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, tc->n_threads);
+    cplan.work_data = malloc(cplan.work_size + 1);
+    ggml_graph_compute(gf, &cplan);
+    free(cplan.work_data);
+
+    const int n_heads_log2_floor = 1 << (int) floor(log2(tc->n_head));
+
+    const double m0 = pow(2.0, -(tc->max_bias) / n_heads_log2_floor);
+    const double m1 = pow(2.0, -(tc->max_bias / 2.0) / n_heads_log2_floor);
+
+    double * s = malloc(tc->n_kv*sizeof(double));
+
+    double max_err = 0.0;
+
+    for (int h = 0; h < tc->n_head; ++h) {
+        const int hk = h/(tc->n_head/tc->n_head_kv);
+
+        const double slope = tc->max_bias > 0.0f ? (h < n_heads_log2_floor ? pow(m0, h + 1) : pow(m1, 2*(h - n_heads_log2_floor) + 1)) : 0.0;
+
+        for (int t = 0; t < tc->n_tokens; ++t) {
+            double max = -INFINITY;
+            for (int j = 0; j < tc->n_kv; ++j) {
+                const double mv = ggml_get_f32_nd(mask, j, t, 0, 0);
+                double dot = 0.0;
+                for (int d = 0; d < tc->D; ++d) {
+                    dot += (double) ggml_get_f32_nd(q, d, t, h, 0)*ggml_get_f32_nd(k, d, j, hk, 0);
+                }
+                s[j] = dot*scale + mv + slope*j;
+                max = fmax(max, s[j]);
+            }
+
+            double sum = 0.0;
+            for (int j = 0; j < tc->n_kv; ++j) {
+                s[j] = max == -INFINITY ? 0.0 : exp(s[j] - max);
+                sum += s[j];
+            }
+
+            for (int d = 0; d < tc->DV; ++d) {
+                double ref = 0.0;
+                for (int j = 0; j < tc->n_kv; ++j) {
+                    ref += s[j]*ggml_get_f32_nd(v, d, j, hk, 0);
+                }
+                ref = sum > 0.0 ? ref/sum : 0.0;
+
+                max_err = fmax(max_err, fabs(ref - ggml_get_f32_nd(res, d, h, t, 0)));
+            }
+        }
+    }
+
+    free(s);
+
+    if (max_err > 1e-3) {
+        fprintf(stderr, "%s: %s D = %d, DV = %d, n_tokens = %d, n_kv = %d, n_head = %d, n_head_kv = %d, max_bias = %.1f, n_threads = %d: error %e\n",
+                __func__, ggml_type_name(tc->type_kv), tc->D, tc->DV, tc->n_tokens, tc->n_kv, tc->n_head, tc->n_head_kv,
+                tc->max_bias, tc->n_threads, max_err);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 64*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    const struct test_case cases[] = {
+        { GGML_TYPE_F32, 64, 64,  1,  37, 4, 4, 0.0f, 1 },
+        { GGML_TYPE_F16, 64, 64,  1,  37, 4, 4, 0.0f, 2 },
+        { GGML_TYPE_F32, 32, 48, 19,  40, 6, 2, 0.0f, 3 },
+        { GGML_TYPE_F16, 80, 80, 13, 100, 8, 1, 0.0f, 4 },
+        { GGML_TYPE_F32, 16, 16,  9,   9, 5, 5, 8.0f, 2 },
+        { GGML_TYPE_F16, 64, 32, 17,  50, 4, 2, 8.0f, 3 },
+    };
+
+    int failed = 0;
+    for (int i = 0; i < (int) (sizeof(cases)/sizeof(cases[0])); ++i) {
+        failed |= run(ctx, &cases[i]);
+    }
+
+    ggml_free(ctx);
+
+    return failed;
+}
@@ -1343,6 +1343,39 @@ int main(int argc, const char ** argv) {
             check_gradient("get_rows", ctx0, x, f, ndims, nargs, 1e-3f, 1e-3f, INFINITY);
         }
 
+        // pad_circular
+        {
+            srand(seed);
+            const int nargs = 1;
+
+            int64_t ne2[4];
+            get_random_dims(ne2, 4);
+
+            for (int ndims = 1; ndims <= 4; ++ndims) {
+                // asymmetric padding on every axis, padding wider than the tensor wraps around more than once
+                const int lp0 = irand(2*ne2[0]);
+                const int rp0 = irand(2*ne2[0]);
+                const int lp1 = ndims >= 2 ? irand(2*ne2[1]) : 0;
+                const int rp1 = ndims >= 2 ? irand(2*ne2[1]) : 0;
+                const int lp2 = ndims >= 3 ? irand(2*ne2[2]) : 0;
+                const int rp2 = ndims >= 3 ? irand(2*ne2[2]) : 0;
+                const int lp3 = ndims >= 4 ? irand(2*ne2[3]) : 0;
+                const int rp3 = ndims >= 4 ? irand(2*ne2[3]) : 0;
+
+                x[0] = get_random_tensor_f32(ctx0, ndims, ne2, -1.0f, 1.0f);
+                ggml_set_param(ctx0, x[0]);
+
+                struct ggml_tensor * padded = ggml_pad_circular_ext(ctx0, x[0], lp0, rp0, lp1, rp1, lp2, rp2, lp3, rp3);
+
+                // weight the padded elements so that every halo contributes a distinct gradient
+                struct ggml_tensor * w = get_random_tensor_f32(ctx0, 4, padded->ne, -1.0f, 1.0f);
+
+                struct ggml_tensor * f = ggml_sum(ctx0, ggml_mul(ctx0, padded, w));
+
+                check_gradient("pad_circular", ctx0, x, f, ndims, nargs, 1e-3f, 1e-3f, INFINITY);
+            }
+        }
+
         // diag_mask_inf
         {
             srand(seed);
@@ -1406,6 +1439,38 @@ int main(int argc, const char ** argv) {
             }
         }
 
+        // soft_max_ext
+        {
+            srand(seed);
+            const int nargs = 1;
+
+            int64_t ne2[4];
+            get_random_dims(ne2, 4);
+
+            for (int ndims = 2; ndims <= 3; ++ndims) {
+                x[0] = get_random_tensor_f32(ctx0, ndims, ne2, -1.0f, 1.0f);
+                ggml_set_param(ctx0, x[0]);
+
+                // constant mask, one of the entries of each row masked
+                struct ggml_tensor * mask = get_random_tensor_f32(ctx0, 2, ne2, -0.5f, 0.5f);
+                for (int i1 = 0; i1 < ne2[1]; ++i1) {
+                    ((float *) mask->data)[i1*ne2[0] + (i1 % ne2[0])] = -INFINITY;
+                }
+
+                float eps = 1e-6f;
+                // see softmax
+                struct ggml_tensor * f = ggml_sum(ctx0,
+                                            ggml_log(ctx0,
+                                                ggml_add1(ctx0,
+                                                    ggml_scale(ctx0,
+                                                        ggml_soft_max_ext(ctx0, x[0], mask, 0.7f, ndims == 3 ? 8.0f : 0.0f),
+                                                        ggml_new_f32(ctx0, 1.0f - eps)),
+                                                    ggml_new_f32(ctx0, eps))));
+
+                check_gradient("soft_max_ext", ctx0, x, f, ndims, nargs, 1e-3f, 2e-1f, INFINITY);
+            }
+        }
+
         // cross_entropy_loss
         {
             srand(seed);
@@ -0,0 +1,118 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// measures the startup cost: the first ggml_init of the process, the next ones and the first use of a
+// lookup table that is built on demand (the F16 GELU table of ggml_flash_ff), and checks the result of
+// ggml_flash_ff, with the threads racing to build that table, against a double precision reference
+// GGML_N_THREADS=1 times the table build alone
+
+static double gelu(double x) {
+    return 0.5*x*(1.0 + tanh(0.79788456080286535588*x*(1.0 + 0.044715*x*x)));
+}
+
+int main(void) {
+    ggml_time_init();
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    const int64_t t0 = ggml_time_us();
+    struct ggml_context * ctx = ggml_init(params);
+    const int64_t t1 = ggml_time_us();
+
+    int64_t t_next = 0;
+    for (int i = 0; i < 10; ++i) {
+        const int64_t t = ggml_time_us();
+        struct ggml_context * tmp = ggml_init(params);
+        t_next += ggml_time_us() - t;
+        ggml_free(tmp);
+    }
+
+    const int D = 64; // embedding
+    const int M = 96; // hidden
+    const int N = 13; // rows
+
+    struct ggml_tensor * a  = ggml_new_tensor_2d(ctx, GGML_TYPE_F16, D, N);
+    struct ggml_tensor * b0 = ggml_new_tensor_2d(ctx, GGML_TYPE_F16, D, M);
+    struct ggml_tensor * b1 = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, M);
+    struct ggml_tensor * c0 = ggml_new_tensor_2d(ctx, GGML_TYPE_F16, M, D);
+    struct ggml_tensor * c1 = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, D);
+
+    for (int i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 13 - 6)/13.0f);
+    }
+    for (int i = 0; i < ggml_nelements(b0); ++i) {
+        ggml_set_f32_1d(b0, i, (float) ((i*5) % 11 - 5)/11.0f);
+    }
+    for (int i = 0; i < ggml_nelements(b1); ++i) {
+        ggml_set_f32_1d(b1, i, (float) (i % 9 - 4)/4.0f);
+    }
+    for (int i = 0; i < ggml_nelements(c0); ++i) {
+        ggml_set_f32_1d(c0, i, (float) ((i*3) % 17 - 8)/17.0f);
+    }
+    for (int i = 0; i < ggml_nelements(c1); ++i) {
+        ggml_set_f32_1d(c1, i, (float) (i % 5 - 2)/10.0f);
+    }
+
+    // several threads build the table concurrently
+    int n_threads = GGML_DEFAULT_N_THREADS;
+
+    const char * env = getenv("GGML_N_THREADS");
+    if (env) {
+        n_threads = atoi(env);
+    }
+
+    struct ggml_tensor * res = ggml_flash_ff(ctx, a, b0, b1, c0, c1);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+
+    const int64_t t2 = ggml_time_us();
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+    const int64_t t3 = ggml_time_us();
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+    const int64_t t4 = ggml_time_us();
+
+    printf("first ggml_init: %8.1f us\n", (double) (t1 - t0));
+    printf("next ggml_init:  %8.1f us\n", t_next/10.0);
+    printf("first flash_ff:  %8.1f us (builds the F16 GELU table)\n", (double) (t3 - t2));
+    printf("next flash_ff:   %8.1f us\n", (double) (t4 - t3));
+
+    double * h = malloc(M*sizeof(double));
+
+    double max_err = 0.0;
+
+    for (int r = 0; r < N; ++r) {
+        for (int j = 0; j < M; ++j) {
+            double s = ggml_get_f32_1d(b1, j);
+            for (int k = 0; k < D; ++k) {
+                s += (double) ggml_get_f32_1d(a, r*D + k)*ggml_get_f32_1d(b0, j*D + k);
+            }
+            h[j] = gelu(s);
+        }
+        for (int k = 0; k < D; ++k) {
+            double ref = ggml_get_f32_1d(c1, k);
+            for (int j = 0; j < M; ++j) {
+                ref += h[j]*ggml_get_f32_1d(c0, k*M + j);
+            }
+            max_err = fmax(max_err, fabs(ref - ggml_get_f32_1d(res, r*D + k))/fmax(1.0, fabs(ref)));
+        }
+    }
+
+    free(h);
+    ggml_free(ctx);
+
+    // the hidden activations are rounded to F16
+    if (max_err > 1e-2) {
+        fprintf(stderr, "%s: flash_ff error %e\n", __func__, max_err);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// checks mul_mat against a double precision reference for shapes that take the register-tiled
+// GEMM path (F32 and F16 src0, many src1 rows): edge tiles, ne00 not a multiple of the SIMD width
+// or longer than one pass, broadcasting over dims 2 and 3 and a permuted src1
+
+struct test_case {
+    enum ggml_type type;
+    int ne00;
+    int ne01;
+    int ne11;
+    int ne02;
+    int r2;    // broadcast factor of src0 over dim 2
+    int perm;  // src1 is a permuted view
+    int n_threads;
+};
+
+static int run(struct ggml_context * ctx, const struct test_case * tc) {
+    const int ne12 = tc->ne02*tc->r2;
+
+    struct ggml_tensor * a = ggml_new_tensor_3d(ctx, tc->type, tc->ne00, tc->ne01, tc->ne02);
+    struct ggml_tensor * b = tc->perm
+        ? ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc->ne00, ne12, tc->ne11)
+        : ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc->ne00, tc->ne11, ne12);
+
+    for (int i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 13 - 6)/13.0f);
+    }
+    for (int i = 0; i < ggml_nelements(b); ++i) {
+        ggml_set_f32_1d(b, i, (float) ((i*5) % 11 - 5)/11.0f);
+    }
+
+    struct ggml_tensor * c = ggml_mul_mat(ctx, a, tc->perm ? ggml_permute(ctx, b, 0, 2, 1, 3) : b);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, c);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, tc->n_threads);
+    cplan.work_data = malloc(cplan.work_size + 1);
+    ggml_graph_compute(gf, &cplan);
+    free(cplan.work_data);
+
+    double max_err = 0.0;
+
+    for (int i12 = 0; i12 < ne12; ++i12) {
+        for (int i11 = 0; i11 < tc->ne11; ++i11) {
+            for (int i01 = 0; i01 < tc->ne01; ++i01) {
+                double ref = 0.0;
+                for (int k = 0; k < tc->ne00; ++k) {
+                    const int64_t ia = ((int64_t) (i12/tc->r2)*tc->ne01 + i01)*tc->ne00 + k;
+                    const int64_t ib = tc->perm
+                        ? ((int64_t) i11*ne12 + i12)*tc->ne00 + k
+                        : ((int64_t) i12*tc->ne11 + i11)*tc->ne00 + k;
+                    ref += (double) ggml_get_f32_1d(a, ia)*ggml_get_f32_1d(b, ib);
+                }
+                const float res = ((const float *) c->data)[((int64_t) i12*tc->ne11 + i11)*tc->ne01 + i01];
+                max_err = fmax(max_err, fabs(ref - res));
+            }
+        }
+    }
+
+    if (max_err > 1e-3) {
+        fprintf(stderr, "%s: %s ne00 = %d, ne01 = %d, ne11 = %d, ne02 = %d, r2 = %d, perm = %d, n_threads = %d: error %e\n",
+                __func__, ggml_type_name(tc->type), tc->ne00, tc->ne01, tc->ne11, tc->ne02, tc->r2, tc->perm, tc->n_threads, max_err);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 128*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    const struct test_case cases[] = {
+        { GGML_TYPE_F32,   37,  23, 19, 1, 1, 0, 3 },
+        { GGML_TYPE_F16,   37,  23, 19, 1, 1, 0, 3 },
+        { GGML_TYPE_F32,  130, 300, 17, 1, 1, 0, 5 },
+        { GGML_TYPE_F16, 2500,  45, 33, 2, 3, 0, 4 },
+        { GGML_TYPE_F32, 2500,  45, 33, 2, 3, 1, 2 },
+        { GGML_TYPE_F16,   64,   7, 40, 3, 2, 1, 4 },
+    };
+
+    int failed = 0;
+    for (int i = 0; i < (int) (sizeof(cases)/sizeof(cases[0])); ++i) {
+        failed |= run(ctx, &cases[i]);
+    }
+
+    ggml_free(ctx);
+
+    return failed;
+}
@@ -0,0 +1,126 @@
+#include "ggml/ggml.h"
+#include "ggml/ggml-alloc.h"
+#include "ggml/ggml-backend.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// checks mul_mat with weights in the repacked (interleaved rows) layout of ggml_backend_cpu_repack_buffer_type
+// against the same weights in a CPU buffer, for matrix-vector and matrix-matrix products, a 3d weight
+// and several thread counts, and that the weights read back unchanged
+
+struct test_case {
+    enum ggml_type type;
+    int ne00;
+    int ne01;
+    int ne02;
+    int ne11;
+    int n_threads;
+};
+
+static int run(const struct test_case * tc) {
+    struct ggml_init_params params_w = {
+        /*.mem_size   =*/ 2*ggml_tensor_overhead(),
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ true,
+    };
+
+    struct ggml_context * ctx_w = ggml_init(params_w);
+
+    struct ggml_tensor * a_plain  = ggml_new_tensor_3d(ctx_w, tc->type, tc->ne00, tc->ne01, tc->ne02);
+    struct ggml_tensor * a_repack = ggml_new_tensor_3d(ctx_w, tc->type, tc->ne00, tc->ne01, tc->ne02);
+
+    ggml_backend_buffer_t buf = ggml_backend_alloc_ctx_tensors_from_buft(ctx_w, ggml_backend_cpu_repack_buffer_type());
+
+    // quantized weights, written to the first tensor as is
+    const size_t nbytes = ggml_nbytes(a_repack);
+
+    float * f = malloc(ggml_nelements(a_repack)*sizeof(float));
+    void  * q = malloc(nbytes);
+    void  * r = malloc(nbytes);
+
+    for (int i = 0; i < ggml_nelements(a_repack); ++i) {
+        f[i] = (float) ((i*7) % 13 - 6)/13.0f + (float) (i % 5)/50.0f;
+    }
+    ggml_internal_get_type_traits(tc->type).from_float(f, q, ggml_nelements(a_repack));
+
+    memcpy(a_plain->data, q, nbytes);
+    ggml_backend_tensor_set(a_repack, q, 0, nbytes);
+
+    int failed = 0;
+
+    if (!(a_repack->flags & GGML_TENSOR_FLAG_REPACKED) || memcmp(a_repack->data, q, nbytes) == 0) {
+        fprintf(stderr, "%s: %s: tensor not repacked\n", __func__, ggml_type_name(tc->type));
+        failed = 1;
+    }
+
+    ggml_backend_tensor_get(a_repack, r, 0, nbytes);
+    if (memcmp(r, q, nbytes) != 0) {
+        fprintf(stderr, "%s: %s: tensor read back differs\n", __func__, ggml_type_name(tc->type));
+        failed = 1;
+    }
+
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * b = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, tc->ne00, tc->ne11, tc->ne02);
+    for (int i = 0; i < ggml_nelements(b); ++i) {
+        ggml_set_f32_1d(b, i, (float) ((i*5) % 11 - 5)/11.0f);
+    }
+
+    struct ggml_tensor * c_plain  = ggml_mul_mat(ctx, a_plain,  b);
+    struct ggml_tensor * c_repack = ggml_mul_mat(ctx, a_repack, b);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, c_plain);
+    ggml_build_forward_expand(gf, c_repack);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, tc->n_threads);
+    cplan.work_data = malloc(cplan.work_size + 1);
+    ggml_graph_compute(gf, &cplan);
+    free(cplan.work_data);
+
+    for (int i = 0; i < ggml_nelements(c_plain); ++i) {
+        const float x = ((const float *) c_plain->data)[i];
+        const float y = ((const float *) c_repack->data)[i];
+        if (fabsf(x - y) > 1e-4f*fmaxf(1.0f, fabsf(x))) {
+            fprintf(stderr, "%s: %s ne00 = %d, ne01 = %d, ne02 = %d, ne11 = %d, n_threads = %d: mismatch at %d: %f != %f\n",
+                    __func__, ggml_type_name(tc->type), tc->ne00, tc->ne01, tc->ne02, tc->ne11, tc->n_threads, i, y, x);
+            failed = 1;
+            break;
+        }
+    }
+
+    ggml_free(ctx);
+    ggml_backend_buffer_free(buf);
+    ggml_free(ctx_w);
+    free(f);
+    free(q);
+    free(r);
+
+    return failed;
+}
+
+int main(void) {
+    const struct test_case cases[] = {
+        { GGML_TYPE_Q4_0,  64,   4, 1,  1, 1 },
+        { GGML_TYPE_Q4_0, 256, 100, 1,  1, 3 },
+        { GGML_TYPE_Q4_0, 512, 132, 2,  7, 4 },
+        { GGML_TYPE_Q8_0,  96,  36, 1,  1, 2 },
+        { GGML_TYPE_Q8_0, 256,  68, 3, 19, 3 },
+    };
+
+    int failed = 0;
+    for (int i = 0; i < (int) (sizeof(cases)/sizeof(cases[0])); ++i) {
+        failed |= run(&cases[i]);
+    }
+
+    return failed;
+}
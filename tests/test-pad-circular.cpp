@@ -1,13 +1,16 @@
 ﻿#include "ggml.h"
 #include "ggml/ggml-alloc.h"
 #include "ggml/ggml-backend.h"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <map>
 #include <string>
+#include <thread>
 #include <vector>
 //This is a very crude test, and not testing anything other than fp32, and not testing cuda or other optimizations
 //I wrote it for my sanity of making sure this was working correctly
@@ -19,7 +22,705 @@ struct ggml_context* make_ctx(void) {
 
     return ggml_init(params);
 }
-int main(void) {
+// compares ggml_pad_circular_ext against a naive per-element reference for a 4D tensor
+static bool test_pad_circular_ext(ggml_type type, const int64_t ne[4], const int pads[8], int n_threads) {
+    struct ggml_init_params params;
+    params.mem_size = 16 * 1024 * 1024;
+    params.no_alloc=false;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * a = ggml_new_tensor(ctx, type, 4, ne);
+    const int64_t n = ggml_nelements(a);
+    for (int64_t i = 0; i < n; ++i) {
+        ggml_set_f32_1d(a, i, (float) (i % 1000));
+    }
+
+    struct ggml_tensor * b = ggml_pad_circular_ext(ctx, a,
+            pads[0], pads[1], pads[2], pads[3], pads[4], pads[5], pads[6], pads[7]);
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, b);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    bool passed = true;
+    for (int64_t i3 = 0; i3 < b->ne[3] && passed; ++i3) {
+        for (int64_t i2 = 0; i2 < b->ne[2] && passed; ++i2) {
+            for (int64_t i1 = 0; i1 < b->ne[1] && passed; ++i1) {
+                for (int64_t i0 = 0; i0 < b->ne[0]; ++i0) {
+                    const int64_t j0 = ((i0 - pads[0]) % ne[0] + ne[0]) % ne[0];
+                    const int64_t j1 = ((i1 - pads[2]) % ne[1] + ne[1]) % ne[1];
+                    const int64_t j2 = ((i2 - pads[4]) % ne[2] + ne[2]) % ne[2];
+                    const int64_t j3 = ((i3 - pads[6]) % ne[3] + ne[3]) % ne[3];
+                    const float expected = ggml_get_f32_1d(a, ((j3*ne[2] + j2)*ne[1] + j1)*ne[0] + j0);
+                    const float val = ggml_get_f32_1d(b, ((i3*b->ne[2] + i2)*b->ne[1] + i1)*b->ne[0] + i0);
+                    if (val != expected) {
+                        printf("%s: mismatch at [%d, %d, %d, %d]: %f != %f\n", __func__,
+                                (int) i0, (int) i1, (int) i2, (int) i3, val, expected);
+                        passed = false;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// folds a padded tensor back with ggml_pad_circular_back and compares it against a naive accumulation
+// of every padded element into the element it was wrapped from
+static bool test_pad_circular_back(const int64_t ne[4], const int pads[8], int n_threads) {
+    struct ggml_context * ctx = make_ctx();
+
+    const int64_t ne_a[4] = {
+        ne[0] + pads[0] + pads[1],
+        ne[1] + pads[2] + pads[3],
+        ne[2] + pads[4] + pads[5],
+        ne[3] + pads[6] + pads[7],
+    };
+
+    struct ggml_tensor * a = ggml_new_tensor(ctx, GGML_TYPE_F32, 4, ne_a);
+    struct ggml_tensor * b = ggml_new_tensor(ctx, GGML_TYPE_F32, 4, ne);
+    for (int64_t i = 0; i < ggml_nelements(a); ++i) {
+        // small integers, the sums are exact in any order
+        ggml_set_f32_1d(a, i, (float) ((i*29) % 17) - 8.0f);
+    }
+
+    struct ggml_tensor * res = ggml_pad_circular_back(ctx, a, b, pads[0], pads[2], pads[4], pads[6]);
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    std::vector<float> ref(ggml_nelements(b), 0.0f);
+    for (int64_t i3 = 0; i3 < ne_a[3]; ++i3) {
+        for (int64_t i2 = 0; i2 < ne_a[2]; ++i2) {
+            for (int64_t i1 = 0; i1 < ne_a[1]; ++i1) {
+                for (int64_t i0 = 0; i0 < ne_a[0]; ++i0) {
+                    const int64_t j0 = ((i0 - pads[0]) % ne[0] + ne[0]) % ne[0];
+                    const int64_t j1 = ((i1 - pads[2]) % ne[1] + ne[1]) % ne[1];
+                    const int64_t j2 = ((i2 - pads[4]) % ne[2] + ne[2]) % ne[2];
+                    const int64_t j3 = ((i3 - pads[6]) % ne[3] + ne[3]) % ne[3];
+                    ref[((j3*ne[2] + j2)*ne[1] + j1)*ne[0] + j0] +=
+                        ggml_get_f32_1d(a, ((i3*ne_a[2] + i2)*ne_a[1] + i1)*ne_a[0] + i0);
+                }
+            }
+        }
+    }
+
+    bool passed = ggml_are_same_shape(res, b);
+    for (int64_t i = 0; passed && i < ggml_nelements(b); ++i) {
+        if (ggml_get_f32_1d(res, i) != ref[i]) {
+            printf("%s: mismatch at %d: %f != %f\n", __func__, (int) i, ggml_get_f32_1d(res, i), ref[i]);
+            passed = false;
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// pads a quantized tensor and checks that the dequantized result equals the padded dequantized source
+static bool test_pad_circular_quantized(ggml_type type, int n_threads) {
+    struct ggml_init_params params;
+    params.mem_size = 16 * 1024 * 1024;
+    params.no_alloc=false;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    const int64_t bs = ggml_blck_size(type);
+    const int64_t ne[4] = { 2*bs, 3, 2, 2 };
+    const int pads[8] = { (int) bs, 0, 2, 1, 1, 3, 0, 1 };
+
+    struct ggml_tensor * a = ggml_new_tensor(ctx, type, 4, ne);
+
+    std::vector<float> data(ggml_nelements(a));
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = sinf((float) i);
+    }
+    std::vector<int64_t> hist(1 << 4, 0);
+    ggml_quantize_chunk(type, data.data(), a->data, 0, data.size(), hist.data());
+
+    struct ggml_tensor * b = ggml_pad_circular_ext(ctx, a,
+            pads[0], pads[1], pads[2], pads[3], pads[4], pads[5], pads[6], pads[7]);
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, b);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    ggml_type_traits_t traits = ggml_internal_get_type_traits(type);
+
+    std::vector<float> a_row(ne[0]);
+    std::vector<float> b_row(b->ne[0]);
+
+    bool passed = true;
+    for (int64_t i3 = 0; i3 < b->ne[3]; ++i3) {
+        for (int64_t i2 = 0; i2 < b->ne[2]; ++i2) {
+            for (int64_t i1 = 0; i1 < b->ne[1]; ++i1) {
+                const int64_t j1 = ((i1 - pads[2]) % ne[1] + ne[1]) % ne[1];
+                const int64_t j2 = ((i2 - pads[4]) % ne[2] + ne[2]) % ne[2];
+                const int64_t j3 = ((i3 - pads[6]) % ne[3] + ne[3]) % ne[3];
+
+                traits.to_float((char *) a->data + j1*a->nb[1] + j2*a->nb[2] + j3*a->nb[3], a_row.data(), ne[0]);
+                traits.to_float((char *) b->data + i1*b->nb[1] + i2*b->nb[2] + i3*b->nb[3], b_row.data(), b->ne[0]);
+
+                for (int64_t i0 = 0; i0 < b->ne[0]; ++i0) {
+                    const int64_t j0 = ((i0 - pads[0]) % ne[0] + ne[0]) % ne[0];
+                    if (b_row[i0] != a_row[j0]) {
+                        passed = false;
+                    }
+                }
+            }
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// compares the fused circular conv against ggml_pad_circular_ext followed by an unpadded conv
+static bool test_conv_circular(bool is_2D, int s, int p, int d, int n_threads) {
+    struct ggml_init_params params;
+    params.mem_size = 16 * 1024 * 1024;
+    params.no_alloc=false;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    const int64_t IW = 9, IH = 7, IC = 3, OC = 4, N = 2, K = 3;
+
+    struct ggml_tensor * a = is_2D ? ggml_new_tensor_4d(ctx, GGML_TYPE_F16, K, K, IC, OC)
+                                   : ggml_new_tensor_3d(ctx, GGML_TYPE_F16, K, IC, OC);
+    struct ggml_tensor * b = is_2D ? ggml_new_tensor_4d(ctx, GGML_TYPE_F32, IW, IH, IC, N)
+                                   : ggml_new_tensor_3d(ctx, GGML_TYPE_F32, IW, IC, N);
+
+    for (int64_t i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 5) - 2.0f);
+    }
+    for (int64_t i = 0; i < ggml_nelements(b); ++i) {
+        ggml_set_f32_1d(b, i, (float) ((i*13) % 11) - 5.0f);
+    }
+
+    struct ggml_tensor * fused;
+    struct ggml_tensor * ref;
+    if (is_2D) {
+        fused = ggml_conv_2d_ext(ctx, a, b, s, s, p, p, d, d, GGML_PAD_MODE_CIRCULAR);
+        ref   = ggml_conv_2d(ctx, a, ggml_pad_circular_ext(ctx, b, p, p, p, p, 0, 0, 0, 0), s, s, 0, 0, d, d);
+    } else {
+        fused = ggml_conv_1d_ext(ctx, a, b, s, p, d, GGML_PAD_MODE_CIRCULAR);
+        ref   = ggml_conv_1d(ctx, a, ggml_pad_circular_ext(ctx, b, p, p, 0, 0, 0, 0, 0, 0), s, 0, d);
+    }
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, fused);
+    ggml_build_forward_expand(gf, ref);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    bool passed = ggml_are_same_shape(fused, ref);
+    for (int64_t i = 0; passed && i < ggml_nelements(ref); ++i) {
+        // inputs are small integers, both paths are exact
+        if (ggml_get_f32_1d(fused, i) != ggml_get_f32_1d(ref, i)) {
+            printf("%s: mismatch at %d: %f != %f\n", __func__, (int) i, ggml_get_f32_1d(fused, i), ggml_get_f32_1d(ref, i));
+            passed = false;
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// compares ggml_conv_2d_circular against ggml_pad_circular_ext followed by an unpadded ggml_conv_2d
+// kernels of 7x7 and larger go through the FFT path
+static bool test_conv_2d_circular(int K, int IW, int IH, int p0, int p1, ggml_type kernel_type, int n_threads) {
+    struct ggml_init_params params;
+    params.mem_size = 64 * 1024 * 1024;
+    params.no_alloc=false;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    const int64_t IC = 3, OC = 2, N = 2;
+
+    struct ggml_tensor * a     = ggml_new_tensor_4d(ctx, kernel_type,    K,  K,  IC, OC);
+    struct ggml_tensor * a_f16 = ggml_new_tensor_4d(ctx, GGML_TYPE_F16,  K,  K,  IC, OC);
+    struct ggml_tensor * b     = ggml_new_tensor_4d(ctx, GGML_TYPE_F32, IW, IH, IC, N);
+
+    for (int64_t i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a,     i, (float) ((i*7) % 5) - 2.0f);
+        ggml_set_f32_1d(a_f16, i, (float) ((i*7) % 5) - 2.0f);
+    }
+    for (int64_t i = 0; i < ggml_nelements(b); ++i) {
+        ggml_set_f32_1d(b, i, (float) ((i*13) % 11) - 5.0f);
+    }
+
+    struct ggml_tensor * res = ggml_conv_2d_circular(ctx, a, b, p0, p1);
+    struct ggml_tensor * ref = ggml_conv_2d(ctx, a_f16, ggml_pad_circular_ext(ctx, b, p0, p0, p1, p1, 0, 0, 0, 0), 1, 1, 0, 0, 1, 1);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+    ggml_build_forward_expand(gf, ref);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    bool passed = ggml_are_same_shape(res, ref);
+    for (int64_t i = 0; passed && i < ggml_nelements(ref); ++i) {
+        const float v0 = ggml_get_f32_1d(res, i);
+        const float v1 = ggml_get_f32_1d(ref, i);
+        if (fabsf(v0 - v1) > 1e-2f + 1e-4f*fabsf(v1)) {
+            printf("%s: mismatch at %d: %f != %f\n", __func__, (int) i, v0, v1);
+            passed = false;
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// feeds ggml_pad_circular_view and a materialized ggml_pad_circular_ext to the same consumer op
+// and compares the results
+enum wrapped_view_consumer {
+    CONSUMER_GELU,
+    CONSUMER_ABS,
+    CONSUMER_POOL_2D,
+    CONSUMER_UPSCALE,
+    CONSUMER_CONV_2D,
+};
+
+static struct ggml_tensor * apply_consumer(struct ggml_context * ctx, wrapped_view_consumer consumer,
+        struct ggml_tensor * x, struct ggml_tensor * kernel) {
+    switch (consumer) {
+        case CONSUMER_GELU:    return ggml_gelu(ctx, x);
+        case CONSUMER_ABS:     return ggml_abs(ctx, x);
+        case CONSUMER_POOL_2D: return ggml_pool_2d(ctx, x, GGML_OP_POOL_MAX, 3, 3, 2, 2, 1, 1);
+        case CONSUMER_UPSCALE: return ggml_upscale(ctx, x, 2);
+        case CONSUMER_CONV_2D: return ggml_conv_2d(ctx, kernel, x, 1, 1, 1, 1, 1, 1);
+    }
+    return NULL;
+}
+
+static bool test_pad_circular_view(wrapped_view_consumer consumer, int n_threads) {
+    struct ggml_init_params params;
+    params.mem_size = 16 * 1024 * 1024;
+    params.no_alloc=false;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    const int64_t IW = 7, IH = 5, IC = 3;
+    const int64_t N = consumer == CONSUMER_POOL_2D ? 1 : 2; // ggml_pool_2d only handles 3d inputs
+    const int pads[8] = { 2, 3, 1, 4, 0, 0, 0, 0 };
+
+    struct ggml_tensor * a      = ggml_new_tensor_4d(ctx, GGML_TYPE_F32, IW, IH, IC, N);
+    struct ggml_tensor * kernel = ggml_new_tensor_4d(ctx, GGML_TYPE_F16, 3, 3, IC, 2);
+    for (int64_t i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*13) % 11) - 5.0f);
+    }
+    for (int64_t i = 0; i < ggml_nelements(kernel); ++i) {
+        ggml_set_f32_1d(kernel, i, (float) ((i*7) % 5) - 2.0f);
+    }
+
+    struct ggml_tensor * view = ggml_pad_circular_view(ctx, a,
+            pads[0], pads[1], pads[2], pads[3], pads[4], pads[5], pads[6], pads[7]);
+    struct ggml_tensor * padded = ggml_pad_circular_ext(ctx, a,
+            pads[0], pads[1], pads[2], pads[3], pads[4], pads[5], pads[6], pads[7]);
+
+    bool passed = ggml_is_wrapped_view(view) && !ggml_is_wrapped_view(padded) && ggml_are_same_shape(view, padded);
+
+    // the view spans exactly the data of a
+    passed = passed && ggml_nbytes(view) == ggml_nbytes(a);
+
+    struct ggml_tensor * res = apply_consumer(ctx, consumer, view,   kernel);
+    struct ggml_tensor * ref = apply_consumer(ctx, consumer, padded, kernel);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+    ggml_build_forward_expand(gf, ref);
+    ggml_graph_compute_with_ctx(ctx, gf, n_threads);
+
+    passed = passed && ggml_are_same_shape(res, ref);
+    for (int64_t i = 0; passed && i < ggml_nelements(ref); ++i) {
+        if (ggml_get_f32_1d(res, i) != ggml_get_f32_1d(ref, i)) {
+            printf("%s: mismatch at %d: %f != %f\n", __func__, (int) i, ggml_get_f32_1d(res, i), ggml_get_f32_1d(ref, i));
+            passed = false;
+        }
+    }
+
+    // the element accessors resolve the wrapped indices
+    for (int64_t i = 0; passed && i < ggml_nelements(padded); ++i) {
+        if (ggml_get_f32_1d(view, i) != ggml_get_f32_1d(padded, i)) {
+            printf("%s: view mismatch at %d: %f != %f\n", __func__, (int) i, ggml_get_f32_1d(view, i), ggml_get_f32_1d(padded, i));
+            passed = false;
+        }
+    }
+
+    ggml_free(ctx);
+    return passed;
+}
+
+// peak memory of pad + pool_2d measured by the graph allocator: the padded tensor is allocated for
+// ggml_pad_circular_ext but not for ggml_pad_circular_view, whose data is the input itself
+struct pad_pool_sizes {
+    size_t input;
+    size_t padded;
+    size_t pooled;
+    size_t peak;
+};
+
+static pad_pool_sizes measure_pad_pool(bool lazy) {
+    struct ggml_init_params params;
+    params.mem_size = ggml_tensor_overhead()*16 + ggml_graph_overhead();
+    params.no_alloc=true;
+    params.mem_buffer=NULL;
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * a = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, 64, 64, 8);
+    struct ggml_tensor * padded = lazy
+        ? ggml_pad_circular_view(ctx, a, 8, 8, 8, 8, 0, 0, 0, 0)
+        : ggml_pad_circular_ext (ctx, a, 8, 8, 8, 8, 0, 0, 0, 0);
+    struct ggml_tensor * res = ggml_pool_2d(ctx, padded, GGML_OP_POOL_AVG, 2, 2, 2, 2, 0, 0);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, res);
+
+    ggml_allocr_t allocr = ggml_allocr_new_measure(32);
+
+    pad_pool_sizes sizes;
+    sizes.input  = ggml_nbytes(a);
+    sizes.padded = ggml_nbytes(padded);
+    sizes.pooled = ggml_nbytes(res);
+    sizes.peak   = ggml_allocr_alloc_graph(allocr, gf);
+
+    ggml_allocr_free(allocr);
+    ggml_free(ctx);
+    return sizes;
+}
+
+static bool test_pad_circular_view_alloc() {
+    const pad_pool_sizes ext  = measure_pad_pool(false);
+    const pad_pool_sizes view = measure_pad_pool(true);
+
+    // the input and the padded tensor are alive together with ggml_pad_circular_ext, the pooled result
+    // then reuses the input; with the view only the input and the pooled result are ever allocated
+    const bool passed =
+        view.padded == view.input &&
+        ext.peak  >= ext.input + ext.padded &&
+        view.peak <= view.input + view.pooled &&
+        view.peak <  ext.peak;
+    if (!passed) {
+        printf("%s: peak %zu bytes with the view, %zu bytes with the padded tensor (%zu bytes)\n",
+                __func__, view.peak, ext.peak, ext.padded);
+    }
+    return passed;
+}
+
+//
+// benchmark mode: test-pad-circular perf [options]
+//
+// sweeps shapes, types, padding widths and thread counts and reports the throughput of
+// ggml_pad_circular_ext in GB/s (1e9 bytes read + written per second) next to the bandwidth of
+// a memcpy of the padded size split over the same number of threads. with --csv the results are printed as CSV so that runs
+// of different versions can be diffed
+//
+
+struct perf_params {
+    std::vector<ggml_type> types;
+    int     max_threads = (int) std::max(1u, std::thread::hardware_concurrency());
+    int64_t max_mb      = 512;
+    int     iterations  = 5;
+    bool    csv         = false;
+};
+
+static void perf_usage(const char * prog) {
+    printf("usage: %s perf [options]\n", prog);
+    printf("\n");
+    printf("options: (default)\n");
+    printf("  -h, --help            show this help message and exit\n");
+    printf("  --type TYPE           benchmark TYPE, can be repeated (f32 f16 q8_0 q4_0)\n");
+    printf("  -t N, --threads N     sweep 1, 2, 4, ... up to N threads (%u)\n", std::max(1u, std::thread::hardware_concurrency()));
+    printf("  --max-mb N            skip cases that need more than N MiB of tensor data (512)\n");
+    printf("  -i N, --iterations N  timed iterations per case, the fastest one is reported (5)\n");
+    printf("  --csv                 print the results as CSV\n");
+}
+
+static double perf_gbps(size_t bytes, double us) {
+    return us > 0.0 ? bytes / us * 1e6 / 1e9 : 0.0;
+}
+
+// fastest of n memcpy's of size bytes split in n_threads slices copied by as many threads,
+// small copies are batched to get above the timer resolution
+static double perf_memcpy_us(size_t size, int n, int n_threads) {
+    std::vector<char> src(size, 1);
+    std::vector<char> dst(size);
+
+    const int batch = (int) std::max<size_t>(1, (16*1024*1024)/size);
+
+    memcpy(dst.data(), src.data(), size);
+
+    const size_t slice = (size + n_threads - 1)/n_threads;
+
+    auto copy = [&](int ith) {
+        const size_t i0 = std::min(size, slice*ith);
+        const size_t i1 = std::min(size, i0 + slice);
+        for (int j = 0; j < batch; ++j) {
+            memcpy(dst.data() + i0, src.data() + i0, i1 - i0);
+        }
+    };
+
+    double best = 1e30;
+    for (int i = 0; i < n; ++i) {
+        const int64_t t0 = ggml_time_us();
+        std::vector<std::thread> workers;
+        for (int ith = 1; ith < n_threads; ++ith) {
+            workers.emplace_back(copy, ith);
+        }
+        copy(0);
+        for (std::thread & w : workers) {
+            w.join();
+        }
+        best = std::min(best, (ggml_time_us() - t0) / (double) batch);
+    }
+    return best;
+}
+
+static int perf_main(int argc, char ** argv) {
+    perf_params params;
+
+    for (int i = 2; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--type") && i + 1 < argc) {
+            const std::string name = argv[++i];
+            bool found = false;
+            for (int t = 0; t < GGML_TYPE_COUNT; ++t) {
+                const char * tname = ggml_type_name((ggml_type) t);
+                if (tname != NULL && name == tname) {
+                    params.types.push_back((ggml_type) t);
+                    found = true;
+                }
+            }
+            if (!found) {
+                fprintf(stderr, "error: unknown type: %s\n", name.c_str());
+                return 1;
+            }
+        } else if ((arg == "-t" || arg == "--threads") && i + 1 < argc) {
+            params.max_threads = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--max-mb" && i + 1 < argc) {
+            params.max_mb = std::max(1, atoi(argv[++i]));
+        } else if ((arg == "-i" || arg == "--iterations") && i + 1 < argc) {
+            params.iterations = std::max(1, atoi(argv[++i]));
+        } else if (arg == "--csv") {
+            params.csv = true;
+        } else if (arg == "-h" || arg == "--help") {
+            perf_usage(argv[0]);
+            return 0;
+        } else {
+            fprintf(stderr, "error: unknown argument: %s\n", arg.c_str());
+            perf_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (params.types.empty()) {
+        params.types = { GGML_TYPE_F32, GGML_TYPE_F16, GGML_TYPE_Q8_0, GGML_TYPE_Q4_0 };
+    }
+
+    std::vector<int> threads;
+    for (int nt = 1; nt < params.max_threads; nt *= 2) {
+        threads.push_back(nt);
+    }
+    threads.push_back(params.max_threads);
+
+    const int64_t sizes[]    = { 64, 256, 1024, 4096 };
+    const int64_t channels[] = { 1, 16, 64, 512 };
+    const int     paddings[] = { 1, 4, 32 };
+
+    if (params.csv) {
+        printf("type,ne0,ne1,ne2,pad0,pad1,n_threads,us,gbps,memcpy_gbps,rel_memcpy\n");
+    } else {
+        printf("%6s %11s %5s %5s %5s %3s %10s %8s %8s %6s\n",
+                "type", "ne0 x ne1", "ne2", "pad0", "pad1", "nt", "us", "GB/s", "memcpy", "rel");
+    }
+
+    for (ggml_type type : params.types) {
+        const int64_t bs = ggml_blck_size(type);
+
+        for (int64_t n : sizes) {
+            for (int64_t nc : channels) {
+                for (int pad : paddings) {
+                    // quantized rows are padded by whole blocks
+                    const int pad0 = (int) (((pad + bs - 1)/bs)*bs);
+                    const int pad1 = pad;
+
+                    const int64_t ne_src[4] = { n, n, nc, 1 };
+                    const int64_t ne_dst[4] = { n + 2*pad0, n + 2*pad1, nc, 1 };
+
+                    const size_t src_size = ggml_type_size(type)*(ne_src[0]/bs)*ne_src[1]*ne_src[2];
+                    const size_t dst_size = ggml_type_size(type)*(ne_dst[0]/bs)*ne_dst[1]*ne_dst[2];
+
+                    if (n % bs != 0 || (int64_t) (src_size + dst_size) > params.max_mb*1024*1024) {
+                        continue;
+                    }
+
+                    struct ggml_init_params ip;
+                    ip.mem_size   = src_size + dst_size + 4*ggml_tensor_overhead() + ggml_graph_overhead() + 1024*1024;
+                    ip.mem_buffer = NULL;
+                    ip.no_alloc   = false;
+                    struct ggml_context * ctx = ggml_init(ip);
+
+                    struct ggml_tensor * a = ggml_new_tensor(ctx, type, 4, ne_src);
+                    memset(a->data, 1, src_size);
+
+                    struct ggml_tensor * b = ggml_pad_circular_ext(ctx, a, pad0, pad0, pad1, pad1, 0, 0, 0, 0);
+
+                    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+                    ggml_build_forward_expand(gf, b);
+
+                    const int memcpy_iters = std::max(params.iterations, 3);
+
+                    for (int nt : threads) {
+                        const double memcpy_gbps = perf_gbps(2*dst_size, perf_memcpy_us(dst_size, memcpy_iters, nt));
+
+                        struct ggml_cplan cplan = ggml_graph_plan(gf, nt);
+                        GGML_ASSERT(cplan.work_size == 0);
+
+                        ggml_graph_compute(gf, &cplan); // warmup
+
+                        int64_t best = INT64_MAX;
+                        for (int it = 0; it < params.iterations; ++it) {
+                            const int64_t t0 = ggml_time_us();
+                            ggml_graph_compute(gf, &cplan);
+                            best = std::min(best, ggml_time_us() - t0);
+                        }
+
+                        const double gbps = perf_gbps(src_size + dst_size, (double) best);
+                        const double rel  = memcpy_gbps > 0.0 ? gbps/memcpy_gbps : 0.0;
+
+                        if (params.csv) {
+                            printf("%s,%lld,%lld,%lld,%d,%d,%d,%lld,%.3f,%.3f,%.3f\n",
+                                    ggml_type_name(type), (long long) n, (long long) n, (long long) nc,
+                                    pad0, pad1, nt, (long long) best, gbps, memcpy_gbps, rel);
+                        } else {
+                            printf("%6s %5lld x %-5lld %5lld %5d %5d %3d %10lld %8.2f %8.2f %6.2f\n",
+                                    ggml_type_name(type), (long long) n, (long long) n, (long long) nc,
+                                    pad0, pad1, nt, (long long) best, gbps, memcpy_gbps, rel);
+                        }
+                        fflush(stdout);
+                    }
+
+                    ggml_free(ctx);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char ** argv) {
+    if (argc > 1 && strcmp(argv[1], "perf") == 0) {
+        return perf_main(argc, argv);
+    }
+
+    for (wrapped_view_consumer consumer : { CONSUMER_GELU, CONSUMER_ABS, CONSUMER_POOL_2D, CONSUMER_UPSCALE, CONSUMER_CONV_2D }) {
+        for (int n_threads : { 1, 3 }) {
+            if (!test_pad_circular_view(consumer, n_threads)) {
+                printf("test_pad_circular_view failed: consumer = %d, n_threads = %d\n", (int) consumer, n_threads);
+                return 1;
+            }
+        }
+    }
+
+    {
+        // asymmetric on all four axes, with pads wider than the axis on each of them
+        const int64_t ne_small[4] = { 5, 4, 3, 2 };
+        const int64_t ne_tiny[4]  = { 3, 2, 2, 3 };
+        const int pads_wide[8] = { 2, 7, 1, 6, 4, 1, 3, 5 };
+        const int pads_mix[8]  = { 0, 1, 3, 0, 1, 5, 7, 1 };
+        for (int n_threads : { 1, 3 }) {
+            if (!test_pad_circular_back(ne_small, pads_wide, n_threads) ||
+                !test_pad_circular_back(ne_small, pads_mix,  n_threads) ||
+                !test_pad_circular_back(ne_tiny,  pads_wide, n_threads) ||
+                !test_pad_circular_back(ne_tiny,  pads_mix,  n_threads)) {
+                printf("test_pad_circular_back failed: n_threads = %d\n", n_threads);
+                return 1;
+            }
+        }
+    }
+
+    if (!test_pad_circular_view_alloc()) {
+        printf("test_pad_circular_view_alloc failed\n");
+        return 1;
+    }
+
+    {
+        struct conv_case { int K, IW, IH, p0, p1; };
+        const conv_case cases[] = {
+            {  3, 16,  8, 1, 1 }, // direct path
+            {  7, 16,  8, 3, 3 }, // power-of-2 FFT
+            {  9, 20, 13, 4, 2 }, // Bluestein FFT, asymmetric padding
+            { 11,  6,  5, 5, 7 }, // kernel and padding larger than the input
+        };
+        for (const conv_case & c : cases) {
+            for (ggml_type kernel_type : { GGML_TYPE_F16, GGML_TYPE_F32 }) {
+                for (int n_threads : { 1, 3 }) {
+                    if (!test_conv_2d_circular(c.K, c.IW, c.IH, c.p0, c.p1, kernel_type, n_threads)) {
+                        printf("test_conv_2d_circular failed: K = %d, IW = %d, IH = %d, n_threads = %d\n", c.K, c.IW, c.IH, n_threads);
+                        return 1;
+                    }
+                }
+            }
+        }
+    }
+
+    {
+        // more distinct FFT sizes than the plan cache starts with, power-of-2 and Bluestein; the plans
+        // outlive the context of each case, and are rebuilt after being freed
+        for (int IW = 8; IW < 48; ++IW) {
+            const int IH = 5 + IW % 3;
+            if (!test_conv_2d_circular(7, IW, IH, 3, 2, GGML_TYPE_F32, IW % 2 ? 1 : 3)) {
+                printf("test_conv_2d_circular failed: K = 7, IW = %d, IH = %d\n", IW, IH);
+                return 1;
+            }
+        }
+        ggml_fft_plans_free();
+        if (!test_conv_2d_circular(7, 20, 13, 3, 2, GGML_TYPE_F32, 3)) {
+            printf("test_conv_2d_circular failed after ggml_fft_plans_free\n");
+            return 1;
+        }
+    }
+
+    for (ggml_type type : { GGML_TYPE_Q4_0, GGML_TYPE_Q8_0, GGML_TYPE_Q4_K, GGML_TYPE_Q6_K }) {
+        for (int n_threads : { 1, 3 }) {
+            if (!test_pad_circular_quantized(type, n_threads)) {
+                printf("test_pad_circular_quantized failed: type = %s, n_threads = %d\n", ggml_type_name(type), n_threads);
+                return 1;
+            }
+        }
+    }
+
+    for (bool is_2D : { false, true }) {
+        for (int n_threads : { 1, 3 }) {
+            if (!test_conv_circular(is_2D, 1, 1, 1, n_threads) ||
+                !test_conv_circular(is_2D, 2, 2, 1, n_threads) ||
+                !test_conv_circular(is_2D, 1, 2, 2, n_threads)) {
+                printf("test_conv_circular failed: is_2D = %d, n_threads = %d\n", is_2D, n_threads);
+                return 1;
+            }
+        }
+    }
+
+    {
+        const int64_t ne[4] = { 5, 4, 3, 2 };
+        const int pads_sym[8]  = { 2, 2, 2, 2, 1, 1, 1, 1 };
+        const int pads_asym[8] = { 0, 3, 1, 0, 2, 0, 0, 1 };
+        const int pads_wide[8] = { 7, 11, 9, 5, 0, 0, 0, 0 }; // wider than the tensor itself
+
+        for (int n_threads : { 1, 3, 8 }) {
+            for (ggml_type type : { GGML_TYPE_F32, GGML_TYPE_F16 }) {
+                if (!test_pad_circular_ext(type, ne, pads_sym,  n_threads) ||
+                    !test_pad_circular_ext(type, ne, pads_asym, n_threads) ||
+                    !test_pad_circular_ext(type, ne, pads_wide, n_threads)) {
+                    printf("test_pad_circular_ext failed: type = %s, n_threads = %d\n", ggml_type_name(type), n_threads);
+                    return 1;
+                }
+            }
+        }
+    }
+
     bool debug = false;
     const int pad_amount=2;
     const int base_tensor_size=3;
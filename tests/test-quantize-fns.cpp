@@ -6,6 +6,7 @@
 #include <assert.h>
 #include <math.h>
 #include <stdio.h>
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -18,6 +19,7 @@ constexpr float MAX_QUANTIZATION_TOTAL_ERROR = 0.002f;
 constexpr float MAX_QUANTIZATION_TOTAL_ERROR_2BITS = 0.0075f;
 constexpr float MAX_QUANTIZATION_TOTAL_ERROR_3BITS = 0.0040f;
 constexpr float MAX_DOT_PRODUCT_ERROR = 0.02f;
+constexpr float MAX_MULTI_DOT_PRODUCT_ERROR = 1e-6f;
 
 static const char* RESULT_STR[] = {"ok", "FAILED"};
 
@@ -92,6 +94,37 @@ static float dot_product_error(
     return fabsf(result - dot_ref) / test_size;
 }
 
+// Largest difference between vec_dot_nc and vec_dot for each of the GGML_VEC_DOT_NC rows of y
+static float multi_dot_product_error(
+    ggml_type_traits_t & qfns, size_t test_size, const float * test_data1, const float * test_data2
+) {
+    auto vdot = ggml_internal_get_type_traits(qfns.vec_dot_type);
+
+    const size_t row_size = test_size/vdot.blck_size*vdot.type_size;
+
+    std::vector<uint8_t> tmp_q1(2*test_size);
+    std::vector<uint8_t> tmp_q2(GGML_VEC_DOT_NC*row_size);
+    std::vector<float> tmp_y(test_size);
+
+    qfns.from_float(test_data1, tmp_q1.data(), test_size);
+    for (int j = 0; j < GGML_VEC_DOT_NC; j++) {
+        generate_data(1.0 + j, test_size, tmp_y.data());
+        vdot.from_float(j == 0 ? test_data2 : tmp_y.data(), tmp_q2.data() + j*row_size, test_size);
+    }
+
+    float result[2*GGML_VEC_DOT_NC];
+    qfns.vec_dot_nc(test_size, result, 2, tmp_q1.data(), tmp_q2.data(), row_size);
+
+    float max_error = 0.0f;
+    for (int j = 0; j < GGML_VEC_DOT_NC; j++) {
+        float ref = INFINITY;
+        qfns.vec_dot(test_size, &ref, tmp_q1.data(), tmp_q2.data() + j*row_size);
+        max_error = std::max(max_error, fabsf(result[2*j] - ref) / test_size);
+    }
+
+    return max_error;
+}
+
 int main(int argc, char * argv[]) {
     bool verbose = false;
     const size_t test_size = 32 * 128;
@@ -160,6 +193,15 @@ int main(int argc, char * argv[]) {
             if (failed || verbose) {
                 printf("%5s dot product error:              %s (%f)\n", ggml_type_name(type), RESULT_STR[failed], vec_dot_error);
             }
+
+            if (qfns.vec_dot_nc) {
+                const float multi_dot_error = multi_dot_product_error(qfns, test_size, test_data.data(), test_data2.data());
+                failed = !(multi_dot_error < MAX_MULTI_DOT_PRODUCT_ERROR);
+                num_failed += failed;
+                if (failed || verbose) {
+                    printf("%5s multi-row dot product error:    %s (%f)\n", ggml_type_name(type), RESULT_STR[failed], multi_dot_error);
+                }
+            }
         }
     }
 
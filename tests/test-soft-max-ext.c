@@ -0,0 +1,74 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// checks ggml_soft_max_ext against ggml_scale -> ggml_add (mask) -> ggml_alibi -> ggml_soft_max,
+// with a mask broadcast over the heads and taller than the rows, with and without ALiBi and in place
+
+static int run(struct ggml_context * ctx, int ne0, int ne1, int ne2, float scale, float max_bias, int n_threads) {
+    struct ggml_tensor * a    = ggml_new_tensor_3d(ctx, GGML_TYPE_F32, ne0, ne1, ne2);
+    struct ggml_tensor * mask = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, ne0, ne1 + 3);
+
+    for (int i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 13 - 6)/3.0f);
+    }
+    for (int i1 = 0; i1 < mask->ne[1]; ++i1) {
+        for (int i0 = 0; i0 < ne0; ++i0) {
+            ggml_set_f32_nd(mask, i0, i1, 0, 0, i0 > i1 + ne0 - ne1 ? -INFINITY : (float) (i0 % 4)/8.0f);
+        }
+    }
+
+    struct ggml_tensor * mask_rows = ggml_view_2d(ctx, mask, ne0, ne1, mask->nb[1], 0);
+
+    struct ggml_tensor * ref = ggml_add(ctx, ggml_scale(ctx, a, ggml_new_f32(ctx, scale)), ggml_repeat(ctx, mask_rows, a));
+    if (max_bias > 0.0f) {
+        ref = ggml_alibi(ctx, ref, 0, ne2, max_bias);
+    }
+    ref = ggml_soft_max(ctx, ref);
+
+    struct ggml_tensor * res = ggml_soft_max_ext(ctx, a, mask, scale, max_bias);
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, ref);
+    ggml_build_forward_expand(gf, res);
+
+    struct ggml_cplan cplan = ggml_graph_plan(gf, n_threads);
+    cplan.work_data = malloc(cplan.work_size + 1);
+    ggml_graph_compute(gf, &cplan);
+    free(cplan.work_data);
+
+    for (int i = 0; i < ggml_nelements(res); ++i) {
+        const float x = ggml_get_f32_1d(ref, i);
+        const float y = ggml_get_f32_1d(res, i);
+        if (fabsf(x - y) > 1e-5f) {
+            fprintf(stderr, "%s: ne = [%d, %d, %d], scale = %f, max_bias = %f, n_threads = %d: mismatch at %d: %f != %f\n",
+                    __func__, ne0, ne1, ne2, scale, max_bias, n_threads, i, y, x);
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 64*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    int failed = 0;
+
+    failed |= run(ctx,   32,  1, 4, 0.125f, 0.0f, 1);
+    failed |= run(ctx,  100, 17, 6, 0.5f,   0.0f, 3);
+    failed |= run(ctx,  100, 17, 6, 0.5f,   8.0f, 4);
+    failed |= run(ctx, 1000,  7, 5, 1.0f,   8.0f, 2);
+
+    ggml_free(ctx);
+
+    return failed;
+}
@@ -0,0 +1,329 @@
+#include "ggml/ggml.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// computes the same graph with threads created per call and on a persistent ggml_threadpool,
+// including graphs planned for fewer threads than the pool has, with every wait policy,
+// with the dependency-driven executor (ggml_cplan.dag), with cached plans, asynchronously and
+// with several graphs sharing the pool
+
+#define N_ITER 20
+
+static struct ggml_cgraph * build_graph(struct ggml_context * ctx, struct ggml_tensor ** out) {
+    // F16 weights: src1 of the mul_mat is converted to F16 by all threads before the product
+    // enough rows for the mul_mat to be split in more chunks than threads
+    struct ggml_tensor * a = ggml_new_tensor_2d(ctx, GGML_TYPE_F16, 64, 256);
+    struct ggml_tensor * b = ggml_new_tensor_2d(ctx, GGML_TYPE_F32, 64, 32);
+
+    for (int i = 0; i < ggml_nelements(a); ++i) {
+        ggml_set_f32_1d(a, i, (float) ((i*7) % 13) - 6.0f);
+    }
+    for (int i = 0; i < ggml_nelements(b); ++i) {
+        ggml_set_f32_1d(b, i, (float) ((i*5) % 11) - 5.0f);
+    }
+
+    struct ggml_tensor * c = ggml_mul_mat(ctx, a, b);
+    struct ggml_tensor * d = ggml_gelu(ctx, ggml_scale(ctx, c, ggml_new_f32(ctx, 0.01f)));
+
+    // independent branches the dag executor can compute concurrently, one of them in place
+    struct ggml_tensor * e = ggml_silu(ctx, ggml_rms_norm(ctx, ggml_mul_mat(ctx, a, ggml_sqr(ctx, b)), 1e-6f));
+    struct ggml_tensor * f = ggml_tanh_inplace(ctx, ggml_scale(ctx, c, ggml_new_f32(ctx, 0.02f)));
+
+    *out = ggml_soft_max(ctx, ggml_add(ctx, ggml_add(ctx, d, d), ggml_add(ctx, e, f)));
+
+    struct ggml_cgraph * gf = ggml_new_graph(ctx);
+    ggml_build_forward_expand(gf, *out);
+
+    return gf;
+}
+
+// two graphs on the pool: the first one starts alone and holds every thread until the second one
+// waits for the pool, then records the number of threads it computes with while the second one runs
+struct share_state {
+    volatile int started;   // the first graph holds the pool
+    volatile int submitted; // the second graph was submitted
+    volatile int nth[2];    // threads of the graphs, 0 until recorded
+};
+
+static void share_wait(struct ggml_tensor * dst, const struct ggml_tensor * a, int ith, int nth, void * userdata) {
+    struct share_state * st = (struct share_state *) userdata;
+    (void) dst; (void) a; (void) ith; (void) nth;
+
+    st->started = 1;
+    while (!st->submitted) {
+    }
+
+    // time for the second graph to reach the pool
+    const int64_t t_start = ggml_time_us();
+    while (ggml_time_us() - t_start < 200*1000) {
+    }
+}
+
+static void share_record_first(struct ggml_tensor * dst, const struct ggml_tensor * a, int ith, int nth, void * userdata) {
+    struct share_state * st = (struct share_state *) userdata;
+    (void) dst; (void) a;
+
+    if (ith == 0) {
+        st->nth[0] = nth;
+
+        // stay on the pool until the second graph got its threads
+        const int64_t t_start = ggml_time_us();
+        while (!st->nth[1] && ggml_time_us() - t_start < 10*1000*1000) {
+        }
+    }
+}
+
+static void share_record_second(struct ggml_tensor * dst, const struct ggml_tensor * a, int ith, int nth, void * userdata) {
+    struct share_state * st = (struct share_state *) userdata;
+    (void) dst; (void) a;
+
+    if (ith == 0) {
+        st->nth[1] = nth;
+    }
+}
+
+static int compare(const float * ref, const struct ggml_tensor * t, const char * what) {
+    const float * data = (const float *) t->data;
+    for (int i = 0; i < ggml_nelements(t); ++i) {
+        if (fabsf(data[i] - ref[i]) > 1e-6f) {
+            fprintf(stderr, "%s: mismatch at %d: %f != %f\n", what, i, data[i], ref[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(void) {
+    struct ggml_init_params params = {
+        /*.mem_size   =*/ 16*1024*1024,
+        /*.mem_buffer =*/ NULL,
+        /*.no_alloc   =*/ false,
+    };
+
+    struct ggml_context * ctx = ggml_init(params);
+
+    struct ggml_tensor * out = NULL;
+    struct ggml_cgraph * gf = build_graph(ctx, &out);
+
+    uint8_t * work = NULL;
+    size_t work_size = 0;
+
+    // reference: single thread
+    {
+        struct ggml_cplan cplan = ggml_graph_plan(gf, 1);
+        work = malloc(cplan.work_size + 1);
+        work_size = cplan.work_size;
+        cplan.work_data = work;
+        ggml_graph_compute(gf, &cplan);
+    }
+
+    float * ref = malloc(ggml_nbytes(out));
+    memcpy(ref, out->data, ggml_nbytes(out));
+
+    const int n_pool = 4;
+    struct ggml_threadpool * threadpool = ggml_threadpool_new(n_pool);
+
+    if (ggml_threadpool_get_n_threads(threadpool) != n_pool) {
+        fprintf(stderr, "unexpected pool size\n");
+        return 1;
+    }
+
+    const enum ggml_wait_policy policies[] = {
+        GGML_WAIT_POLICY_DEFAULT,
+        GGML_WAIT_POLICY_SPIN,
+        GGML_WAIT_POLICY_YIELD,
+        GGML_WAIT_POLICY_SLEEP,
+    };
+
+    for (int dag = 0; dag <= 1; ++dag)
+    for (int ip = 0; ip < (int) (sizeof(policies)/sizeof(policies[0])); ++ip)
+    for (int n_threads = 1; n_threads <= n_pool; ++n_threads) {
+        struct ggml_cplan cplan = ggml_graph_plan(gf, n_threads);
+        if (cplan.work_size > work_size) {
+            work = realloc(work, cplan.work_size);
+            work_size = cplan.work_size;
+        }
+        cplan.work_data = work;
+        cplan.wait_policy = policies[ip];
+        cplan.wait_spin_count = 16;
+        cplan.dag = dag;
+
+        // threads created per call
+        memset(out->data, 0, ggml_nbytes(out));
+        ggml_graph_compute(gf, &cplan);
+        if (compare(ref, out, "no pool")) {
+            return 1;
+        }
+
+        // persistent workers, the same pool for every graph
+        cplan.threadpool = threadpool;
+        for (int it = 0; it < N_ITER; ++it) {
+            memset(out->data, 0, ggml_nbytes(out));
+            if (ggml_graph_compute(gf, &cplan) != GGML_EXIT_SUCCESS) {
+                fprintf(stderr, "graph compute failed\n");
+                return 1;
+            }
+            if (compare(ref, out, "pool")) {
+                fprintf(stderr, "dag = %d, policy = %d, n_threads = %d, iteration %d\n", dag, (int) policies[ip], n_threads, it);
+                return 1;
+            }
+            if (cplan.wait_time_us < 0 || (cplan.wait_policy != GGML_WAIT_POLICY_SLEEP && cplan.wait_n_sleeps != 0)) {
+                fprintf(stderr, "unexpected wait statistics\n");
+                return 1;
+            }
+        }
+    }
+
+    // cached plans: reused for the same graph, replanned for another one
+    // with the dag executor the cache also keeps the dependencies between the computes
+    for (int dag = 0; dag <= 1; ++dag) {
+        struct ggml_cplan_cache * cache = ggml_cplan_cache_new();
+        struct ggml_cgraph part = ggml_graph_view(gf, 0, gf->n_nodes/2);
+
+        for (int it = 0; it < 5; ++it) {
+            struct ggml_cgraph * g = it == 2 ? &part : gf;
+
+            struct ggml_cplan cplan = ggml_graph_plan_cached(g, n_pool, cache);
+            if (cplan.work_size != ggml_graph_plan(g, n_pool).work_size) {
+                fprintf(stderr, "cached plan: unexpected work size\n");
+                return 1;
+            }
+            if (cplan.work_size > work_size) {
+                work = realloc(work, cplan.work_size);
+                work_size = cplan.work_size;
+            }
+            cplan.work_data  = work;
+            cplan.threadpool = threadpool;
+            cplan.dag        = dag;
+
+            memset(out->data, 0, ggml_nbytes(out));
+            ggml_graph_compute(g, &cplan);
+            if (g == gf && compare(ref, out, "cached plan")) {
+                fprintf(stderr, "dag = %d, iteration %d\n", dag, it);
+                return 1;
+            }
+        }
+
+        ggml_cplan_cache_free(cache);
+    }
+
+    // asynchronous compute, on the pool and on threads created for the call
+    for (int use_pool = 0; use_pool <= 1; ++use_pool) {
+        struct ggml_cplan cplan = ggml_graph_plan(gf, n_pool);
+        cplan.work_data  = work;
+        cplan.threadpool = use_pool ? threadpool : NULL;
+        cplan.wait_policy = GGML_WAIT_POLICY_YIELD;
+
+        for (int it = 0; it < N_ITER; ++it) {
+            memset(out->data, 0, ggml_nbytes(out));
+
+            struct ggml_compute_future * future = ggml_graph_compute_async(gf, &cplan);
+            while (it == 0 && !ggml_compute_future_is_done(future)) {
+                // the caller is free to do other work here
+            }
+            if (ggml_compute_future_wait(future) != GGML_EXIT_SUCCESS) {
+                fprintf(stderr, "async graph compute failed\n");
+                return 1;
+            }
+            if (compare(ref, out, "async")) {
+                fprintf(stderr, "pool = %d, iteration %d\n", use_pool, it);
+                return 1;
+            }
+        }
+    }
+
+    // independent graphs computed concurrently on the same pool, with different weights
+    {
+        enum { N_GRAPHS = 3 };
+
+        struct ggml_tensor * outs[N_GRAPHS];
+        struct ggml_cgraph * graphs[N_GRAPHS];
+        uint8_t            * works[N_GRAPHS];
+
+        for (int g = 0; g < N_GRAPHS; ++g) {
+            graphs[g] = build_graph(ctx, &outs[g]);
+            works[g]  = malloc(ggml_graph_plan(graphs[g], n_pool).work_size + 1);
+        }
+
+        for (int it = 0; it < N_ITER; ++it) {
+            struct ggml_compute_future * futures[N_GRAPHS];
+
+            for (int g = 0; g < N_GRAPHS; ++g) {
+                struct ggml_cplan cplan = ggml_graph_plan(graphs[g], n_pool);
+                cplan.work_data   = works[g];
+                cplan.threadpool  = threadpool;
+                cplan.weight      = g + 1;
+                cplan.wait_policy = GGML_WAIT_POLICY_YIELD;
+
+                memset(outs[g]->data, 0, ggml_nbytes(outs[g]));
+                futures[g] = ggml_graph_compute_async(graphs[g], &cplan);
+            }
+
+            for (int g = 0; g < N_GRAPHS; ++g) {
+                if (ggml_compute_future_wait(futures[g]) != GGML_EXIT_SUCCESS || compare(ref, outs[g], "shared pool")) {
+                    fprintf(stderr, "graph %d, iteration %d\n", g, it);
+                    return 1;
+                }
+            }
+        }
+
+        for (int g = 0; g < N_GRAPHS; ++g) {
+            free(works[g]);
+        }
+    }
+
+    // the threads of concurrent graphs follow their weights: with weights 1 and 3 on a pool of 4 threads,
+    // the graph that started alone gives 3 threads back when the other one arrives
+    {
+        struct share_state st = { 0, 0, { 0, 0 } };
+
+        struct ggml_tensor * x = ggml_new_tensor_1d(ctx, GGML_TYPE_F32, 1);
+        ggml_set_f32(x, 0.0f);
+
+        struct ggml_tensor * first  = ggml_map_custom1(ctx, ggml_map_custom1(ctx, x, share_wait, 1, &st), share_record_first, GGML_N_TASKS_MAX, &st);
+        struct ggml_tensor * second = ggml_map_custom1(ctx, x, share_record_second, GGML_N_TASKS_MAX, &st);
+
+        struct ggml_cgraph * graphs[2] = { ggml_new_graph(ctx), ggml_new_graph(ctx) };
+        ggml_build_forward_expand(graphs[0], first);
+        ggml_build_forward_expand(graphs[1], second);
+
+        struct ggml_compute_future * futures[2];
+
+        for (int g = 0; g < 2; ++g) {
+            struct ggml_cplan cplan = ggml_graph_plan(graphs[g], n_pool);
+            cplan.work_data   = work;
+            cplan.threadpool  = threadpool;
+            cplan.weight      = g == 0 ? 1 : 3;
+            cplan.wait_policy = GGML_WAIT_POLICY_YIELD;
+
+            futures[g] = ggml_graph_compute_async(graphs[g], &cplan);
+
+            while (g == 0 && !st.started) {
+            }
+        }
+        st.submitted = 1;
+
+        for (int g = 0; g < 2; ++g) {
+            if (ggml_compute_future_wait(futures[g]) != GGML_EXIT_SUCCESS) {
+                fprintf(stderr, "weighted shares: graph %d failed\n", g);
+                return 1;
+            }
+        }
+
+        if (st.nth[0] != 1 || st.nth[1] != 3) {
+            fprintf(stderr, "weighted shares: the graphs got %d and %d threads, expected 1 and 3\n", st.nth[0], st.nth[1]);
+            return 1;
+        }
+    }
+
+    ggml_threadpool_free(threadpool);
+
+    free(ref);
+    free(work);
+    ggml_free(ctx);
+
+    return 0;
+}